@@ -77,6 +77,10 @@ static int32_t Tval; // uncompensated T value
 static uint32_t Pmeasured; // Pa
 static float  Tmeasured; // degC
 static uint8_t devID = 0;
+// max conversion times (s): temperature and pressure for each oversampling setting
+#define BMP180_TCONV    (0.0045)
+static const double BMP180_PCONV[4] = {0.0045, 0.0075, 0.0135, 0.0255};
+static double convend = 0.; // expected end of current conversion
 
 BMP180_status BMP180_get_status(){
     return bmpstatus;
@@ -151,9 +155,19 @@ int BMP180_start(){
         return 0;
     }
     bmpstatus = BMP180_BUSYT;
+    convend = dtime() + BMP180_TCONV;
     return 1;
 }
 
+/**
+ * @brief BMP180_deadline - expected end of current conversion (T or P)
+ * @return time (by dtime()) when data should be ready or 0 if there's no conversion in progress
+ */
+double BMP180_deadline(){
+    if(bmpstatus != BMP180_BUSYT && bmpstatus != BMP180_BUSYP) return 0.;
+    return convend;
+}
+
 
 // calculate T degC and P in Pa
 static inline void compens(uint32_t Pval){
@@ -214,6 +228,7 @@ void BMP180_process(){
             return;
         }
         bmpstatus = BMP180_BUSYP;
+        convend = dtime() + BMP180_PCONV[bmp180_os & 3];
     }else{ // wait for pressure
         if(still_measuring()) return;
         DBG("Read uncompensated P\n");
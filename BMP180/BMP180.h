@@ -46,5 +46,6 @@ void BMP180_setOS(BMP180_oversampling os);
 BMP180_status BMP180_get_status();
 int BMP180_start();
 void BMP180_process();
+double BMP180_deadline();
 void BMP180_getdata(float *T, uint32_t *P);
 
@@ -17,6 +17,7 @@
  */
 
 #include <stdio.h>
+#include <unistd.h>
 #include <usefull_macros.h>
 
 #include "i2c.h"
@@ -102,6 +103,9 @@ static struct{
 };
 
 static BMP280_status bmpstatus = BMP280_NOTINIT;
+// raw P, T & H data read together with status
+static uint8_t rawdata[8];
+static double convend = 0.; // expected end of current measurement
 
 BMP280_status BMP280_get_status(){
     return bmpstatus;
@@ -124,8 +128,13 @@ void BMP280_setOSh(BMP280_Oversampling os){
 // get compensation data, return 1 if OK
 static int readcompdata(){
     FNAME();
-    if(!i2c_read_data8(BMP280_REG_CALIBA, BMP280_CALIBA_SIZE, (uint8_t*)&CaliData)){
-        DBG("Can't read calibration A data");
+    // calibration A (with dig_H1 at 0xA1) and B in one transfer
+    i2cbatch b;
+    i2cbatch_init(&b, i2c_getdev());
+    i2cbatch_read8(&b, BMP280_REG_CALIBA, BMP280_CALIBA_SIZE, (uint8_t*)&CaliData);
+    if(params.ID == BME280_CHIP_ID) i2cbatch_read8(&b, BMP280_REG_CALIBB, BMP280_CALIBB_SIZE, EEE);
+    if(!i2cbatch_run(&b)){
+        DBG("Can't read calibration data");
         return FALSE;
     }
     /*
@@ -137,14 +146,6 @@ static int readcompdata(){
         arr[i+1] = val;
     }*/
     if(params.ID == BME280_CHIP_ID){
-        if(!i2c_read_reg8(BMP280_REG_CALIB_H1, &CaliData.dig_H1)){
-            WARNX("Can't read dig_H1");
-            return FALSE;
-        }
-        if(!i2c_read_data8(BMP280_REG_CALIBB, BMP280_CALIBB_SIZE, EEE)){
-            WARNX("Can't read rest of dig_Hx");
-            return FALSE;
-        }
         // E5 is divided by two parts so we need this sex
         CaliData.dig_H2 = (EEE[1] << 8) | EEE[0];
         CaliData.dig_H3 = EEE[2];
@@ -183,11 +184,12 @@ int BMP280_init(){
         return FALSE;
     }
     uint8_t reg = 1;
-    while(reg & BMP280_STATUS_UPDATE){ // wait while update is done
+    while(reg & BMP280_STATUS_UPDATE){ // wait while update is done (NVM copying takes ~2ms after reset)
         if(!i2c_read_reg8(BMP280_REG_STATUS, &reg)){
             DBG("Can't read status");
             return FALSE;
         }
+        if(reg & BMP280_STATUS_UPDATE) usleep(500);
     }
     if(!readcompdata()){
         DBG("Can't read calibration data\n");
@@ -230,6 +232,19 @@ void BMP280_read_ID(uint8_t *devid){
     if(devid) *devid = params.ID;
 }
 
+// amount of samples for given oversampling
+static inline int nsamples(BMP280_Oversampling os){
+    return (os == BMP280_NOMEASUR) ? 0 : 1 << (os - 1);
+}
+
+// max measurement time (s) in forced mode (datasheet, appendix B)
+static double meastime(){
+    double t = 1.25 + 2.3 * nsamples(params.t_os);
+    if(params.p_os != BMP280_NOMEASUR) t += 2.3 * nsamples(params.p_os) + 0.575;
+    if(params.ID == BME280_CHIP_ID && params.h_os != BMP280_NOMEASUR) t += 2.3 * nsamples(params.h_os) + 0.575;
+    return t * 1e-3;
+}
+
 // start measurement, @return 1 if all OK
 int BMP280_start(){
     if(!CaliData.rdy || bmpstatus == BMP280_BUSY){
@@ -242,9 +257,19 @@ int BMP280_start(){
         return FALSE;
     }
     bmpstatus = BMP280_BUSY;
+    convend = dtime() + meastime();
     return TRUE;
 }
 
+/**
+ * @brief BMP280_deadline - expected end of current measurement
+ * @return time (by dtime()) when data should be ready or 0 if there's no measurement in progress
+ */
+double BMP280_deadline(){
+    if(bmpstatus != BMP280_BUSY) return 0.;
+    return convend;
+}
+
 // return T in degC
 static inline float compTemp(int32_t adc_temp, int32_t *t_fine){
     int32_t var1, var2;
@@ -296,33 +321,32 @@ static inline float compHum(int32_t adc_hum, int32_t fine_temp){
 	return (v_x1_u32r >> 12)/1024.f;
 }
 
+// status and data are read by one transfer: data is valid only if measurement is over
 void BMP280_process(){
     if(bmpstatus != BMP280_BUSY) return;
     // BUSY state: poll data ready
     uint8_t reg;
-    if(!i2c_read_reg8(BMP280_REG_STATUS, &reg)) return;
+    i2cbatch b;
+    i2cbatch_init(&b, i2c_getdev());
+    i2cbatch_read8(&b, BMP280_REG_STATUS, 1, &reg);
+    i2cbatch_read8(&b, BMP280_REG_ALLDATA, (params.ID == BME280_CHIP_ID) ? 8 : 6, rawdata);
+    if(!i2cbatch_run(&b)) return;
     if(reg & BMP280_STATUS_MSRNG) return; // still busy
     bmpstatus = BMP280_RDY; // data ready
 }
 
-// read data & convert it
+// convert data got by BMP280_process()
 int BMP280_getdata(float *T, float *P, float *H){
     if(bmpstatus != BMP280_RDY) return FALSE;
     bmpstatus = BMP280_RELAX;
-    uint8_t datasz = 8; // amount of bytes to read
+    uint8_t *data = rawdata;
     if(params.ID != BME280_CHIP_ID){
         DBG("Not BME!\n");
         if(H) *H = 0;
-        datasz = 6;
-    }
-    uint8_t data[8];
-    if(!i2c_read_data8(BMP280_REG_ALLDATA, datasz, data)){
-        DBG("Can't read data");
-        return FALSE;
     }
 #ifdef EBUG
     printf("\tgot data: ");
-    for(int i = 0; i < datasz; ++i){
+    for(int i = 0; i < ((params.ID == BME280_CHIP_ID) ? 8 : 6); ++i){
         printf("0x%02x ", data[i]);
     }
     printf("\n");
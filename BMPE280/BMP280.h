@@ -62,5 +62,6 @@ void BMP280_setOSh(BMP280_Oversampling os);
 BMP280_status BMP280_get_status();
 int BMP280_start();
 void BMP280_process();
+double BMP280_deadline();
 int BMP280_getdata(float *T, float *P, float *H);
 
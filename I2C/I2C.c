@@ -19,15 +19,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <errno.h>
 #include <string.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <asm/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 #include <usefull_macros.h>
 
+#include "i2c.h"
+
 typedef struct{
     char *device;
     int slaveaddr;
@@ -50,79 +46,40 @@ static myoption cmdlnopts[] = {
 };
 
 
-#ifndef FALSE
-#define FALSE 0
-#endif
-#ifndef TRUE
-#define TRUE 1
-#endif
-
-static uint16_t lastaddr = 0;
-
-static int i2c_read_reg8(int fd, uint8_t regaddr, uint8_t *data){
-    struct i2c_smbus_ioctl_data args;
-    union i2c_smbus_data sd;
-    args.read_write = I2C_SMBUS_READ;
-    args.command    = regaddr;
-    args.size       = I2C_SMBUS_BYTE_DATA;
-    args.data       = &sd;
-    if(ioctl(fd, I2C_SMBUS, &args) < 0) return FALSE;
-    *data = sd.byte;
-    return TRUE;
-}
-static int i2c_write_reg8(int fd, uint8_t regaddr, uint8_t data){
-    struct i2c_smbus_ioctl_data args;
-    union i2c_smbus_data sd;
-    sd.byte = data;
-    args.read_write = I2C_SMBUS_WRITE;
-    args.command    = regaddr;
-    args.size       = I2C_SMBUS_BYTE_DATA;
-    args.data       = &sd;
-    if(ioctl(fd, I2C_SMBUS, &args) < 0) return FALSE;
-    return TRUE;
-}
-static int i2c_read_reg(int fd, uint16_t regaddr, uint16_t *data){
-    struct i2c_msg m[2];
-    struct i2c_rdwr_ioctl_data x = {.msgs = m, .nmsgs = 2};
-    m[0].addr = lastaddr; m[1].addr = lastaddr;
-    m[0].flags = 0;
-    m[1].flags = I2C_M_RD;
-    m[0].len = 2; m[1].len = 2;
-    uint8_t a[2], d[2] = {0};
-    a[0] = regaddr >> 8;
-    a[1] = regaddr & 0xff;
-    m[0].buf = a; m[1].buf = d;
-    if(ioctl(fd, I2C_RDWR, &x) < 0) return FALSE;
-    *data = (uint16_t)((d[0] << 8) | (d[1]));
-    return TRUE;
-}
-static int i2c_write_reg(int fd, uint16_t regaddr, uint16_t data){
-    union i2c_smbus_data d;
-    d.block[0] = 3;
-    d.block[1] = regaddr & 0xff;
-    d.block[2] = data >> 8;
-    d.block[3] = data & 0xff;
-    struct i2c_smbus_ioctl_data args;
-    args.read_write = I2C_SMBUS_WRITE;
-    args.command    = regaddr >> 8;
-    args.size       = I2C_SMBUS_I2C_BLOCK_DATA;
-    args.data       = &d;
-    if(ioctl(fd, I2C_SMBUS, &args) < 0) return FALSE;
-    printf("Block: ");
-    for(int i = 0; i < 4; ++i) printf("0x%02x ", d.block[i]);
-    printf("\n");
-    return TRUE;
-}
-
-
-static inline int i2c_set_slave_address(int fd, uint8_t addr){
-    if(ioctl (fd, I2C_SLAVE, addr) < 0) return FALSE;
-    lastaddr = addr;
-    return TRUE;
-}
-
-static inline int i2c_open(const char *path){
-    return open(path, O_RDWR);
+// dump `N` registers starting from `reg`: each register is read by separate write/read pair,
+// but up to I2CBUS_MAXMSGS/2 of them are packed into one transfer (or by single SMBus command on SMBus adapters)
+static void dumpregs(i2cdev *d, int reg, int N, int reg8){
+    if(!i2cbus_plain(d->bus)){
+        for(int r = reg; r < reg + N; ++r){
+            uint8_t x;
+            if(!reg8 || !i2cdev_read_reg8(d, (uint8_t)r, &x)){
+                WARN("Can't read 0x%04x", r);
+                continue;
+            }
+            printf("%2d: 0x%02x -> 0x%02x\n", r-reg, r, x);
+        }
+        return;
+    }
+    uint8_t buf[I2CBUS_MAXMSGS/2][2];
+    i2cbatch b;
+    i2cbatch_init(&b, d);
+    for(int first = 0; first < N; first += I2CBUS_MAXMSGS/2){
+        int n = N - first;
+        if(n > I2CBUS_MAXMSGS/2) n = I2CBUS_MAXMSGS/2;
+        for(int i = 0; i < n; ++i){
+            if(reg8) i2cbatch_read8(&b, (uint8_t)(reg + first + i), 1, buf[i]);
+            else i2cbatch_read16(&b, (uint16_t)(reg + first + i), 2, buf[i]);
+        }
+        if(!i2cbatch_run(&b)){
+            WARN("Can't read 0x%04x..0x%04x", reg + first, reg + first + n - 1);
+            continue;
+        }
+        for(int i = 0; i < n; ++i){
+            int r = reg + first + i;
+            if(reg8) printf("%2d: 0x%02x -> 0x%02x\n", r-reg, r, buf[i][0]);
+            else printf("%4d: 0x%04x -> 0x%04x\n", r-reg, r, (buf[i][0] << 8) | buf[i][1]);
+        }
+    }
 }
 
 int main(int argc, char **argv){
@@ -133,17 +90,13 @@ int main(int argc, char **argv){
     if(G.help) showhelp(-1, cmdlnopts);
     if(G.slaveaddr < 0 || G.slaveaddr > 0x7f) ERRX("I2C address should be 7-bit");
     if(G.reg16 && G.reg8) ERRX("Enter either 8-bit address or 16-bit");
-    int fd = i2c_open(G.device);
-    if(fd < 0) ERR("Can't open %s", G.device);
     if(G.datalen){
         if(G.datalen < 0) ERRX("data length is uint16_t");
         if(G.datalen + G.reg16 > 0xffff) ERRX("Data len + start reg should be uint16_t");
     }
-    if(!i2c_set_slave_address(fd, (uint8_t)G.slaveaddr)){
-        WARN("Can't set slave address 0x%02x", G.slaveaddr);
-        goto clo;
-    }
-    if(!i2c_read_reg8(fd, (uint16_t)0, &d8)){
+    i2cdev *dev = i2cdev_open(G.device, (uint8_t)G.slaveaddr);
+    if(!dev) ERRX("Can't open %s", G.device);
+    if(!i2cdev_read_raw(dev, &d8, 1)){ // check presence: simple read without register address
         WARN("Can't find slave 0x%02x", G.slaveaddr);
         goto clo;
     }
@@ -156,7 +109,7 @@ int main(int argc, char **argv){
                 goto clo;
             }
             printf("Try to write 0x%02x to 0x%02x ... ", G.data2write, G.reg8);
-            if(!i2c_write_reg8(fd, (uint8_t)G.reg16, (uint8_t)G.data2write)){
+            if(!i2cdev_write_reg8(dev, (uint8_t)G.reg8, (uint8_t)G.data2write)){
                 WARN("Can't write"); goto clo;
             }
             else printf("OK\n");
@@ -166,7 +119,7 @@ int main(int argc, char **argv){
                 goto clo;
             }
             printf("Try to write 0x%04x to 0x%04x ... ", G.data2write, G.reg16);
-            if(!i2c_write_reg(fd, (uint16_t)G.reg16, (uint16_t)G.data2write)){
+            if(!i2cdev_write_reg16(dev, (uint16_t)G.reg16, (uint16_t)G.data2write)){
                 WARN("Can't write"); goto clo;
             }
             else printf("OK\n");
@@ -174,35 +127,18 @@ int main(int argc, char **argv){
     }
     if(!G.datalen){
         if(G.reg8){
-            if(!i2c_read_reg8(fd, (uint8_t)G.reg8, &d8)){
+            if(!i2cdev_read_reg8(dev, (uint8_t)G.reg8, &d8)){
                 WARN("Can't read"); goto clo;
             }
             printf("Read: 0x%02x\n", d8);
         }else{
-            if(!i2c_read_reg(fd, (uint16_t)G.reg16, &d)){
+            if(!i2cdev_read_reg16(dev, (uint16_t)G.reg16, &d)){
                 WARN("Can't read"); goto clo;
             }
             printf("Read: 0x%04x\n", d);
         }
-    }else{
-        int reg = (G.reg8) ? G.reg8 : G.reg16;
-        int lastreg = G.datalen + reg;
-        for(int i = reg; i < lastreg; ++i){
-            if(G.reg8){
-                if(!i2c_read_reg8(fd, (uint8_t)i, &d8)){
-                    WARN("Can't read"); continue;
-                }
-                printf("%2d: 0x%02x -> 0x%02x\n", i-reg, i, d8);
-            }else{
-                if(!i2c_read_reg(fd, (uint16_t)i, &d)){
-                    WARN("Can't read"); continue;
-                }
-                printf("%4d: 0x%04x -> 0x%04x\n", i-G.reg16, i, d);
-            }
-        }
-    }
+    }else dumpregs(dev, (G.reg8) ? G.reg8 : G.reg16, G.datalen, G.reg8);
 clo:
-    close(fd);
+    i2cdev_close(dev);
     return 0;
 }
-
@@ -22,19 +22,31 @@
 #include "as3935.h"
 #include "i2c.h"
 
-static int dev_fd = -1;
+static i2cdev *dev = NULL;
+static int owndev = 0; // `dev` was opened by as3935_open()
 
-#define I2Cread(reg, val)   i2c_read_reg(dev_fd, reg, (uint8_t*)val)
-#define I2Cwrite(reg, val)  i2c_write_reg(dev_fd, reg, (uint8_t)val)
+#define I2Cread(reg, val)   i2cdev_read_reg8(dev, reg, (uint8_t*)val)
+#define I2Cwrite(reg, val)  i2cdev_write_reg8(dev, reg, (uint8_t)val)
 
-// open device and set slave address
+// open device with given slave address
 int as3935_open(const char *path, uint8_t id){
-    dev_fd = i2c_open(path);
-    if(dev_fd < 0) return FALSE;
-    if(!i2c_set_slave_address(dev_fd, id)){
-        WARNX("Can't set slave address 0x%02x", id);
+    if(owndev) i2cdev_close(dev);
+    owndev = 0;
+    dev = i2cdev_open(path, id);
+    if(!dev){
+        WARNX("Can't open %s with slave address 0x%02x", path, id);
         return FALSE;
     }
+    owndev = 1;
+    return TRUE;
+}
+
+// work with device on already opened bus (e.g. shared with other sensors)
+int as3935_attach(i2cdev *d){
+    if(!d) return FALSE;
+    if(owndev) i2cdev_close(dev);
+    owndev = 0;
+    dev = d;
     return TRUE;
 }
 
@@ -198,29 +210,34 @@ int as3935_lco_fdiv(uint8_t d){
 
 // calculate last lightning energy
 int as3935_energy(uint32_t *E){
-    if(!E) return FALSE;
-    uint8_t u8; uint32_t energy;
-    t_s_lig_mm mm;
-    if(!I2Cread(S_LIG_MM, &mm)) return FALSE;
-    energy = mm.S_LIG_MM << 8;
-    if(!I2Cread(S_LIG_M, &u8)) return FALSE;
-    energy |= u8;
-    energy <<= 8;
-    if(!I2Cread(S_LIG_L, &u8)) return FALSE;
-    energy |= u8;
-    *E = energy;
-    return TRUE;
+    return as3935_lightning(E, NULL);
 }
 
 // get distance
 int as3935_distance(uint8_t *d){
-    if(!d) return FALSE;
-    t_distance dist;
-    if(!I2Cread(DISTANCE, &dist)) return FALSE;
-    *d = dist.DISTANCE;
+    return as3935_lightning(NULL, d);
+}
+
+// energy (S_LIG_L, S_LIG_M, S_LIG_MM) and distance of last lightning by one burst read
+int as3935_lightning(uint32_t *E, uint8_t *d){
+    if(!E && !d) return FALSE;
+    uint8_t b[4];
+    if(!i2cdev_read_data8(dev, S_LIG_L, 4, b)) return FALSE;
+    if(E) *E = ((uint32_t)((t_s_lig_mm)b[2]).S_LIG_MM << 16) | (b[1] << 8) | b[0];
+    if(d) *d = ((t_distance)b[3]).DISTANCE;
     return TRUE;
 }
 
+// read all registers needed for status dump by one transfer: regs[reg] for each reg of AS3935_REGISTERS
+int as3935_getregs(uint8_t regs[CALIB_SRCO + 1]){
+    if(!regs) return FALSE;
+    i2cbatch b;
+    i2cbatch_init(&b, dev);
+    i2cbatch_read8(&b, AFE_GAIN, TUN_DISP + 1, regs);
+    i2cbatch_read8(&b, CALIB_TRCO, 2, regs + CALIB_TRCO);
+    return i2cbatch_run(&b);
+}
+
 // reset to factory settings
 int as3935_resetdef(){
     return I2Cwrite(PRESET_DEFAULT, DIRECT_COMMAND);
@@ -20,6 +20,8 @@
 
 #include <stdint.h>
 
+#include "i2c.h"
+
 enum AS3935_REGISTERS{
     AFE_GAIN = 0x00,
     THRESHOLD,
@@ -122,6 +124,7 @@ typedef union{
 #define DIST_OUT_OF_RANGE   (0x3f)
 
 int as3935_open(const char *path, uint8_t id);
+int as3935_attach(i2cdev *d);
 int as3935_getter(uint8_t reg, uint8_t *data);
 int as3935_setter(uint8_t reg, uint8_t data);
 int as3935_displco(uint8_t n);
@@ -140,4 +143,6 @@ int as3935_mask_disturber(uint8_t m);
 int as3935_lco_fdiv(uint8_t d);
 int as3935_energy(uint32_t *E);
 int as3935_distance(uint8_t *d);
+int as3935_lightning(uint32_t *E, uint8_t *d);
+int as3935_getregs(uint8_t regs[CALIB_SRCO + 1]);
 int as3935_resetdef();
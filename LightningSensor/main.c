@@ -67,10 +67,14 @@ static myoption cmdlnopts[] = {
 #define STRINGIFY(x) #x
 #endif
 static uint8_t oldvals[256] = {0};
-#define TRY(reg) if(as3935_getter(reg, &u8)){if(!onlynew || u8 != oldvals[reg]){ green(STRINGIFY(reg) ": "); oldvals[reg] = u8;
-#define EL(reg) }}else WARNX("Can't read " STRINGIFY(reg) );
+#define TRY(reg) {u8 = regs[reg]; if(!onlynew || u8 != oldvals[reg]){ green(STRINGIFY(reg) ": "); oldvals[reg] = u8;
+#define EL(reg) }}
 void dumpregs(int onlynew){
-    uint8_t u8;
+    uint8_t u8, regs[CALIB_SRCO + 1];
+    if(!as3935_getregs(regs)){
+        WARNX("Can't read registers");
+        return;
+    }
     TRY(AFE_GAIN)
     t_afe_gain g = (t_afe_gain)u8;
     printf("PWD=%d, AFE_GB=%d\n", g.PWD, g.AFE_GB);
@@ -0,0 +1,256 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// benchmark of MLX90640 processing pipeline by EEPROM and raw data dumps (`mlx -D prefix`)
+// or synthetic data; build by `make bench`
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <usefull_macros.h>
+
+// data are injected into `dataarray` instead of I2C
+#include "mlx90640_internal.h"
+#include "mlx90640_regs.h"
+
+// allocations counter (link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc)
+static volatile size_t nalloc = 0;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size){ ++nalloc; return __real_malloc(size); }
+void *__wrap_calloc(size_t n, size_t size){ ++nalloc; return __real_calloc(n, size); }
+void *__wrap_realloc(void *ptr, size_t size){ ++nalloc; return __real_realloc(ptr, size); }
+
+// max allowed error of single precision processing (degrC for simple>0), `--check`
+#define CHECK_TOLERANCE     (1e-3)
+// max allowed error by calibration cache built for other Ta/Vdd (inside of MLX_CACHE_DTA and MLX_CACHE_DVDD):
+// its offsets aren't corrected by Ta/Vdd drift; degrC for simple>0 and ADC counts for simple=0
+#define CHECK_CACHETOL      (0.01)
+#define CHECK_CACHETOL_IR   (0.5)
+
+static int help = 0, nframes = 2000, ncalib = 200, check = 0;
+static double tolerance = CHECK_TOLERANCE, cachetol = CHECK_CACHETOL;
+static char *eepromfile = NULL, *rawfile = NULL;
+
+static myoption cmdlnopts[] = {
+    {"help",    NO_ARGS,    NULL,   'h',    arg_int,    APTR(&help),        _("show this help")},
+    {"eeprom",  NEED_ARG,   NULL,   'e',    arg_string, APTR(&eepromfile),  _("EEPROM dump (synthetic data if absent)")},
+    {"raw",     NEED_ARG,   NULL,   'r',    arg_string, APTR(&rawfile),     _("raw subpages dump (synthetic data if absent)")},
+    {"nframes", NEED_ARG,   NULL,   'n',    arg_int,    APTR(&nframes),     _("amount of frames to process in each mode (default: 2000)")},
+    {"ncalib",  NEED_ARG,   NULL,   'c',    arg_int,    APTR(&ncalib),      _("amount of calibration readouts (default: 200)")},
+    {"check",   NO_ARGS,    NULL,   'C',    arg_int,    APTR(&check),       _("only check accuracy of kernels, exit with error if it's worse than tolerance")},
+    {"tolerance",NEED_ARG,  NULL,   't',    arg_double, APTR(&tolerance),   _("max error of kernels for `--check` (default: 1e-3)")},
+    {"cachetol",NEED_ARG,   NULL,   'T',    arg_double, APTR(&cachetol),    _("max error by cached calibration of other Ta/Vdd for `--check`, degrC (default: 0.01)")},
+   end_option
+};
+
+// synthetic EEPROM header (datasheet-like values) and pixels
+static const uint16_t ee_hdr[48] = {
+    0x4210,0xFFBB,0x0202,0xF202,0xF2F2,0xE2E2,0xD1E1,0xD1D1,
+    0xF10F,0xF00F,0xE0EF,0xE0EF,0xE1E1,0xF3F2,0xF404,0xE504,
+    0x7997,0x2E26,0x0202,0xF202,0xF2F2,0xE2E2,0xD1E1,0xD1D1,
+    0xF10F,0xF00F,0xE0EF,0xE0EF,0xE1E1,0xF3F2,0xF404,0xE504,
+    0x18EF,0x2FF1,0x5952,0x9D68,0x5454,0x0994,0x6867,0x5354,
+    0x2363,0xE446,0xFBB5,0x044B,0xF020,0x9797,0x9797,0x2889
+};
+
+static void synth_eeprom(uint16_t *ee){
+    memcpy(ee, ee_hdr, sizeof(ee_hdr));
+    uint32_t r = 12345;
+    for(int i = 0; i < MLX_PIXNO; ++i){
+        r = r * 1103515245u + 12345u;
+        uint16_t off = (r >> 8) & 0x3F, al = (r >> 16) & 0x3F, kta = (r >> 24) & 7;
+        ee[48 + i] = (uint16_t)((off << 10) | (al << 4) | (kta << 1));
+    }
+}
+
+// Ta/Vdd drift of synthetic subpages (for each subpage in turn) to check stale calibration cache:
+// 1 LSB of VBE gives ~0.009degC, of Vdd - ~0.3mV, so 5 and 6 LSB are just inside and just past of
+// MLX_CACHE_DTA and MLX_CACHE_DVDD; `rebuilt` is expected cache state
+static const struct{ int16_t vbe, vdd; int rebuilt; } synth_drift[] = {
+    {0, 0, 1}, {-5, 0, 0}, {0, 6, 0}, {-5, 6, 0}, {-6, 0, 1}, {-6, 7, 1}, {-6, 1, 0}, {0, 1, 1}
+};
+#define NDRIFT  ((int)(sizeof(synth_drift)/sizeof(synth_drift[0])))
+
+static void synth_raw(mlx90640_rawrec *rec, int n){
+    uint32_t r = 777;
+    for(int k = 0; k < n; ++k){
+        uint16_t *d = rec[k].data;
+        int j = (k >> 1) % NDRIFT;
+        rec[k].subpage = (uint16_t)(k & 1);
+        for(int i = 0; i < MLX_PIXNO; ++i){
+            r = r * 1103515245u + 12345u;
+            int row = i / MLX_W, col = i % MLX_W;
+            int hot = (row > 8 && row < 14 && col > 10 + k % 8 && col < 20 + k % 8) ? 300 : 0;
+            d[i] = (uint16_t)(609 + ((r >> 16) & 15) + hot);
+        }
+        d[0x300] = (uint16_t)(0x4BF2 + synth_drift[j].vbe); d[0x320] = 0x06AF; d[0x30A] = 0x1881;
+        d[0x308] = 0xFFCA; d[0x328] = 0xFFC8; d[0x32A] = (uint16_t)(0xCCC5 + synth_drift[j].vdd);
+    }
+}
+
+static double mono_time(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief maxerror - max difference of single precision `kernel` from double precision reference
+ * @param d - sensor with calibration
+ * @param raw, nraw - subpages to process (calibration cache is used as in real processing)
+ * @param simple - type of image
+ * @param err, n - (if not NULL) max errors and amounts of subpages: [0] - by cached calibration, [1] - by rebuilt
+ * @return max absolute error by all pixels of all subpages (NAN if only one of values is NaN)
+ */
+static double maxerror(mlx90640_dev *d, const mlx90640_rawrec *raw, int nraw, int simple, mlx_kernel_fn kernel,
+                       double err[2], int n[2]){
+    double ima[MLX_PIXNO], ref[MLX_PIXNO], e2[2] = {0., 0.};
+    int n2[2] = {0, 0};
+    uint16_t *data = mlx90640_dataarray(d);
+    mlx90640_cache_reset(d);
+    for(int k = 0; k < nraw; ++k){
+        int sp = raw[k].subpage & 1;
+        memcpy(data, raw[k].data, sizeof(raw[k].data));
+        int rebuilt = mlx90640_process(d, sp, simple, kernel, ima) ? 1 : 0;
+        mlx90640_process(d, sp, simple, NULL, ref);
+        ++n2[rebuilt];
+        for(int i = 0; i < MLX_PIXNO; ++i){
+            if((((i / MLX_W) & 1) ^ (i & 1)) != sp) continue; // other subpage
+            if(isnan(ima[i]) && isnan(ref[i])) continue;
+            double e = fabs(ima[i] - ref[i]);
+            if(!(e <= e2[rebuilt])) e2[rebuilt] = e; // NaN stays forever
+        }
+    }
+    if(err){ err[0] = e2[0]; err[1] = e2[1]; }
+    if(n){ n[0] = n2[0]; n[1] = n2[1]; }
+    if(isnan(e2[0]) || isnan(e2[1])) return NAN;
+    return (e2[0] > e2[1]) ? e2[0] : e2[1];
+}
+
+// read whole file; @return its length in bytes
+static size_t readfile(const char *name, void **buf){
+    mmapbuf *map = My_mmap((char*)name);
+    if(!map) ERRX("Can't read %s", name);
+    *buf = malloc(map->len);
+    if(!*buf) ERR("malloc()");
+    memcpy(*buf, map->data, map->len);
+    size_t len = map->len;
+    My_munmap(map);
+    return len;
+}
+
+#define NSYNTH  (16)
+
+int main(int argc, char **argv){
+    initial_setup();
+    parseargs(&argc, &argv, cmdlnopts);
+    if(help) showhelp(-1, cmdlnopts);
+    if(nframes < 1 || ncalib < 1) ERRX("nframes and ncalib should be positive");
+    static uint16_t eeprom[REG_CALIDATA_LEN];
+    if(eepromfile){
+        void *buf;
+        size_t len = readfile(eepromfile, &buf);
+        if(len != sizeof(eeprom)) ERRX("%s: size should be %zd bytes", eepromfile, sizeof(eeprom));
+        memcpy(eeprom, buf, len);
+        free(buf);
+    }else synth_eeprom(eeprom);
+    mlx90640_rawrec *raw;
+    int nraw;
+    if(rawfile){
+        size_t len = readfile(rawfile, (void**)&raw);
+        nraw = (int)(len / sizeof(mlx90640_rawrec));
+        if(nraw < 1) ERRX("%s: no data", rawfile);
+    }else{
+        nraw = NSYNTH;
+        raw = MALLOC(mlx90640_rawrec, nraw);
+        synth_raw(raw, nraw);
+    }
+    green("EEPROM: %s, raw data: %s (%d subpages), %s kernel\n", eepromfile ? eepromfile : "synthetic",
+          rawfile ? rawfile : "synthetic", nraw, mlx_kernel_name());
+    mlx90640_dev *d = mlx90640_offline_new();
+    if(!d) ERR("mlx90640_offline_new()");
+    uint16_t *data = mlx90640_dataarray(d);
+    memcpy(data, eeprom, sizeof(eeprom));
+    if(!mlx90640_calibrate(d)) ERRX("Bad EEPROM data");
+    if(check){ // compare both kernels with reference for all types of image
+        static const struct{ const char *name; mlx_kernel_fn fn; } kernels[] = {
+            {NULL, mlx_kernel}, {"scalar", mlx_kernel_scalar}
+        };
+        int bad = 0, nrebuilt = 0; // expected amount of cache rebuilds for synthetic data
+        for(int k = 0; k < nraw; ++k) nrebuilt += synth_drift[(k >> 1) % NDRIFT].rebuilt;
+        for(int simple = 0; simple < 3; ++simple) for(int i = 0; i < 2; ++i){
+            double e[2];
+            int n[2];
+            maxerror(d, raw, nraw, simple, kernels[i].fn, e, n);
+            double ctol = simple ? cachetol : CHECK_CACHETOL_IR;
+            // false for NaN; synthetic data should check both stale and fresh cache just inside and past of thresholds
+            int ok = (e[0] <= ctol && e[1] <= tolerance && (rawfile || n[1] == nrebuilt));
+            printf("simple=%d, %s kernel: max error %g by cached (%d subpages), %g by rebuilt (%d) calibration - %s\n",
+                   simple, kernels[i].name ? kernels[i].name : mlx_kernel_name(), e[0], n[0], e[1], n[1], ok ? "OK" : "FAIL");
+            if(!ok) ++bad;
+        }
+        mlx90640_offline_free(d);
+        if(bad) ERRX("%d checks failed (tolerance %g, by cached calibration %g)", bad, tolerance, cachetol);
+        green("All checks passed\n");
+        return 0;
+    }
+    // calibration
+    size_t a0 = nalloc;
+    double t0 = mono_time();
+    for(int i = 0; i < ncalib; ++i){
+        memcpy(data, eeprom, sizeof(eeprom));
+        if(!mlx90640_calibrate(d)) ERRX("Bad EEPROM data");
+    }
+    double t = (mono_time() - t0) / ncalib;
+    printf("get_parameters() + mkfparams(): %.1f us, %zd allocations\n", t * 1e6, nalloc - a0);
+    // processing
+    static double image[MLX_PIXNO];
+    for(int cache = 1; cache > -1; --cache){
+        for(int simple = 0; simple < 3; ++simple){
+            mlx90640_set_cachethres(d, MLX_CACHE_DTA, MLX_CACHE_DVDD);
+            a0 = nalloc;
+            t0 = mono_time();
+            for(int i = 0, k = 0; i < nframes; ++i){
+                for(int sp = 0; sp < 2; ++sp, k = (k + 1) % nraw){
+                    memcpy(data, raw[k].data, sizeof(raw[k].data));
+                    if(!cache) mlx90640_cache_reset(d); // rebuild each subpage
+                    mlx90640_process(d, raw[k].subpage & 1, simple, mlx_kernel, image);
+                }
+                mlx90640_interpolate(d, image);
+            }
+            t = (mono_time() - t0) / nframes;
+            printf("simple=%d, %s cache: %7.2f ns/pixel, %8.0f frames/s, %zd allocations\n", simple,
+                   cache ? "with" : "   no", t * 1e9 / MLX_PIXNO, 1. / t, nalloc - a0);
+        }
+    }
+    // accuracy
+    for(int simple = 0; simple < 3; ++simple){
+        mlx90640_set_cachethres(d, MLX_CACHE_DTA, MLX_CACHE_DVDD);
+        double e[2], es[2];
+        maxerror(d, raw, nraw, simple, mlx_kernel, e, NULL);
+        maxerror(d, raw, nraw, simple, mlx_kernel_scalar, es, NULL);
+        printf("simple=%d, max error of float vs double: %s %g, scalar %g; by cached calibration: %g, %g\n",
+               simple, mlx_kernel_name(), e[1], es[1], e[0], es[0]);
+    }
+    mlx90640_offline_free(d);
+    return 0;
+}
@@ -24,6 +24,7 @@
 #include <strings.h>
 #include <math.h>
 #include "cmdlnopts.h"
+#include "recorder.h"
 #include "usefull_macros.h"
 
 /*
@@ -46,6 +47,12 @@ static glob_pars const Gdefault = {
     .device = DEFAULT_I2C,
     .pidfile = DEFAULT_PIDFILE,
     .simple = 2,
+    .refresh = 8.,
+    .resolution = 18,
+    .keyint = MLXREC_KEYINT,
+    .nframes = 10,
+    .hotthres = NAN,
+    .minarea = 2,
     .logfile = NULL // don't save logs
 };
 
@@ -61,6 +68,17 @@ static myoption cmdlnopts[] = {
     {"device",  NEED_ARG,   NULL,   'd',    arg_string, APTR(&G.device),    _("I2C device path (default: " DEFAULT_I2C ")")},
     {"address", NEED_ARG,   NULL,   'a',    arg_int,    APTR(&G.addr),      _("slave address (default:" STR(DEFAULT_ADDR) ")")},
     {"simple",  NEED_ARG,   NULL,   's',    arg_int,    APTR(&G.simple),    _("simple= (0..2, default: 2)")},
+    {"stream",  NO_ARGS,    NULL,   'S',    arg_int,    APTR(&G.stream),    _("run continuous acquisition in stream mode")},
+    {"refresh", NEED_ARG,   NULL,   'r',    arg_double, APTR(&G.refresh),   _("refresh rate, Hz (0.5, 1, 2, 4, 8, 16, 32, 64; default: 8)")},
+    {"resolution",NEED_ARG, NULL,   'R',    arg_int,    APTR(&G.resolution),_("ADC resolution, bits (16..19, default: 18)")},
+    {"fill",    NEED_ARG,   NULL,   'f',    arg_int,    APTR(&G.fill),      _("image after each subpage: 0 - no (default), 1 - other half from previous subpage, 2 - interpolate other half")},
+    {"caldir",  NEED_ARG,   NULL,   'c',    arg_string, APTR(&G.caldir),    _("directory for calibration cache (don't use cache if absent)")},
+    {"record",  NEED_ARG,   NULL,   'w',    arg_string, APTR(&G.record),    _("record frames into given file (and its index into file.idx)")},
+    {"keyint",  NEED_ARG,   NULL,   'k',    arg_int,    APTR(&G.keyint),    _("keyframe interval of record (default: 64, 1 - no delta compression)")},
+    {"nframes", NEED_ARG,   NULL,   'N',    arg_int,    APTR(&G.nframes),   _("amount of frames to take (default: 10, 0 - infinite)")},
+    {"hotthres",NEED_ARG,   NULL,   'T',    arg_double, APTR(&G.hotthres),  _("report hot regions with temperature above given value, degrC")},
+    {"minarea", NEED_ARG,   NULL,   'A',    arg_int,    APTR(&G.minarea),   _("min area of hot region, pixels (default: 2)")},
+    {"dump",    NEED_ARG,   NULL,   'D',    arg_string, APTR(&G.dump),      _("dump EEPROM to given prefix.eeprom and raw subpages to prefix.raw (for mlxbench)")},
    end_option
 };
 
@@ -24,7 +24,18 @@
 typedef struct{
     int addr;               // slave address
     int simple;				// 'simple'
+    int stream;             // run in stream mode
+    double refresh;         // refresh rate, Hz
+    int resolution;         // ADC resolution, bits
+    int fill;               // image after each subpage: mlx_fillmode
     char *device;           // I2C device
+    char *caldir;           // directory for calibration cache files
+    char *record;           // record frames into this file
+    int keyint;             // keyframe interval of record
+    int nframes;            // amount of frames to take
+    double hotthres;        // hot regions threshold, degrC (NaN - don't search)
+    int minarea;            // min area of hot region, pixels
+    char *dump;             // prefix of EEPROM and raw data dump files
     char *pidfile;          // name of PID file
     char *logfile;          // logging to this file
 } glob_pars;
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "hotspot.h"
+
+/**
+ * @brief hotspot_init - clear detector state
+ * @param h - detector
+ * @param thres - region threshold, degrC
+ * @param minarea - min area of region, pixels
+ */
+void hotspot_init(hotspot *h, float thres, uint16_t minarea){
+    memset(h, 0, sizeof(hotspot));
+    h->thres = thres;
+    h->hyst = HOTSPOT_HYST;
+    h->minarea = minarea ? minarea : 1;
+    h->dT = HOTSPOT_DT;
+    h->dpos = HOTSPOT_DPOS;
+    h->nextid = 1;
+}
+
+/**
+ * @brief hotspot_stats - min/max/mean of image by single pass
+ * @param image - MLX_PIXNO values
+ * @param st (o) - statistics
+ */
+void hotspot_stats(const double *image, hotspot_stat *st){
+    double min = image[0], max = image[0], sum = 0.;
+    uint16_t argmin = 0, argmax = 0;
+    for(uint16_t i = 0; i < MLX_PIXNO; ++i){
+        double v = image[i];
+        if(v < min){ min = v; argmin = i; }
+        if(v > max){ max = v; argmax = i; }
+        sum += v;
+    }
+    st->min = (float)min;
+    st->max = (float)max;
+    st->mean = (float)(sum / MLX_PIXNO);
+    st->argmin = argmin;
+    st->argmax = argmax;
+}
+
+static uint16_t uf_find(uint16_t *parent, uint16_t x){
+    while(parent[x] != x){
+        parent[x] = parent[parent[x]]; // path halving
+        x = parent[x];
+    }
+    return x;
+}
+
+static void uf_union(uint16_t *parent, uint16_t a, uint16_t b){
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if(a < b) parent[b] = a;
+    else if(b < a) parent[a] = b;
+}
+
+// label 8-connected regions of pixels hotter than `low`; @return amount of provisional labels
+static uint16_t mklabels(hotspot *h, const double *image, double low){
+    uint16_t n = 0, *label = h->label, *parent = h->parent;
+    for(int row = 0, p = 0; row < MLX_H; ++row){
+        for(int col = 0; col < MLX_W; ++col, ++p){
+            if(!(image[p] > low)){ // NaN is cold too
+                label[p] = 0;
+                continue;
+            }
+            uint16_t nb[4] = {0}, l = 0;
+            if(col > 0) nb[0] = label[p-1];
+            if(row > 0){
+                nb[1] = label[p-MLX_W];
+                if(col > 0) nb[2] = label[p-MLX_W-1];
+                if(col < MLX_W-1) nb[3] = label[p-MLX_W+1];
+            }
+            for(int k = 0; k < 4; ++k){
+                if(!nb[k]) continue;
+                if(!l) l = nb[k];
+                else if(nb[k] != l) uf_union(parent, l, nb[k]);
+            }
+            if(!l){
+                l = ++n;
+                parent[l] = l;
+            }
+            label[p] = l;
+        }
+    }
+    return n;
+}
+
+// Chebyshev distance between pixels
+static int pixdist(uint16_t a, uint16_t b){
+    int dr = a / MLX_W - b / MLX_W, dc = a % MLX_W - b % MLX_W;
+    if(dr < 0) dr = -dr;
+    if(dc < 0) dc = -dc;
+    return dr > dc ? dr : dc;
+}
+
+static int addevent(hotspot_event *ev, int nev, int maxev, hotspot_evtype type, const hotspot_roi *r){
+    if(nev >= maxev) return nev;
+    ev[nev] = (hotspot_event){.type = type, .id = r->id, .npix = r->npix, .argmax = r->argmax,
+                              .max = r->max, .mean = r->mean};
+    return nev + 1;
+}
+
+/**
+ * @brief hotspot_process - find hot regions of image and track them
+ * @param h - detector
+ * @param image - MLX_PIXNO values
+ * @param ev (o) - events array
+ * @param maxev - its size (HOTSPOT_MAXEV is enough for any case)
+ * @return amount of events (only changes of regions are reported)
+ * Regions are 8-connected pixels hotter than `thres - hyst` which have max hotter than `thres`
+ * (or continue region of previous image). Region gets track id of previous region which it overlaps most.
+ */
+int hotspot_process(hotspot *h, const double *image, hotspot_event *ev, int maxev){
+    hotspot_stats(image, &h->stat);
+    hotspot_roi prev[HOTSPOT_MAXROI];
+    int nprev = h->nroi, nroi = 0, nev = 0;
+    memcpy(prev, h->roi, nprev * sizeof(hotspot_roi));
+    int8_t previdx[256];
+    uint8_t used[256] = {0};
+    memset(previdx, -1, sizeof(previdx));
+    for(int i = 0; i < nprev; ++i){
+        previdx[prev[i].id] = (int8_t)i;
+        used[prev[i].id] = 1;
+    }
+    uint16_t n = mklabels(h, image, h->thres - h->hyst);
+    // resolve labels and accumulate region values
+    hotspot_acc *acc = h->acc;
+    memset(acc, 0, (n + 1) * sizeof(hotspot_acc));
+    for(uint16_t p = 0; p < MLX_PIXNO; ++p){
+        if(!h->label[p]) continue;
+        uint16_t r = uf_find(h->parent, h->label[p]);
+        h->label[p] = r;
+        hotspot_acc *a = &acc[r];
+        float v = (float)image[p];
+        if(!a->npix || v > a->max){ a->max = v; a->argmax = p; }
+        ++a->npix;
+        a->sum += v;
+        if(h->track[p] && previdx[h->track[p]] > -1) a->prevmask |= 1u << previdx[h->track[p]];
+    }
+    // select the largest regions
+    uint16_t cand[HOTSPOT_MAXROI];
+    for(uint16_t r = 1; r <= n; ++r){
+        hotspot_acc *a = &acc[r];
+        a->ci = -1;
+        if(h->parent[r] != r || a->npix < h->minarea) continue;
+        if(!(a->max > h->thres) && !a->prevmask) continue;
+        int i = nroi;
+        if(nroi < HOTSPOT_MAXROI) ++nroi;
+        else if(acc[cand[nroi-1]].npix >= a->npix) continue;
+        else --i;
+        for(; i > 0 && acc[cand[i-1]].npix < a->npix; --i) cand[i] = cand[i-1];
+        cand[i] = r;
+    }
+    for(int i = 0; i < nroi; ++i) acc[cand[i]].ci = (int8_t)i;
+    // overlapping with previous regions
+    uint16_t ov[HOTSPOT_MAXROI][HOTSPOT_MAXROI];
+    memset(ov, 0, sizeof(ov));
+    for(uint16_t p = 0; p < MLX_PIXNO; ++p){
+        uint16_t r = h->label[p];
+        if(!r || acc[r].ci < 0 || !h->track[p] || previdx[h->track[p]] < 0) continue;
+        ++ov[acc[r].ci][previdx[h->track[p]]];
+    }
+    int taken[HOTSPOT_MAXROI] = {0};
+    for(int i = 0; i < nroi; ++i){ // the largest region gets track first
+        hotspot_acc *a = &acc[cand[i]];
+        hotspot_roi *roi = &h->roi[i];
+        *roi = (hotspot_roi){.npix = a->npix, .argmax = a->argmax, .max = a->max, .mean = a->sum / a->npix};
+        int best = -1;
+        for(int j = 0; j < nprev; ++j){
+            if(taken[j] || !ov[i][j]) continue;
+            if(best < 0 || ov[i][j] > ov[i][best]) best = j;
+        }
+        if(best > -1){
+            taken[best] = 1;
+            roi->id = prev[best].id;
+            roi->rep_max = prev[best].rep_max;
+            roi->rep_argmax = prev[best].rep_argmax;
+            float dT = roi->max - roi->rep_max;
+            if(dT < 0.f) dT = -dT;
+            if(dT >= h->dT || pixdist(roi->argmax, roi->rep_argmax) >= h->dpos){
+                roi->rep_max = roi->max;
+                roi->rep_argmax = roi->argmax;
+                nev = addevent(ev, nev, maxev, HOTSPOT_UPDATE, roi);
+            }
+        }else{
+            do roi->id = h->nextid++; while(!roi->id || used[roi->id]);
+            used[roi->id] = 1;
+            roi->rep_max = roi->max;
+            roi->rep_argmax = roi->argmax;
+            nev = addevent(ev, nev, maxev, HOTSPOT_APPEAR, roi);
+        }
+    }
+    for(int j = 0; j < nprev; ++j)
+        if(!taken[j]) nev = addevent(ev, nev, maxev, HOTSPOT_VANISH, &prev[j]);
+    h->nroi = nroi;
+    for(uint16_t p = 0; p < MLX_PIXNO; ++p){
+        uint16_t r = h->label[p];
+        h->track[p] = (r && acc[r].ci > -1) ? h->roi[acc[r].ci].id : 0;
+    }
+    return nev;
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mlx90640.h"
+
+// max amount of tracked hot regions (the smallest ones are ignored), not more than 32
+#define HOTSPOT_MAXROI      (16)
+// default change of region max temperature to report it again, degrC
+#define HOTSPOT_DT          (1.f)
+// default shift of region max position to report it again, pixels
+#define HOTSPOT_DPOS        (2)
+// default hysteresis: tracked region lives while its pixels are hotter than `thres - hyst`
+#define HOTSPOT_HYST        (0.5f)
+// max amount of events of one image
+#define HOTSPOT_MAXEV       (2*HOTSPOT_MAXROI)
+// max amount of provisional labels: pixels starting new label are never 8-connected
+#define HOTSPOT_MAXLABELS   (MLX_PIXNO/4 + 1)
+
+// statistics of whole image
+typedef struct{
+    float min;
+    float max;
+    float mean;
+    uint16_t argmin;
+    uint16_t argmax;
+} hotspot_stat;
+
+// connected region of pixels hotter than threshold
+typedef struct{
+    uint8_t id;                 // track number (the same for overlapping regions of subsequent frames)
+    uint16_t npix;              // area
+    uint16_t argmax;            // pixel with max temperature
+    float max;
+    float mean;
+    // last reported values
+    uint16_t rep_argmax;
+    float rep_max;
+} hotspot_roi;
+
+typedef enum{
+    HOTSPOT_APPEAR = 1,         // new region
+    HOTSPOT_UPDATE,             // region max temperature or its position changed
+    HOTSPOT_VANISH              // region disappeared
+} hotspot_evtype;
+
+// 16 bytes of region state change
+typedef struct{
+    uint8_t type;               // hotspot_evtype
+    uint8_t id;                 // region track number
+    uint16_t npix;
+    uint16_t argmax;            // row*MLX_W + col
+    uint16_t reserved;
+    float max;
+    float mean;
+} hotspot_event;
+
+// per-label accumulator
+typedef struct{
+    uint16_t npix;
+    uint16_t argmax;
+    uint32_t prevmask;          // bitmask of overlapped regions of previous image
+    int8_t ci;                  // index in `roi` or -1
+    float sum;
+    float max;
+} hotspot_acc;
+
+// detector state: all buffers are preallocated, so hotspot_process() does no allocations
+typedef struct{
+    float thres;                // region threshold, degrC
+    float hyst;                 // threshold hysteresis
+    uint16_t minarea;           // min region area, pixels
+    float dT;                   // report region again when its max changed by `dT`
+    int dpos;                   // ... or max position moved by `dpos` pixels
+    hotspot_stat stat;          // stat of last image
+    int nroi;
+    hotspot_roi roi[HOTSPOT_MAXROI];
+    uint8_t nextid;             // next track number
+    // work buffers
+    uint16_t label[MLX_PIXNO];  // connected component label (0 - cold pixel)
+    uint16_t parent[MLX_PIXNO]; // union-find forest of provisional labels
+    uint8_t track[MLX_PIXNO];   // track id of pixels of previous image (0 - cold pixel)
+    hotspot_acc acc[HOTSPOT_MAXLABELS];
+} hotspot;
+
+void hotspot_init(hotspot *h, float thres, uint16_t minarea);
+void hotspot_stats(const double *image, hotspot_stat *st);
+int hotspot_process(hotspot *h, const double *image, hotspot_event *ev, int maxev);
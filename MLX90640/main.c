@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <math.h>
 #include <signal.h>
 #include <stdio.h>
@@ -23,9 +24,15 @@
 #include <usefull_macros.h>
 
 #include "cmdlnopts.h"
+#include "hotspot.h"
 #include "mlx90640.h"
+#include "pixstat.h"
+#include "recorder.h"
 
 static glob_pars *GP = NULL;
+static mlx90640_dev *mlx = NULL;
+static mlxrec *rec = NULL;
+static volatile sig_atomic_t stop = 0; // signal got while recording
 
 void signals(int sig){
     if(sig){
@@ -33,19 +40,66 @@ void signals(int sig){
         DBG("Get signal %d, quit.\n", sig);
     }
     LOGERR("Exit with status %d", sig);
+    mlxrec_close(rec); // truncate record to its real size
     if(GP && GP->pidfile) // remove unnesessary PID file
         unlink(GP->pidfile);
     exit(sig);
 }
 
-static double image[MLX_PIXNO];
-static double image2[MLX_PIXNO];
-static void pushima(const double *img){
-    for(int i = 0; i < MLX_PIXNO; ++i){
-        register double val = *img++;
-        image[i] += val;
-        image2[i] += val*val;
+// record can't be closed in signal handler (it could interrupt mlxrec_write()), so just stop capture loop
+static void stopsig(int sig){
+    stop = sig;
+}
+
+// interval of dead pixels search (frames)
+#define DEADPIX_INTERVAL    (32)
+
+static pixstat stat;
+static hotspot hot;
+// dead pixels found at runtime (accumulated: interpolated pixel won't be found dead again)
+static uint32_t deadpix[MLX_OUTLWORDS];
+static int ninterp = -1; // amount of interpolated pixels or -1 if dead pixels weren't searched yet
+
+// find dead pixels by current statistics and interpolate them in next images
+static void chkdead(uint32_t seqno){
+    uint32_t dead[MLX_OUTLWORDS];
+    int changed = 0;
+    pixstat_badmaps(&stat, PIXSTAT_DEAD_RMS, PIXSTAT_NOISY_K, dead, NULL);
+    for(int i = 0; i < MLX_OUTLWORDS; ++i){
+        if((deadpix[i] | dead[i]) == deadpix[i]) continue;
+        deadpix[i] |= dead[i];
+        changed = 1;
+    }
+    if(ninterp > -1 && !changed) return;
+    ninterp = mlx90640_set_deadpixels(mlx, deadpix);
+    if(changed) printf("Frame %u: dead pixels found, %d pixels are interpolated now\n", seqno, ninterp);
+}
+
+// get next image in blocking or stream mode
+static double *getima(double *Tstamp, uint32_t *seqno){
+    static mlx90640_frame frame;
+    double *ima = NULL;
+    if(!GP->stream){
+        if(!mlx90640_take_image(mlx, GP->simple, &ima)) return NULL;
+        if(Tstamp) *Tstamp = dtime();
+        if(seqno) *seqno = ++frame.seqno;
+        return ima;
     }
+    if(!mlx90640_stream_latest(mlx, &frame, frame.seqno, MLX_TIMEOUT)) return NULL;
+    if(frame.dropped) DBG("Dropped %u subpages", frame.dropped);
+    if(Tstamp) *Tstamp = frame.Tstamp;
+    if(seqno) *seqno = frame.seqno;
+    return frame.image;
+}
+
+// print changes of hot regions
+static void printhot(uint32_t seqno, const double *ima){
+    static const char *evname[] = {[HOTSPOT_APPEAR] = "appear", [HOTSPOT_UPDATE] = "update", [HOTSPOT_VANISH] = "vanish"};
+    hotspot_event ev[HOTSPOT_MAXEV];
+    int n = hotspot_process(&hot, ima, ev, HOTSPOT_MAXEV);
+    for(int i = 0; i < n; ++i)
+        printf("Frame %u: region %u %s, %u pixels, max=%.1f @ (%d, %d), mean=%.1f\n", seqno, ev[i].id,
+               evname[ev[i].type], ev[i].npix, ev[i].max, ev[i].argmax % MLX_W, ev[i].argmax / MLX_W, ev[i].mean);
 }
 
 int main (int argc, char **argv){
@@ -57,41 +111,77 @@ int main (int argc, char **argv){
     if(GP->addr < 0 || GP->addr > 0xff) ERRX("Wrong I2C address");
     if(GP->logfile) OPENLOG(GP->logfile, LOGLEVEL_ANY, 1);
     if(GP->simple < 0 || GP->simple > 2) ERRX("simple = 0..2");
-    if(!mlx90640_init(GP->device, (uint8_t)GP->addr)) ERR("Can't open device");
-    //mlx90640_dump_parameters();
-    double *ima = NULL;
-    if(!mlx90640_take_image(GP->simple, &ima) || !ima) ERRX("Can't take image"); // take trash image
-#define N 10
-    double T0 = dtime();
+    if(GP->nframes < 0) ERRX("nframes should be >= 0");
+    if(GP->keyint < 1 || GP->keyint > UINT16_MAX) ERRX("keyint = 1..65535");
+    if(GP->minarea < 1 || GP->minarea > MLX_PIXNO) ERRX("minarea = 1..%d", MLX_PIXNO);
+    if(GP->caldir) mlx90640_set_caldir(GP->caldir);
+    if(!(mlx = mlx90640_init(GP->device, (uint8_t)GP->addr))) ERR("Can't open device");
+    if(!mlx90640_set_mode(mlx, GP->refresh, GP->resolution)) ERRX("Wrong refresh rate or resolution");
+    if(!mlx90640_set_fillmode(mlx, GP->fill)) ERRX("Wrong fill mode");
+    if(GP->dump){
+        char fname[PATH_MAX];
+        snprintf(fname, PATH_MAX, "%s.eeprom", GP->dump);
+        if(!mlx90640_dump_eeprom(mlx, fname)) ERRX("Can't dump EEPROM to %s", fname);
+        snprintf(fname, PATH_MAX, "%s.raw", GP->dump);
+        if(!mlx90640_set_rawdump(mlx, fname)) ERRX("Can't dump raw data to %s", fname);
+    }
+    //mlx90640_dump_parameters(mlx);
+    if(GP->stream && !mlx90640_stream_start(mlx, GP->simple, NULL)) ERRX("Can't run stream mode");
+    double *ima = getima(NULL, NULL);
+    if(!ima) ERRX("Can't take image"); // take trash image
+    if(GP->record){
+        if(!(rec = mlxrec_create(GP->record, (uint16_t)GP->keyint))) ERRX("Can't create record %s", GP->record);
+        signal(SIGTERM, stopsig);
+        signal(SIGINT, stopsig);
+        signal(SIGQUIT, stopsig);
+    }
+    double T0 = dtime(), Tstamp;
+    uint32_t seqno;
+    int hotspots = !isnan(GP->hotthres);
+    if(hotspots) hotspot_init(&hot, (float)GP->hotthres, (uint16_t)GP->minarea);
     //for(uint8_t simple = 0; simple < 3; ++simple){
-        memset(image, 0, sizeof(image));
-        memset(image2, 0, sizeof(image));
-        for(int i = 0; i < N; ++i){
-            if(!mlx90640_take_image(GP->simple, &ima) || !ima) ERRX("Can't take image");
-            printf("Got image %d, T=%g; val[0]=%g, val[1]=%g\n", i, dtime() - T0, ima[0], ima[1]);
-            pushima(ima);
+        pixstat_init(&stat, GP->nframes);
+        for(int i = 0; !stop && (GP->nframes == 0 || i < GP->nframes); ++i){
+            if(!(ima = getima(&Tstamp, &seqno))){
+                if(stop) break;
+                ERRX("Can't take image");
+            }
+            if(rec){
+                if(!mlxrec_write(rec, ima, Tstamp, seqno)) ERRX("Can't write record");
+            }else printf("Got image %d, T=%g (%u status polls); val[0]=%g, val[1]=%g\n", i, dtime() - T0,
+                   mlx90640_get_polls(mlx), ima[0], ima[1]);
+            pixstat_push(&stat, ima);
+            if((i + 1) % DEADPIX_INTERVAL == 0) chkdead(seqno);
+            if(hotspots) printhot(seqno, ima);
             T0 = dtime();
         }
-        double *im = image, *im2 = image2;
+        mlxrec_close(rec);
+        rec = NULL;
+        if(stop) signals(stop);
+        mlx90640_stream_stop(mlx);
+        float *im = stat.mean;
         green("\nImage (simple=%d):\n", GP->simple);
         for(int row = 0; row < MLX_H; ++row){
             for(int col = 0; col < MLX_W; ++col){
-                double v = *im++, v2 = *im2;
-                v /= N; v2 /= N;
-                printf("%6.1f ", v);
-                *im2++ = v2 - v*v; // now it is std
+                printf("%6.1f ", *im++);
             }
             printf("\n");
         }
 
         green("\nRMS:\n");
-        im2 = image2;
+        static float rms[MLX_PIXNO];
+        pixstat_rms(&stat, rms);
+        im = rms;
         for(int row = 0; row < MLX_H; ++row){
             for(int col = 0; col < MLX_W; ++col){
-                printf("%6.2f ", sqrt(*im2++));
+                printf("%6.2f ", *im++);
             }
             printf("\n");
         }
+        int nbad = pixstat_badmaps(&stat, PIXSTAT_DEAD_RMS, PIXSTAT_NOISY_K, NULL, NULL);
+        green("\nMedian RMS: %.3f, bad pixels: %d\n", pixstat_median_rms(&stat), nbad);
+        if(ninterp > -1) green("Interpolated pixels: %d\n", ninterp);
     //}
+    mlx90640_close(mlx);
     return 0;
 }
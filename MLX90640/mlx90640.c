@@ -16,109 +16,273 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <usefull_macros.h>
 #include <fcntl.h>
-#include <sys/ioctl.h>
-#include <asm/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
+#include <limits.h>
 
+#include "i2cbus.h"
 #include "mlx90640.h"
+#include "mlx90640_internal.h"
 #include "mlx90640_regs.h"
 
 
-static int I2Cfd = -1;
-static uint8_t lastaddr = 0;
-static MLX90640_params params;
+// ways to read big blocks of data (the best one supported by adapter is chosen at first read)
+enum{
+    RDMODE_SINGLE,                  // whole block in one message
+    RDMODE_CHAINED,                 // chunks by chained messages in one transfer
+    RDMODE_SPLIT                    // separate transfer for each chunk
+};
 
-static uint16_t dataarray[MLX_DMA_MAXLEN]; // array for raw data from sensor
-static double mlx_image[MLX_PIXNO]; // ready image
+// bad pixel interpolation: pixel `pix` = sum(w[i] * image[neigh[i]])
+#define BADPIX_MAXNEIGH     (8)
+typedef struct{
+    uint16_t pix;
+    uint16_t n;
+    uint16_t neigh[BADPIX_MAXNEIGH];
+    float w[BADPIX_MAXNEIGH];
+} badpix_interp;
 
-#define CREG_VAL(reg) dataarray[CREG_IDX(reg)]
-#define IMD_VAL(reg) dataarray[IMD_IDX(reg)]
+// I2C bus shared by sensors; one acquisition thread per bus interleaves all streaming sensors
+typedef struct mlx_bus{
+    char *path;                     // device path
+    i2cbus *i2c;                    // opened device (or simulator)
+    int nref;                       // amount of sensors opened on this bus
+    int rdmode;                     // RDMODE_xx
+    pthread_t thread;               // acquisition thread
+    volatile int run;               // thread is running
+    pthread_mutex_t mutex;          // protects `streaming` list
+    mlx90640_dev *streaming;        // list of streaming sensors
+    struct mlx_bus *next;
+} mlx_bus;
+
+// opened buses
+static mlx_bus *buses = NULL;
+static pthread_mutex_t buses_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct mlx90640_dev{
+    MLX90640_fparams fparams;       // single precision calibration data (`params` are kept for reference path)
+    struct{                         // calibration cache: fused per-pixel values of each subpage for last Ta/Vdd
+        mlx_fused_t f[2];
+        double dTa[2];              // Ta and Vdd used to build `f`
+        double dvdd[2];
+        int valid[2];
+        double thres_dTa;           // rebuild thresholds
+        double thres_dvdd;
+    } calcache;
+    MLX90640_params params;
+    int fparams_ready;
+    mlx_bus *bus;
+    uint8_t addr;                   // I2C slave address
+    uint16_t control;               // REG_CONTROL base value: refresh rate and resolution
+    int errctr;                     // counter of errors
+    double Tlast;                   // time of last state change
+    uint16_t dataarray[MLX_DMA_MAXLEN]; // array for raw data from sensor
+    double image[MLX_PIXNO];        // ready image
+    uint32_t deadpix[MLX_OUTLWORDS];// bad pixels found at runtime
+    badpix_interp badpix[MLX_MAXBADPIX]; // interpolation of outliers and dead pixels
+    int nbadpix;
+    struct{                         // prediction of subpage readiness
+        double period;              // subpage period, s
+        double tpoll;               // time of next status poll (CLOCK_MONOTONIC), s
+        uint32_t polls;             // status polls for current frame
+        uint32_t lastpolls;         // status polls spent for last frame
+    } sched;
+    FILE *rawdump;                  // file for raw subpages dump
+    struct{                         // image after each subpage
+        mlx_fillmode mode;
+        int have;                   // bitmask of subpages in `image`
+        int next;                   // next subpage to read in blocking mode
+        double image[MLX_PIXNO];    // the latest values of all pixels
+    } sub;
+    struct{                         // stream mode data
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        volatile int run;           // sensor is in bus streaming list
+        uint8_t simple;             // image processing type
+        mlx90640_frame_cb cb;       // user callback
+        int latest;                 // index of last ready frame in `ring` (-1 if none)
+        uint32_t seqno;             // number of last ready frame
+        uint32_t dropped;           // amount of dropped subpages
+        int sp_expected;            // next subpage expected
+        int widx;                   // index of frame being filled
+        int errs;                   // amount of restarts by timeout
+        double tlast;               // time of last subpage got
+        mlx90640_frame ring[MLX_RING_SIZE];
+    } stream;
+    mlx90640_dev *next;             // next streaming sensor on the same bus
+} __attribute__((aligned(16)));
+
+#define CREG_VAL(reg) d->dataarray[CREG_IDX(reg)]
+#define IMD_VAL(reg) d->dataarray[IMD_IDX(reg)]
+
+// REG_CONTROL bits used in all modes (besides refresh rate and resolution)
+#define REG_CONTROL_BASE    (REG_CONTROL_CHESS | REG_CONTROL_SUBPEN)
+// REG_CONTROL value for given subpage in blocking mode (forced subpage, data hold)
+#define REG_CONTROL_SP(d, sp)   ((d)->control | REG_CONTROL_SUBPSEL | REG_CONTROL_DATAHOLD | ((sp) ? REG_CONTROL_SUBP1 : 0))
+// REG_CONTROL value for stream mode: subpages toggle automatically, data transferred each subpage
+#define REG_CONTROL_STREAM(d)   ((d)->control)
+
+
+
+// state helpers (need `d` in scope)
+#define chstate()  do{d->errctr = 0; d->Tlast = dtime(); DBG("chstate()");}while(0)
+#define chkerr()   do{DBG("chkerr(), T=%g", dtime()-d->Tlast); if(++d->errctr > MLX_MAXERR_COUNT){ DBG("-> M_ERROR"); return FALSE;}else continue;}while(0)
+#define chktmout() do{/*DBG("chktmout, T=%g", dtime()-d->Tlast);*/ if(dtime() - d->Tlast > MLX_TIMEOUT){ DBG("Timeout! -> M_ERROR"); return FALSE;}else continue;}while(0)
 
-// reg_control values for subpage #0 and #1
-static const uint16_t reg_control_val[2] = {
-    REG_CONTROL_CHESS | REG_CONTROL_RES18 | REG_CONTROL_REFR_8HZ | REG_CONTROL_SUBPSEL | REG_CONTROL_DATAHOLD | REG_CONTROL_SUBPEN,
-    REG_CONTROL_CHESS | REG_CONTROL_RES18 | REG_CONTROL_REFR_8HZ | REG_CONTROL_SUBP1 | REG_CONTROL_SUBPSEL | REG_CONTROL_DATAHOLD | REG_CONTROL_SUBPEN
-};
 
+/*****************************************************************************
+                Subpage ready time prediction
+ *****************************************************************************/
+
+static double mono_time(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// sleep until monotonic time `t`
+static void sleep_until(double t){
+    if(t <= mono_time()) return;
+    struct timespec ts = {.tv_sec = (time_t)t};
+    ts.tv_nsec = (long)((t - (double)ts.tv_sec) * 1e9);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// subpage period for given REG_CONTROL value, s
+static double subpage_period(uint16_t control){
+    return 2. / (double)(1 << ((control & REG_CONTROL_REFRMASK) >> 7));
+}
 
-static int errctr = 0;
-static double Tlast = 0.;
-#define chstate()  do{errctr = 0; Tlast = dtime(); DBG("chstate()");}while(0)
-#define chkerr()   do{DBG("chkerr(), T=%g", dtime()-Tlast); if(++errctr > MLX_MAXERR_COUNT){ DBG("-> M_ERROR"); return FALSE;}else continue;}while(0)
-#define chktmout() do{/*DBG("chktmout, T=%g", dtime()-Tlast);*/ if(dtime() - Tlast > MLX_TIMEOUT){ DBG("Timeout! -> M_ERROR"); return FALSE;}else continue;}while(0)
+// NEWDATA got at `now`: next subpage will be ready one period later
+static void sched_ready(mlx90640_dev *d, double now){
+    double adv = d->sched.period * MLX_WAKE_ADVANCE;
+    if(adv < 2. * MLX_POLL_INTERVAL) adv = 2. * MLX_POLL_INTERVAL;
+    d->sched.tpoll = now + d->sched.period - adv;
+}
 
+// no data at `now`: poll again after minimal interval
+static void sched_notready(mlx90640_dev *d, double now){
+    d->sched.tpoll = now + MLX_POLL_INTERVAL;
+}
 
 // read register value
-static int read_reg(uint16_t regaddr, uint16_t *data){
-    if(I2Cfd < 1) return FALSE;
+static int read_reg(mlx90640_dev *d, uint16_t regaddr, uint16_t *data){
+    if(!d->bus->i2c) return FALSE;
     struct i2c_msg m[2];
-    struct i2c_rdwr_ioctl_data x = {.msgs = m, .nmsgs = 2};
-    m[0].addr = lastaddr; m[1].addr = lastaddr;
+    m[0].addr = d->addr; m[1].addr = d->addr;
     m[0].flags = 0;
     m[1].flags = I2C_M_RD;
     m[0].len = 2; m[1].len = 2;
-    uint8_t a[2], d[2] = {0};
+    uint8_t a[2], b[2] = {0};
     a[0] = regaddr >> 8;
     a[1] = regaddr & 0xff;
-    m[0].buf = a; m[1].buf = d;
-    if(ioctl(I2Cfd, I2C_RDWR, &x) < 0) return FALSE;
-    if(data) *data = (uint16_t)((d[0] << 8) | (d[1]));
+    m[0].buf = a; m[1].buf = b;
+    if(!i2cbus_transfer(d->bus->i2c, m, 2)) return FALSE;
+    if(data) *data = (uint16_t)((b[0] << 8) | (b[1]));
     return TRUE;
 }
 
 
 //#if 0
 // read N values starting from regaddr
-static int read_regN(uint16_t regaddr, uint16_t *data, uint16_t N){
-    if(I2Cfd < 1 || N > 128 || N == 0) return FALSE;
+static int read_regN(mlx90640_dev *d, uint16_t regaddr, uint16_t *data, uint16_t N){
+    if(!d->bus->i2c || N > 128 || N == 0) return FALSE;
     struct i2c_msg m[2];
-    struct i2c_rdwr_ioctl_data x = {.msgs = m, .nmsgs = 2};
-    m[0].addr = lastaddr; m[1].addr = lastaddr;
+    m[0].addr = d->addr; m[1].addr = d->addr;
     m[0].flags = 0;
     m[1].flags = I2C_M_RD;
     m[0].len = 2; m[1].len = N * 2;
-    uint8_t a[2], d[256] = {0};
+    uint8_t a[2], b[256] = {0};
     a[0] = regaddr >> 8;
     a[1] = regaddr & 0xff;
-    m[0].buf = a; m[1].buf = d;
-    if(ioctl(I2Cfd, I2C_RDWR, &x) < 0) return FALSE;
+    m[0].buf = a; m[1].buf = b;
+    if(!i2cbus_transfer(d->bus->i2c, m, 2)) return FALSE;
     if(data) for(int i = 0; i < N; ++i){
-//        DBG("Read 0x%04x from reg 0x%04x", (uint16_t)((d[2*i] << 8) | (d[2*i+1])), regaddr+i);
-        *data++ = (uint16_t)((d[2*i] << 8) | (d[2*i + 1]));
+//        DBG("Read 0x%04x from reg 0x%04x", (uint16_t)((b[2*i] << 8) | (b[2*i+1])), regaddr+i);
+        *data++ = (uint16_t)((b[2*i] << 8) | (b[2*i + 1]));
     }
     return TRUE;
 }
 
-// blocking read N uint16_t values starting from `reg`
+// max words in one chunk for adapters which can't read whole frame in one message
+#define RD_CHUNK        (128)
+#define RD_MAXCHUNKS    ((MLX_DMA_MAXLEN + RD_CHUNK - 1) / RD_CHUNK)
+
+/**
+ * @brief read_chunks - read raw (big-endian) data by message pairs [reg address, data]
+ * @param reg - first register
+ * @param buf - output buffer
+ * @param N - amount of words
+ * @param chunk - max words in one message
+ * @param chained - TRUE to send all messages in one transfer, FALSE - one transfer for each chunk
+ * @return FALSE if failed (errno is set by transport)
+ */
+static int read_chunks(mlx90640_dev *d, uint16_t reg, uint8_t *buf, uint16_t N, uint16_t chunk, int chained){
+    struct i2c_msg m[2*RD_MAXCHUNKS];
+    uint8_t a[RD_MAXCHUNKS][2];
+    int nmsgs = 0;
+    for(int k = 0; N; ++k){
+        uint16_t l = (N > chunk) ? chunk : N;
+        a[k][0] = reg >> 8;
+        a[k][1] = reg & 0xff;
+        struct i2c_msg *mp = &m[nmsgs];
+        mp[0] = (struct i2c_msg){.addr = d->addr, .flags = 0, .len = 2, .buf = a[k]};
+        mp[1] = (struct i2c_msg){.addr = d->addr, .flags = I2C_M_RD, .len = l * 2, .buf = buf};
+        nmsgs += 2;
+        if(!chained){
+            if(!i2cbus_transfer(d->bus->i2c, m, nmsgs)) return FALSE;
+            nmsgs = 0;
+        }
+        reg += l; buf += 2 * l; N -= l;
+    }
+    if(chained && !i2cbus_transfer(d->bus->i2c, m, nmsgs)) return FALSE;
+    return TRUE;
+}
+
+// blocking read N uint16_t values starting from `reg` directly into `dataarray` and swap bytes in place;
+// the whole block is read in one message if adapter allows, else by chained or separate chunks
 // @param reg - register to read
-// @param N (io) - amount of bytes to read / bytes read
+// @param N (io) - amount of words to read / words read
 // @return `dataarray` or NULL if failed
-static uint16_t *read_data(uint16_t reg, uint16_t *N){
-    if(I2Cfd < 1 || !N || *N < 1) return NULL;
+static uint16_t *read_data(mlx90640_dev *d, uint16_t reg, uint16_t *N){
+    if(!d->bus->i2c || !N || *N < 1) return NULL;
     uint16_t n = *N;
     if(n < 1 || n > MLX_DMA_MAXLEN) return NULL;
-    uint16_t *data = dataarray;
-    uint16_t got = 0, rest = *N;
-    do{
-        uint8_t l = (rest > 128) ? 128 : (uint8_t)rest;
-        if(!read_regN(reg, data, l)){
-            DBG("can't read");
+    uint8_t *buf = (uint8_t*)d->dataarray;
+    *N = 0;
+    while(1){
+        int mode = d->bus->rdmode, ok;
+        switch(mode){
+            case RDMODE_SINGLE:
+                ok = read_chunks(d, reg, buf, n, n, TRUE);
+            break;
+            case RDMODE_CHAINED:
+                ok = read_chunks(d, reg, buf, n, RD_CHUNK, TRUE);
             break;
+            default:
+                ok = read_chunks(d, reg, buf, n, RD_CHUNK, FALSE);
+        }
+        if(ok) break;
+        // adapter limitations: try simpler way; other errors are passed to caller
+        if(mode == RDMODE_SPLIT || (errno != EOPNOTSUPP && errno != EINVAL && errno != EMSGSIZE)){
+            DBG("can't read");
+            return NULL;
         }
-        rest -= l;
-        reg += l;
-        data += l;
-        got += l;
-    }while(rest);
-    *N = got;
-    return dataarray;
+        WARNX("Bus %s: can't read %d words by read mode %d, try next", d->bus->path, n, mode);
+        d->bus->rdmode = mode + 1;
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    mlx_bswap16(d->dataarray, n);
+#endif
+    *N = n;
+    return d->dataarray;
 }
 //#endif
 #if 0
@@ -126,44 +290,90 @@ static uint16_t *read_data(uint16_t reg, uint16_t *N){
 // @param reg - register to read
 // @param N (io) - amount of bytes to read / bytes read
 // @return `dataarray` or NULL if failed
-static uint16_t *read_data(uint16_t reg, uint16_t *N){
-    if(I2Cfd < 1 || !N || *N < 1) return NULL;
+static uint16_t *read_data(mlx90640_dev *d, uint16_t reg, uint16_t *N){
+    if(!d->bus->i2c || !N || *N < 1) return NULL;
     uint16_t n = *N;
     if(n < 1 || n > MLX_DMA_MAXLEN) return NULL;
-    uint16_t i, *data = dataarray;
+    uint16_t i, *data = d->dataarray;
     for(i = 0; i < n; ++i){
-        if(!read_reg(reg++, data++)){
+        if(!read_reg(d, reg++, data++)){
             DBG("can't read");
             break;
         }
     }
     *N = i;
-    return dataarray;
+    return d->dataarray;
 }
 #endif
 
 
 // write register value
-static int write_reg(uint16_t regaddr, uint16_t data){
-    if(I2Cfd < 1) return FALSE;
-    union i2c_smbus_data d;
-    d.block[0] = 3;
-    d.block[1] = regaddr & 0xff;
-    d.block[2] = data >> 8;
-    d.block[3] = data & 0xff;
-    struct i2c_smbus_ioctl_data args;
-    args.read_write = I2C_SMBUS_WRITE;
-    args.command    = regaddr >> 8;
-    args.size       = I2C_SMBUS_I2C_BLOCK_DATA;
-    args.data       = &d;
-    if(ioctl(I2Cfd, I2C_SMBUS, &args) < 0) return FALSE;
+// (with explicit address: bus is shared between sensors)
+static int write_reg(mlx90640_dev *d, uint16_t regaddr, uint16_t data){
+    if(!d->bus->i2c) return FALSE;
+    uint8_t b[4] = {regaddr >> 8, regaddr & 0xff, data >> 8, data & 0xff};
+    return i2cbus_write(d->bus->i2c, d->addr, b, 4);
+}
+
+// change I2C address of sensor `d` is working with
+int mlx90640_set_slave_address(mlx90640_dev *d, uint8_t addr){
+    if(!d || !d->bus->i2c) return FALSE;
+    uint8_t old = d->addr;
+    d->addr = addr;
+    if(!read_reg(d, REG_STATUS, NULL)){
+        d->addr = old;
+        return FALSE;
+    }
     return TRUE;
 }
 
-int mlx90640_set_slave_address(uint8_t addr){
-    if(I2Cfd < 1) return FALSE;
-    if(ioctl (I2Cfd, I2C_SLAVE, addr) < 0) return FALSE;
-    lastaddr = addr;
+/**
+ * @brief i2c_clock - get I2C bus clock frequency from device tree
+ * @param path - I2C device path (/dev/i2c-N)
+ * @return frequency (Hz) or 0 if unknown
+ */
+static uint32_t i2c_clock(const char *path){
+    const char *n = strrchr(path, '-');
+    if(!n) return 0;
+    char name[PATH_MAX];
+    snprintf(name, PATH_MAX, "/sys/class/i2c-adapter/i2c-%s/of_node/clock-frequency", n + 1);
+    int fd = open(name, O_RDONLY);
+    if(fd < 0) return 0;
+    uint8_t b[4]; // big-endian u32
+    ssize_t r = read(fd, b, 4);
+    close(fd);
+    if(r != 4) return 0;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+/**
+ * @brief mlx90640_set_mode - set refresh rate and ADC resolution
+ * @param d - sensor
+ * @param refresh - subpage refresh rate, Hz: 0.5, 1, 2, 4, 8, 16, 32 or 64
+ * @param resolution - ADC resolution, bits: 16..19
+ * @return FALSE if wrong values or stream is running
+ * Warns if I2C clock is too slow to read each subpage in time.
+ */
+int mlx90640_set_mode(mlx90640_dev *d, double refresh, int resolution){
+    if(!d || d->stream.run) return FALSE;
+    if(resolution < MLX_RESOL_MIN || resolution > MLX_RESOL_MAX){
+        WARNX("Resolution should be %d..%d bits", MLX_RESOL_MIN, MLX_RESOL_MAX);
+        return FALSE;
+    }
+    int refr = -1;
+    for(int i = 0; i < 8; ++i) if(fabs(refresh - 0.5 * (1 << i)) < 1e-3){ refr = i; break; }
+    if(refr < 0){
+        WARNX("Refresh rate should be one of 0.5, 1, 2, 4, 8, 16, 32, 64 Hz");
+        return FALSE;
+    }
+    d->control = REG_CONTROL_BASE | (refr << 7) | ((resolution - MLX_RESOL_MIN) << 10);
+    d->sched.period = subpage_period(d->control);
+    // each subpage: MLX_PIXARRSZ words + address + status read/write; 9 clocks per byte
+    double need = refresh * (MLX_PIXARRSZ * 2 + 16) * 9. * MLX_I2C_MARGIN;
+    uint32_t clk = i2c_clock(d->bus->path);
+    DBG("refresh=%g, resolution=%d, control=0x%04x, I2C clock: %u (need %.0f)", refresh, resolution, d->control, clk, need);
+    if(clk && clk < need)
+        WARNX("I2C clock %u Hz is too slow for %g Hz refresh rate (need >= %.0f Hz): subpages will be lost", clk, refresh, need);
     return TRUE;
 }
 
@@ -176,23 +386,22 @@ static void dumpIma(double *im){
     }
 }
 
-void mlx90640_dump_parameters(){
-    printf("kVdd=%d\nvdd25=%d\nKvPTAT=%g\nKtPTAT=%g\nvPTAT25=%d\n", params.kVdd, params.vdd25, params.KvPTAT, params.KtPTAT, params.vPTAT25);
-    printf("alphaPTAT=%g\ngainEE=%d\ntgc=%g\ncpKv=%g\ncpKta=%g\n", params.alphaPTAT, params.gainEE, params.tgc, params.cpKta, params.cpKta);
-    printf("KsTa=%g\nCT[]={%g, %g, %g}\n", params.KsTa, params.CT[0], params.CT[1], params.CT[2]);
-    printf("ksTo[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", params.ksTo[i]); printf("}\n");
-    printf("alphacorr[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", params.alphacorr[i]); printf("}\n");
-    printf("alpha[]=\n"); dumpIma(params.alpha);
-    printf("offset[]=\n"); dumpIma(params.offset);
-    printf("kta[]=\n"); dumpIma(params.kta);
-    printf("kv[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", params.kv[i]); printf("}\n");
-    printf("cpAlpha[]={%g, %g}\n", params.cpAlpha[0], params.cpAlpha[1]);
-    printf("cpOffset[]={%d, %d}\n", params.cpOffset[0], params.cpOffset[1]);
+void mlx90640_dump_parameters(mlx90640_dev *d){
+    printf("kVdd=%d\nvdd25=%d\nKvPTAT=%g\nKtPTAT=%g\nvPTAT25=%d\n", d->params.kVdd, d->params.vdd25, d->params.KvPTAT, d->params.KtPTAT, d->params.vPTAT25);
+    printf("alphaPTAT=%g\ngainEE=%d\ntgc=%g\ncpKv=%g\ncpKta=%g\n", d->params.alphaPTAT, d->params.gainEE, d->params.tgc, d->params.cpKta, d->params.cpKta);
+    printf("KsTa=%g\nCT[]={%g, %g, %g}\n", d->params.KsTa, d->params.CT[0], d->params.CT[1], d->params.CT[2]);
+    printf("ksTo[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", d->params.ksTo[i]); printf("}\n");
+    printf("alphacorr[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", d->params.alphacorr[i]); printf("}\n");
+    printf("alpha[]=\n"); dumpIma(d->params.alpha);
+    printf("offset[]=\n"); dumpIma(d->params.offset);
+    printf("kta[]=\n"); dumpIma(d->params.kta);
+    printf("kv[]={"); for(int i = 0; i < 4; ++i) printf("%s%g", (i) ? ", " : "", d->params.kv[i]); printf("}\n");
+    printf("cpAlpha[]={%g, %g}\n", d->params.cpAlpha[0], d->params.cpAlpha[1]);
+    printf("cpOffset[]={%d, %d}\n", d->params.cpOffset[0], d->params.cpOffset[1]);
     printf("outliers[]=\n");
-    uint8_t *o = params.outliers;
-    for(int row = 0; row < MLX_H; ++row){
-        for(int col = 0; col < MLX_W; ++col){
-            printf("%d ", *o++);
+    for(int row = 0, pixno = 0; row < MLX_H; ++row){
+        for(int col = 0; col < MLX_W; ++col, ++pixno){
+            printf("%d ", MLX_ISOUTLIER(d->params.outliers, pixno));
         }
         printf("\n");
     }
@@ -219,28 +428,28 @@ static void occacc(int8_t *arr, int l, uint16_t *regstart){
 }
 
 // get all parameters' values from `dataarray`, return FALSE if something failed
-static int get_parameters(){
+static int get_parameters(mlx90640_dev *d){
     int8_t i8;
     int16_t i16;
     uint16_t *pu16;
     uint16_t val = CREG_VAL(REG_VDD);
     i8 = (int8_t) (val >> 8);
-    params.kVdd = i8 * 32; // keep sign
-    if(params.kVdd == 0) return FALSE;
+    d->params.kVdd = i8 * 32; // keep sign
+    if(d->params.kVdd == 0) return FALSE;
     i16 = val & 0xFF;
-    params.vdd25 = ((i16 - 0x100) * 32) - (1<<13);
+    d->params.vdd25 = ((i16 - 0x100) * 32) - (1<<13);
     val = CREG_VAL(REG_KVTPTAT);
     i16 = (val & 0xFC00) >> 10;
     if(i16 > 0x1F) i16 -= 0x40;
-    params.KvPTAT = (double)i16 / (1<<12);
+    d->params.KvPTAT = (double)i16 / (1<<12);
     i16 = (val & 0x03FF);
     if(i16 > 0x1FF) i16 -= 0x400;
-    params.KtPTAT = (double)i16 / 8.;
-    params.vPTAT25 = (int16_t) CREG_VAL(REG_PTAT);
+    d->params.KtPTAT = (double)i16 / 8.;
+    d->params.vPTAT25 = (int16_t) CREG_VAL(REG_PTAT);
     val = CREG_VAL(REG_APTATOCCS) >> 12;
-    params.alphaPTAT = val / 4. + 8.;
-    params.gainEE = (int16_t)CREG_VAL(REG_GAIN);
-    if(params.gainEE == 0) return FALSE;
+    d->params.alphaPTAT = val / 4. + 8.;
+    d->params.gainEE = (int16_t)CREG_VAL(REG_GAIN);
+    if(d->params.gainEE == 0) return FALSE;
     int8_t occRow[MLX_H];
     int8_t occColumn[MLX_W];
     occacc(occRow, MLX_H, &CREG_VAL(REG_OCCROW14));
@@ -272,17 +481,17 @@ static int get_parameters(){
     double mul = (double)(1<<scale2), div = (double)(1<<scale1); // kta_scales
     uint16_t a_r = CREG_VAL(REG_SENSIVITY); // alpha_ref
     val = CREG_VAL(REG_SCALEACC);
-    double *a = params.alpha, diva = (double)(val >> 12);
+    double *a = d->params.alpha, diva = (double)(val >> 12);
     diva *= (double)(1<<30); // alpha_scale
     double accRowScale = 1<<((val & 0x0f00)>>8),
           accColumnScale = 1<<((val & 0x00f0)>>4),
           accRemScale = 1<<(val & 0x0f);
     pu16 = &CREG_VAL(REG_OFFAK1);
-    double *kta = params.kta, *offset = params.offset;
-    uint8_t *ol = params.outliers;
-    for(int row = 0; row < MLX_H; ++row){
+    double *kta = d->params.kta, *offset = d->params.offset;
+    memset(d->params.outliers, 0, sizeof(d->params.outliers));
+    for(int row = 0, pixno = 0; row < MLX_H; ++row){
         int idx = (row&1)<<1;
-        for(int col = 0; col < MLX_W; ++col){
+        for(int col = 0; col < MLX_W; ++col, ++pixno){
             // offset
             register uint16_t rv = *pu16++;
             i16 = (rv & 0xFC00) >> 10;
@@ -297,7 +506,7 @@ static int get_parameters(){
             if(i16 > 0x1F) i16 -= 0x40;
             double oft = (double)a_r + accRow[row]*accRowScale + accColumn[col]*accColumnScale +i16*accRemScale;
             *a++ = oft / diva;
-            *ol++ = (rv&1) ? 1 : 0;
+            if(rv & 1) d->params.outliers[pixno >> 5] |= 1U << (pixno & 31);
         }
     }
     scale1 = (CREG_VAL(REG_KTAVSCALE) >> 8) & 0xF; // kvscale
@@ -311,248 +520,1070 @@ static int get_parameters(){
     ktaavg[2] = (int8_t)i16; // odd col, even row
     i16 = val & 0x0F; if(i16 > 0x07) i16 -= 0x10;
     ktaavg[3] = (int8_t)i16; // even col, even row
-    for(int i = 0; i < 4; ++i) params.kv[i] = ktaavg[i] / div;
+    for(int i = 0; i < 4; ++i) d->params.kv[i] = ktaavg[i] / div;
     val = CREG_VAL(REG_CPOFF);
-    params.cpOffset[0] = (val & 0x03ff);
-    if(params.cpOffset[0] > 0x1ff) params.cpOffset[0] -= 0x400;
-    params.cpOffset[1] = val >> 10;
-    if(params.cpOffset[1] > 0x1f) params.cpOffset[1] -= 0x40;
-    params.cpOffset[1] += params.cpOffset[0];
+    d->params.cpOffset[0] = (val & 0x03ff);
+    if(d->params.cpOffset[0] > 0x1ff) d->params.cpOffset[0] -= 0x400;
+    d->params.cpOffset[1] = val >> 10;
+    if(d->params.cpOffset[1] > 0x1f) d->params.cpOffset[1] -= 0x40;
+    d->params.cpOffset[1] += d->params.cpOffset[0];
     val = ((CREG_VAL(REG_KTAVSCALE) & 0xF0) >> 4) + 8;
     i8 = (int8_t)(CREG_VAL(REG_KVTACP) & 0xFF);
-    params.cpKta = (double)i8 / (1<<val);
+    d->params.cpKta = (double)i8 / (1<<val);
     val = (CREG_VAL(REG_KTAVSCALE) & 0x0F00) >> 8;
     i16 = CREG_VAL(REG_KVTACP) >> 8;
     if(i16 > 0x7F) i16 -= 0x100;
-    params.cpKv = (double)i16 / (1<<val);
+    d->params.cpKv = (double)i16 / (1<<val);
     i16 = CREG_VAL(REG_KSTATGC) & 0xFF;
     if(i16 > 0x7F) i16 -= 0x100;
-    params.tgc = (double)i16;
-    params.tgc /= 32.;
+    d->params.tgc = (double)i16;
+    d->params.tgc /= 32.;
     val = (CREG_VAL(REG_SCALEACC)>>12); // alpha_scale_CP
     i16 = CREG_VAL(REG_ALPHA)>>10; // cp_P1_P0_ratio
     if(i16 > 0x1F) i16 -= 0x40;
     div = (double)(1<<val);
     div *= (double)(1<<27);
-    params.cpAlpha[0] = (double)(CREG_VAL(REG_ALPHA) & 0x03FF) / div;
+    d->params.cpAlpha[0] = (double)(CREG_VAL(REG_ALPHA) & 0x03FF) / div;
     div = (double)(1<<7);
-    params.cpAlpha[1] = params.cpAlpha[0] * (1. + (double)i16/div);
+    d->params.cpAlpha[1] = d->params.cpAlpha[0] * (1. + (double)i16/div);
     i8 = (int8_t)(CREG_VAL(REG_KSTATGC) >> 8);
-    params.KsTa = (double)i8/(1<<13);
+    d->params.KsTa = (double)i8/(1<<13);
     div = 1<<((CREG_VAL(REG_CT34) & 0x0F) + 8); // kstoscale
     DBG("kstoscale=%g (regct34=0x%04x)", div, CREG_VAL(REG_CT34));
     val = CREG_VAL(REG_KSTO12);
     DBG("ksto12=0x%04x", val);
     i8 = (int8_t)(val & 0xFF);
     DBG("To1ee=%d", i8);
-    params.ksTo[0] = i8 / div;
+    d->params.ksTo[0] = i8 / div;
     i8 = (int8_t)(val >> 8);
     DBG("To2ee=%d", i8);
-    params.ksTo[1] = i8 / div;
+    d->params.ksTo[1] = i8 / div;
     val = CREG_VAL(REG_KSTO34);
     DBG("ksto34=0x%04x", val);
     i8 = (int8_t)(val & 0xFF);
     DBG("To3ee=%d", i8);
-    params.ksTo[2] = i8 / div;
+    d->params.ksTo[2] = i8 / div;
     i8 = (int8_t)(val >> 8);
     DBG("To4ee=%d", i8);
-    params.ksTo[3] = i8 / div;
-    params.CT[0] = 0.; // 0degr - between ranges 1 and 2
+    d->params.ksTo[3] = i8 / div;
+    d->params.CT[0] = 0.; // 0degr - between ranges 1 and 2
     val = CREG_VAL(REG_CT34);
     mul = ((val & 0x3000)>>12)*10.; // step
-    params.CT[1] = ((val & 0xF0)>>4)*mul; // CT3 - between ranges 2 and 3
-    params.CT[2] = ((val & 0x0F00) >> 8)*mul + params.CT[1]; // CT4 - between ranges 3 and 4
-    params.alphacorr[0] = 1./(1. + params.ksTo[0] * 40.);
-    params.alphacorr[1] = 1.;
-    params.alphacorr[2] = (1. + params.ksTo[1] * params.CT[1]);
-    params.alphacorr[3] = (1. + params.ksTo[2] * (params.CT[2] - params.CT[1])) * params.alphacorr[2];
-    params.resolEE = (uint8_t)((CREG_VAL(REG_KTAVSCALE) & 0x3000) >> 12);
-    // Don't forget to check 'outlier' flags for wide purpose
+    d->params.CT[1] = ((val & 0xF0)>>4)*mul; // CT3 - between ranges 2 and 3
+    d->params.CT[2] = ((val & 0x0F00) >> 8)*mul + d->params.CT[1]; // CT4 - between ranges 3 and 4
+    d->params.alphacorr[0] = 1./(1. + d->params.ksTo[0] * 40.);
+    d->params.alphacorr[1] = 1.;
+    d->params.alphacorr[2] = (1. + d->params.ksTo[1] * d->params.CT[1]);
+    d->params.alphacorr[3] = (1. + d->params.ksTo[2] * (d->params.CT[2] - d->params.CT[1])) * d->params.alphacorr[2];
+    d->params.resolEE = (uint8_t)((CREG_VAL(REG_KTAVSCALE) & 0x3000) >> 12);
     return TRUE;
 }
 
 /**
- * @brief process_subpage - calculate all parameters from `dataarray` into `mlx_image`
- * @param subpageno - number of subpage
- * @param simpleimage == 0 - simplest, 1 - narrow range, 2 - extended range
+ * @brief mkbadpix - build interpolation list for outliers and runtime dead pixels
+ * Each bad pixel is replaced by weighted sum of good neighbours: 8-connected with weight 1/distance,
+ * or (if they all are bad) 4 pixels at distance 2.
  */
-static void process_subpage(int subpageno, int simpleimage){
-    DBG("\nprocess_subpage(%d)", subpageno);
-#ifdef EBUG
-    chstate();
-#endif
-    double resol_corr = (double)(1<<params.resolEE) / (1<<((reg_control_val[subpageno]&0x0C00)>>10)); // calibrated resol/current resol
-    DBG("resolEE=%d, resolCur=%d", params.resolEE, ((reg_control_val[subpageno]&0x0C00)>>10));
+static void mkbadpix(mlx90640_dev *d){
+    static const struct{ int8_t dr, dc; float w; } nbr[] = {
+        {-1, 0, 1.f}, {1, 0, 1.f}, {0, -1, 1.f}, {0, 1, 1.f},
+        {-1, -1, M_SQRT1_2}, {-1, 1, M_SQRT1_2}, {1, -1, M_SQRT1_2}, {1, 1, M_SQRT1_2},
+        {-2, 0, 0.5f}, {2, 0, 0.5f}, {0, -2, 0.5f}, {0, 2, 0.5f}
+    };
+    uint32_t bad[MLX_OUTLWORDS];
+    for(int i = 0; i < MLX_OUTLWORDS; ++i) bad[i] = d->params.outliers[i] | d->deadpix[i];
+    int nbad = 0;
+    for(int pixno = 0; pixno < MLX_PIXNO; ++pixno){
+        if(!MLX_ISOUTLIER(bad, pixno)) continue;
+        if(nbad == MLX_MAXBADPIX){
+            WARNX("Sensor 0x%02x: too many bad pixels, only %d will be interpolated", d->addr, MLX_MAXBADPIX);
+            break;
+        }
+        badpix_interp *b = &d->badpix[nbad];
+        int row = pixno / MLX_W, col = pixno % MLX_W;
+        float wsum = 0.f;
+        b->pix = pixno;
+        b->n = 0;
+        for(int k = 0; k < (int)(sizeof(nbr)/sizeof(nbr[0])); ++k){
+            if(k == 8 && b->n) break; // use far pixels only if all near are bad
+            int r = row + nbr[k].dr, c = col + nbr[k].dc;
+            if(r < 0 || r >= MLX_H || c < 0 || c >= MLX_W) continue;
+            int n = r * MLX_W + c;
+            if(MLX_ISOUTLIER(bad, n)) continue;
+            b->neigh[b->n] = n;
+            b->w[b->n++] = nbr[k].w;
+            wsum += nbr[k].w;
+        }
+        if(!b->n) continue; // nothing to interpolate from
+        for(int k = 0; k < b->n; ++k) b->w[k] /= wsum;
+        ++nbad;
+    }
+    d->nbadpix = nbad;
+    DBG("%d bad pixels to interpolate", nbad);
+}
+
+// replace bad pixels of `ima` by interpolation
+static void interp_badpix(mlx90640_dev *d, double *ima){
+    for(int i = 0; i < d->nbadpix; ++i){
+        const badpix_interp *b = &d->badpix[i];
+        double s = 0.;
+        for(int k = 0; k < b->n; ++k) s += b->w[k] * ima[b->neigh[k]];
+        ima[b->pix] = s;
+    }
+}
+
+/**
+ * @brief mlx90640_set_deadpixels - set pixels found bad at runtime (e.g. by pixstat_badmaps())
+ * @param d - sensor
+ * @param mask - bitmask of MLX_OUTLWORDS words or NULL to clear
+ * @return amount of pixels interpolated (including EEPROM outliers)
+ */
+int mlx90640_set_deadpixels(mlx90640_dev *d, const uint32_t *mask){
+    if(!d) return 0;
+    pthread_mutex_lock(&d->bus->mutex); // list can be used by bus thread
+    if(mask) memcpy(d->deadpix, mask, sizeof(d->deadpix));
+    else memset(d->deadpix, 0, sizeof(d->deadpix));
+    mkbadpix(d);
+    int n = d->nbadpix;
+    pthread_mutex_unlock(&d->bus->mutex);
+    return n;
+}
+
+// fill `fparams` by `params`
+static void mkfparams(mlx90640_dev *d){
+    int n[2] = {0, 0};
+    for(int row = 0, pixno = 0; row < MLX_H; ++row){
+        for(int col = 0; col < MLX_W; ++col, ++pixno){
+            int sp = (row&1)^(col&1), i = n[sp]++;
+            d->fparams.idx[sp][i] = pixno;
+            d->fparams.offset[sp][i] = (float)d->params.offset[pixno];
+            d->fparams.kta[sp][i] = (float)d->params.kta[pixno];
+            d->fparams.kv[sp][i] = (float)d->params.kv[((row&1)<<1)|(col&1)];
+            d->fparams.alpha[sp][i] = (float)d->params.alpha[pixno];
+        }
+    }
+    memcpy(d->fparams.outliers, d->params.outliers, sizeof(d->fparams.outliers));
+    d->fparams_ready = TRUE;
+    d->calcache.valid[0] = d->calcache.valid[1] = 0;
+    mkbadpix(d);
+}
+
+/**
+ * @brief mlx90640_get_fparams - get single precision calibration data
+ * @param d - sensor
+ * @return pointer to internal structure or NULL if calibration wasn't read yet
+ */
+const MLX90640_fparams *mlx90640_get_fparams(mlx90640_dev *d){
+    if(!d || !d->fparams_ready) return NULL;
+    return &d->fparams;
+}
+
+/**
+ * @brief mlx90640_set_cachethres - set thresholds of Ta/Vdd drift for calibration cache rebuilding
+ * @param d - sensor
+ * @param dTa - max Ta drift, degrC
+ * @param dVdd - max Vdd drift, V
+ * (zero thresholds means rebuild each frame)
+ */
+void mlx90640_set_cachethres(mlx90640_dev *d, double dTa, double dVdd){
+    if(!d) return;
+    d->calcache.thres_dTa = fabs(dTa);
+    d->calcache.thres_dvdd = fabs(dVdd);
+    d->calcache.valid[0] = d->calcache.valid[1] = 0;
+}
+
+// values calculated for each subpage by its service data
+typedef struct{
+    double dvdd;        // Vdd - 3.3
+    double dTa;         // Ta - 25
+    double Kgain;       // gain compensation
+    double pixOS[2];    // pix_OS_CP_SPx
+} framevals;
+
+static void get_framevals(mlx90640_dev *d, framevals *fv){
+    double resol_corr = (double)(1<<d->params.resolEE) / (1<<((d->control & REG_CONTROL_RESMASK)>>10)); // calibrated resol/current resol
+    DBG("resolEE=%d, resolCur=%d", d->params.resolEE, ((d->control & REG_CONTROL_RESMASK)>>10));
     int16_t i16a = (int16_t)IMD_VAL(REG_IVDDPIX);
-    double dvdd = resol_corr*i16a - params.vdd25;
-    dvdd /= params.kVdd;
-    double dV = i16a - params.vdd25;
-    dV /= params.kVdd;
-    DBG("ram=%d, vdd25=%d, dvdd=%g, resol=%g", i16a, params.vdd25, dvdd, resol_corr);
+    double dvdd = resol_corr*i16a - d->params.vdd25;
+    dvdd /= d->params.kVdd;
+    double dV = i16a - d->params.vdd25;
+    dV /= d->params.kVdd;
+    DBG("ram=%d, vdd25=%d, dvdd=%g, resol=%g", i16a, d->params.vdd25, dvdd, resol_corr);
     DBG("Vd=%g", dvdd+3.3);
     i16a = (int16_t)IMD_VAL(REG_ITAPTAT);
     int16_t i16b = (int16_t)IMD_VAL(REG_ITAVBE);
-    double dTa = (double)i16a / (i16a * params.alphaPTAT + i16b); // vptatart
+    double dTa = (double)i16a / (i16a * d->params.alphaPTAT + i16b); // vptatart
     dTa *= (double)(1<<18);
-    dTa = (dTa / (1. + params.KvPTAT*dV) - params.vPTAT25);
-    dTa = dTa / params.KtPTAT; // without 25degr - Ta0
+    dTa = (dTa / (1. + d->params.KvPTAT*dV) - d->params.vPTAT25);
+    dTa = dTa / d->params.KtPTAT; // without 25degr - Ta0
     DBG("Ta=%g", dTa+25.);
     i16a = (int16_t)IMD_VAL(REG_IGAIN);
-    double Kgain = params.gainEE / (double)i16a;
+    double Kgain = d->params.gainEE / (double)i16a;
     DBG("Kgain=%g", Kgain);
-    double pixOS[2]; // pix_gain_CP_SPx
+    double *pixOS = fv->pixOS; // pix_gain_CP_SPx
     // 11.2.2.6.1
     pixOS[0] = ((int16_t)IMD_VAL(REG_ICPSP0))*Kgain; // pix_OS_CP_SPx
     pixOS[1] = ((int16_t)IMD_VAL(REG_ICPSP1))*Kgain;
     DBG("pixGain: %g/%g", pixOS[0], pixOS[1]);
     for(int i = 0; i < 2; ++i){ // calc pixOS by gain
         // 11.2.2.6.2
-        pixOS[i] -= params.cpOffset[i]*(1. + params.cpKta*dTa)*(1. + params.cpKv*dvdd);
+        pixOS[i] -= d->params.cpOffset[i]*(1. + d->params.cpKta*dTa)*(1. + d->params.cpKv*dvdd);
     }
+    fv->dvdd = dvdd;
+    fv->dTa = dTa;
+    fv->Kgain = Kgain;
+}
+
+/**
+ * @brief process_subpage_ref - reference (double precision) calculation of `ima` by `dataarray`
+ * @param subpageno - number of subpage
+ * @param simpleimage == 0 - simplest, 1 - narrow range, 2 - extended range
+ * @param fv - values of current subpage
+ * @param ima - output image (only pixels of given subpage are changed)
+ */
+static _U_ void process_subpage_ref(mlx90640_dev *d, int subpageno, int simpleimage, const framevals *fv, double *ima){
+    double dvdd = fv->dvdd, dTa = fv->dTa, Kgain = fv->Kgain;
+    const double *pixOS = fv->pixOS;
     // now make first approximation to image
     uint16_t pixno = 0;  // current pixel number - for indexing in parameters etc
     for(int row = 0; row < MLX_H; ++row){
-        int idx = (row&1)<<1; // index for params.kv
+        int idx = (row&1)<<1; // index for d->params.kv
         for(int col = 0; col < MLX_W; ++col, ++pixno){
             uint8_t sp = (row&1)^(col&1); // subpage of current pixel
             if(sp != subpageno) continue;
             // 11.2.2.5.1
-            double curval = (double)((int16_t)dataarray[pixno]) * Kgain; // gain compensation
+            double curval = (double)((int16_t)d->dataarray[pixno]) * Kgain; // gain compensation
             // 11.2.2.5.3
-            curval -= params.offset[pixno] * (1. + params.kta[pixno]*dTa) *
-                    (1. + params.kv[idx|(col&1)]*dvdd); // add offset
+            curval -= d->params.offset[pixno] * (1. + d->params.kta[pixno]*dTa) *
+                    (1. + d->params.kv[idx|(col&1)]*dvdd); // add offset
             // now `curval` is pix_OS == V_IR_emiss_comp
             // 11.2.2.7
-            double IRcompens = curval - params.tgc * pixOS[subpageno]; // IR_compensated
+            double IRcompens = curval - d->params.tgc * pixOS[subpageno]; // IR_compensated
             if(simpleimage == 0){ // ???
                 curval = IRcompens;
                 /*
-                curval -= params.cpOffset[subpageno] * (1. - params.cpKta * dTa) *
-                        (1. + params.cpKv * dvdd); // CP
-                curval = IRcompens - params.tgc * curval; // IR gradient compens
+                curval -= d->params.cpOffset[subpageno] * (1. - d->params.cpKta * dTa) *
+                        (1. + d->params.cpKv * dvdd); // CP
+                curval = IRcompens - d->params.tgc * curval; // IR gradient compens
                 */
             }else{
                 // 11.2.2.8
-                double alphaComp = params.alpha[pixno] - params.tgc * params.cpAlpha[subpageno];
-                alphaComp /= 1. + params.KsTa * dTa;
+                double alphaComp = d->params.alpha[pixno] - d->params.tgc * d->params.cpAlpha[subpageno];
+                alphaComp /= 1. + d->params.KsTa * dTa;
                 // 11.2.2.9: calculate To for basic range
                 double Tar = dTa + 273.15 + 25.; // Ta+273.15
                 Tar = Tar*Tar*Tar*Tar; // T_aK4 (when \epsilon==1 this is T_{a-r} too)
                 double ac3 = alphaComp*alphaComp*alphaComp;
                 double Sx = ac3*IRcompens + alphaComp*ac3*Tar;
-                Sx = params.ksTo[1] * sqrt(sqrt(Sx));
-                double To = IRcompens / (alphaComp * (1. - 273.15*params.ksTo[1]) + Sx) + Tar;
+                Sx = d->params.ksTo[1] * sqrt(sqrt(Sx));
+                double To = IRcompens / (alphaComp * (1. - 273.15*d->params.ksTo[1]) + Sx) + Tar;
                 curval = sqrt(sqrt(To)) - 273.15; // To
                 // extended range
                 if(simpleimage == 2){
                     int idx = 0; // range 1 by default
                     double ctx = -40.;
-                    if(curval > params.CT[0] && curval < params.CT[1]){ // range 2
-                        idx = 1; ctx = params.CT[0];
-                    }else if(curval < params.CT[2]){ // range 3
-                        idx = 2; ctx = params.CT[1];
+                    if(curval > d->params.CT[0] && curval < d->params.CT[1]){ // range 2
+                        idx = 1; ctx = d->params.CT[0];
+                    }else if(curval < d->params.CT[2]){ // range 3
+                        idx = 2; ctx = d->params.CT[1];
                     }else{ // range 4
-                        idx = 3; ctx = params.CT[2];
+                        idx = 3; ctx = d->params.CT[2];
                     }
-                    To = IRcompens / (alphaComp * params.alphacorr[idx] * (1. + params.ksTo[idx]*(curval - ctx))) + Tar;
+                    To = IRcompens / (alphaComp * d->params.alphacorr[idx] * (1. + d->params.ksTo[idx]*(curval - ctx))) + Tar;
                     curval = sqrt(sqrt(To)) - 273.15;
                 }
             }
-            mlx_image[pixno] = curval;
+            ima[pixno] = curval;
         }
     }
-    DBG("Time: %g", dtime()-Tlast);
 }
 
-static int process_readconf(){
+// calculate `ima` values of given subpage by single precision `kernel`; @return TRUE if calibration cache was rebuilt
+static _U_ int process_subpage_float(mlx90640_dev *d, int subpageno, int simpleimage, const framevals *fv,
+                                      mlx_kernel_fn kernel, double *ima){
+    float raw[MLX_SPPIXNO] __attribute__((aligned(16))), out[MLX_SPPIXNO] __attribute__((aligned(16)));
+    double Tar = fv->dTa + 273.15 + 25.;
+    mlx_fused_t *f = &d->calcache.f[subpageno];
+    mlx_kernel_t k = {
+        .offset = d->fparams.offset[subpageno], .kta = d->fparams.kta[subpageno],
+        .kv = d->fparams.kv[subpageno], .alpha = d->fparams.alpha[subpageno],
+        .dTa = fv->dTa, .dvdd = fv->dvdd, .Kgain = fv->Kgain, .pixOS = fv->pixOS[subpageno],
+        .Tar = Tar*Tar*Tar*Tar, .tgc = d->params.tgc, .cpAlpha = d->params.cpAlpha[subpageno], .KsTa = d->params.KsTa,
+    };
+    for(int i = 0; i < 4; ++i){
+        k.ksTo[i] = d->params.ksTo[i];
+        k.alphacorr[i] = d->params.alphacorr[i];
+    }
+    for(int i = 0; i < 3; ++i) k.CT[i] = d->params.CT[i];
+    int rebuilt = FALSE;
+    if(!d->calcache.valid[subpageno] || fabs(fv->dTa - d->calcache.dTa[subpageno]) > d->calcache.thres_dTa
+            || fabs(fv->dvdd - d->calcache.dvdd[subpageno]) > d->calcache.thres_dvdd){
+        DBG("Rebuild calibration cache for subpage %d", subpageno);
+        mlx_kernel_fuse(&k, f);
+        d->calcache.dTa[subpageno] = fv->dTa;
+        d->calcache.dvdd[subpageno] = fv->dvdd;
+        d->calcache.valid[subpageno] = 1;
+        rebuilt = TRUE;
+    }
+    const uint16_t *idx = d->fparams.idx[subpageno];
+    for(int i = 0; i < MLX_SPPIXNO; ++i) raw[i] = (float)(int16_t)d->dataarray[idx[i]];
+    kernel(&k, f, raw, out, simpleimage);
+    for(int i = 0; i < MLX_SPPIXNO; ++i) ima[idx[i]] = out[i];
+    return rebuilt;
+}
+
+/**
+ * @brief process_subpage - calculate all parameters from `dataarray` into `ima`
+ * @param subpageno - number of subpage
+ * @param simpleimage == 0 - simplest, 1 - narrow range, 2 - extended range
+ * @param ima - output image (only pixels of given subpage are changed)
+ * Use `make DEF=-DMLX_DOUBLE` to calculate in double precision (reference),
+ * accuracy of single precision kernels is checked by `make check`
+ */
+static void process_subpage(mlx90640_dev *d, int subpageno, int simpleimage, double *ima){
+    DBG("\nprocess_subpage(%d)", subpageno);
+    if(d->rawdump){
+        uint16_t sp = (uint16_t)subpageno;
+        if(fwrite(&sp, sizeof(sp), 1, d->rawdump) != 1 ||
+           fwrite(d->dataarray, sizeof(uint16_t), MLX_PIXARRSZ, d->rawdump) != MLX_PIXARRSZ){
+            WARN("Can't write raw dump");
+            fclose(d->rawdump);
+            d->rawdump = NULL;
+        }
+    }
+#ifdef EBUG
+    chstate();
+#endif
+    framevals fv;
+    get_framevals(d, &fv);
+#ifdef MLX_DOUBLE
+    process_subpage_ref(d, subpageno, simpleimage, &fv, ima);
+#else
+    process_subpage_float(d, subpageno, simpleimage, &fv, mlx_kernel, ima);
+#endif
+    DBG("Time: %g", dtime()-d->Tlast);
+}
+
+/**
+ * @brief mlx90640_set_fillmode - give image after each subpage instead of each pair of them
+ * @param d - sensor
+ * @param mode - how to fill pixels of other subpage
+ * @return FALSE if mode is wrong
+ * Halves latency of image (and doubles frame rate) by cost of using half-period old or interpolated pixels.
+ */
+int mlx90640_set_fillmode(mlx90640_dev *d, mlx_fillmode mode){
+    if(!d || mode < MLX_FILL_NONE || mode >= MLX_FILL_AMOUNT) return FALSE;
+    pthread_mutex_lock(&d->bus->mutex);
+    d->sub.mode = mode;
+    d->sub.have = 0;
+    pthread_mutex_unlock(&d->bus->mutex);
+    return TRUE;
+}
+
+// fill pixels of subpage `!sp` by mean of good 4-connected neighbours (all of them belong to subpage `sp`)
+static void interp_subpage(mlx90640_dev *d, int sp, double *ima){
+    static const int8_t dr[4] = {-1, 1, 0, 0}, dc[4] = {0, 0, -1, 1};
+    const double *src = d->sub.image;
+    for(int row = 0, pixno = 0; row < MLX_H; ++row){
+        for(int col = 0; col < MLX_W; ++col, ++pixno){
+            if(((row&1)^(col&1)) == sp){
+                ima[pixno] = src[pixno];
+                continue;
+            }
+            double s = 0.;
+            int n = 0;
+            for(int k = 0; k < 4; ++k){
+                int r = row + dr[k], c = col + dc[k];
+                if(r < 0 || r >= MLX_H || c < 0 || c >= MLX_W) continue;
+                int nb = r * MLX_W + c;
+                if(MLX_ISOUTLIER(d->params.outliers, nb) || MLX_ISOUTLIER(d->deadpix, nb)) continue;
+                s += src[nb];
+                ++n;
+            }
+            ima[pixno] = n ? s / n : src[pixno]; // all neighbours are bad: use previous value
+        }
+    }
+}
+
+/**
+ * @brief fill_subpage - process subpage `sp` and make image in `sub.mode`
+ * @param ima - output image
+ * @return FALSE if image isn't ready (MLX_FILL_PREV needs both subpages)
+ */
+static int fill_subpage(mlx90640_dev *d, int sp, uint8_t simple, double *ima){
+    process_subpage(d, sp, simple, d->sub.image);
+    d->sub.have |= 1 << sp;
+    if(d->sub.mode == MLX_FILL_INTERP) interp_subpage(d, sp, ima);
+    else{
+        if(d->sub.have != 3) return FALSE;
+        memcpy(ima, d->sub.image, sizeof(d->sub.image));
+    }
+    interp_badpix(d, ima);
+    return TRUE;
+}
+
+/*****************************************************************************
+                Calibration cache file
+ *****************************************************************************/
+
+// cache file header: "MLXC"; change version on any change of MLX90640_params
+#define CALFILE_MAGIC       (0x43584C4D)
+#define CALFILE_VERSION     (1)
+
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint16_t devid[REG_DEVID_LEN];  // sensor ID
+    uint16_t reserved;
+    uint32_t size;                  // sizeof(MLX90640_params)
+    uint32_t crc;                   // CRC32 of d->params
+} calfile_hdr;
+
+static char *caldir = NULL; // directory with cache files (NULL - don't use cache)
+
+/**
+ * @brief mlx90640_set_caldir - set directory for calibration cache files
+ * @param dir - directory path or NULL to disable cache
+ * Calibration is stored in file mlx90640_XXXXXXXXXXXX.cal (XX.. is device ID)
+ */
+void mlx90640_set_caldir(const char *dir){
+    FREE(caldir);
+    if(dir) caldir = strdup(dir);
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len){
+    uint32_t crc = 0xFFFFFFFF;
+    while(len--){
+        crc ^= *data++;
+        for(int i = 0; i < 8; ++i) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void calfile_name(const uint16_t devid[REG_DEVID_LEN], char *buf, size_t len){
+    snprintf(buf, len, "%s/mlx90640_%04X%04X%04X.cal", caldir, devid[0], devid[1], devid[2]);
+}
+
+/**
+ * @brief calfile_load - try to load `params` from cache file
+ * @param devid - device ID of sensor
+ * @return FALSE if there's no cache for this sensor or it's broken
+ */
+static int calfile_load(mlx90640_dev *d, const uint16_t devid[REG_DEVID_LEN]){
+    char name[PATH_MAX];
+    calfile_name(devid, name, PATH_MAX);
+    if(access(name, R_OK)) return FALSE;
+    mmapbuf *map = My_mmap(name);
+    if(!map) return FALSE;
+    int ret = FALSE;
+    const calfile_hdr *hdr = (const calfile_hdr*)map->data;
+    if(map->len != sizeof(calfile_hdr) + sizeof(MLX90640_params) || hdr->magic != CALFILE_MAGIC
+            || hdr->version != CALFILE_VERSION || hdr->size != sizeof(MLX90640_params)
+            || memcmp(hdr->devid, devid, sizeof(hdr->devid))){
+        WARNX("Calibration cache %s is for other sensor or version", name);
+    }else{
+        const uint8_t *data = (const uint8_t*)map->data + sizeof(calfile_hdr);
+        if(crc32(data, sizeof(MLX90640_params)) != hdr->crc) WARNX("Calibration cache %s: wrong checksum", name);
+        else{
+            memcpy(&d->params, data, sizeof(MLX90640_params));
+            ret = TRUE;
+        }
+    }
+    My_munmap(map);
+    DBG("Load %s: %s", name, ret ? "OK" : "failed");
+    return ret;
+}
+
+// save current `params` into cache file
+static void calfile_save(mlx90640_dev *d, const uint16_t devid[REG_DEVID_LEN]){
+    char name[PATH_MAX], tmpname[PATH_MAX+4];
+    calfile_name(devid, name, PATH_MAX);
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", name);
+    calfile_hdr hdr = {.magic = CALFILE_MAGIC, .version = CALFILE_VERSION,
+        .size = sizeof(MLX90640_params), .crc = crc32((const uint8_t*)&d->params, sizeof(MLX90640_params))};
+    memcpy(hdr.devid, devid, sizeof(hdr.devid));
+    int fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        WARN("Can't create %s", tmpname);
+        return;
+    }
+    int ok = (write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+            write(fd, &d->params, sizeof(d->params)) == (ssize_t)sizeof(d->params));
+    if(close(fd)) ok = FALSE;
+    // rename is atomic, so reader will never see partially written file
+    if(!ok || rename(tmpname, name)){
+        WARN("Can't save calibration cache %s", name);
+        unlink(tmpname);
+    }else DBG("Calibration saved to %s", name);
+}
+
+static int process_readconf(mlx90640_dev *d){
     chstate();
     while(1){
-        if(get_parameters()) return TRUE;
+        if(get_parameters(d)){
+            mkfparams(d);
+            return TRUE;
+        }
         else chkerr();
     }
 }
-static int process_firstrun(){
+static int process_firstrun(mlx90640_dev *d){
     uint16_t reg, N;
-    write_reg(REG_CONTROL, REG_CONTROL_DEFAULT);
+    write_reg(d, REG_CONTROL, REG_CONTROL_DEFAULT);
     usleep(50);
-    write_reg(REG_CONTROL, REG_CONTROL_DEFAULT);
+    write_reg(d, REG_CONTROL, REG_CONTROL_DEFAULT);
     usleep(50);
     chstate();
     while(1){
-    if(write_reg(REG_CONTROL, reg_control_val[0])
-            && read_reg(REG_CONTROL, &reg)){
-        DBG("REG_CTRL=0x%04x, T=%g", reg, dtime()-Tlast);
-        if(read_reg(REG_STATUS, &reg)) DBG("REG_STATUS=0x%04x", reg);
+    if(write_reg(d, REG_CONTROL, REG_CONTROL_SP(d, 0))
+            && read_reg(d, REG_CONTROL, &reg)){
+        DBG("REG_CTRL=0x%04x, T=%g", reg, dtime()-d->Tlast);
+        if(read_reg(d, REG_STATUS, &reg)) DBG("REG_STATUS=0x%04x", reg);
+        // short ID read instead of full EEPROM readout if cache is valid
+        uint16_t devid[REG_DEVID_LEN];
+        int haveid = caldir && read_regN(d, REG_DEVID, devid, REG_DEVID_LEN);
+        if(haveid && calfile_load(d, devid)){
+            DBG("Got calibration from cache, T=%g", dtime()-d->Tlast);
+            mkfparams(d);
+            return TRUE;
+        }
         N = REG_CALIDATA_LEN;
-        if(read_data(REG_CALIDATA, &N)){
-            DBG("-> M_READCONF, T=%g", dtime()-Tlast);
-            return process_readconf();
+        if(read_data(d, REG_CALIDATA, &N)){
+            DBG("-> M_READCONF, T=%g", dtime()-d->Tlast);
+            if(!process_readconf(d)) return FALSE;
+            if(haveid) calfile_save(d, devid);
+            return TRUE;
         }else chkerr();
     }else chkerr();
     }
     return FALSE;
 }
 // start image acquiring for next subpage
-static int process_startima(int subpageno){
+/**
+ * @brief wait_newdata - sleep until predicted time of subpage readiness, then poll status
+ * @param d - sensor
+ * @param reg (o) - REG_STATUS value
+ * @return FALSE if timeout or too much errors
+ */
+static int wait_newdata(mlx90640_dev *d, uint16_t *reg){
+    while(1){
+        sleep_until(d->sched.tpoll);
+        double now = mono_time();
+        ++d->sched.polls;
+        if(read_reg(d, REG_STATUS, reg)){
+            if(*reg & REG_STATUS_NEWDATA){
+                sched_ready(d, now);
+                return TRUE;
+            }
+            sched_notready(d, now);
+            chktmout();
+        }else{
+            sched_notready(d, now);
+            chkerr();
+        }
+    }
+    return FALSE;
+}
+
+// start image acquiring for next subpage
+static int process_startima(mlx90640_dev *d, int subpageno){
     chstate();
     DBG("startima(%d)", subpageno);
     uint16_t reg, N;
     while(1){
         // write `overwrite` flag twice
-        if(!write_reg(REG_CONTROL, reg_control_val[subpageno]) ||
-                !write_reg(REG_STATUS, REG_STATUS_OVWEN) ||
-                !write_reg(REG_STATUS, REG_STATUS_OVWEN)) chkerr();
+        if(!write_reg(d, REG_CONTROL, REG_CONTROL_SP(d, subpageno)) ||
+                !write_reg(d, REG_STATUS, REG_STATUS_OVWEN) ||
+                !write_reg(d, REG_STATUS, REG_STATUS_OVWEN)) chkerr();
         while(1){
-            if(read_reg(REG_STATUS, &reg)){
-                if(reg & REG_STATUS_NEWDATA){
-                    DBG("got newdata: %g", dtime() - Tlast);
-                    if(subpageno != (reg & REG_STATUS_SPNO)){
-                        DBG("wrong subpage number -> M_ERROR");
-                        return FALSE;
-                    }else{ // all OK, run image reading
-                        chstate();
-                        write_reg(REG_STATUS, 0); // clear rdy bit
-                        N = MLX_PIXARRSZ;
-                        if(read_data(REG_IMAGEDATA, &N) && N == MLX_PIXARRSZ){
-                            DBG("got readoutm N=%d: %g", N, dtime() - Tlast);
-                            return TRUE;
-                        }else chkerr();
-                    }
-                }else chktmout();
+            if(!wait_newdata(d, &reg)) return FALSE;
+            DBG("got newdata: %g, %u polls", dtime() - d->Tlast, d->sched.polls);
+            if(subpageno != (reg & REG_STATUS_SPNO)){
+                DBG("wrong subpage number -> M_ERROR");
+                return FALSE;
+            }
+            // all OK, run image reading
+            chstate();
+            write_reg(d, REG_STATUS, 0); // clear rdy bit
+            N = MLX_PIXARRSZ;
+            if(read_data(d, REG_IMAGEDATA, &N) && N == MLX_PIXARRSZ){
+                DBG("got readoutm N=%d: %g", N, dtime() - d->Tlast);
+                return TRUE;
             }else chkerr();
         }
     }
     return FALSE;
 }
 
-void mlx90640_restart(){
-    memset(&params, 0, sizeof(params));
-    process_firstrun();
+/**
+ * @brief mlx90640_dump_eeprom - save calibration data (REG_CALIDATA_LEN words from REG_CALIDATA) into file
+ * @param d - sensor (not streaming)
+ * @param path - file name
+ * @return FALSE if failed
+ */
+int mlx90640_dump_eeprom(mlx90640_dev *d, const char *path){
+    if(!d || !path || d->stream.run) return FALSE;
+    uint16_t N = REG_CALIDATA_LEN;
+    if(!read_data(d, REG_CALIDATA, &N) || N != REG_CALIDATA_LEN) return FALSE;
+    FILE *f = fopen(path, "w");
+    if(!f){
+        WARN("Can't open %s", path);
+        return FALSE;
+    }
+    int ret = (fwrite(d->dataarray, sizeof(uint16_t), N, f) == N);
+    if(fclose(f)) ret = FALSE;
+    return ret;
+}
+
+/**
+ * @brief mlx90640_set_rawdump - save each raw subpage (as mlx90640_rawrec) into file
+ * @param d - sensor
+ * @param path - file name (will be overwritten) or NULL to stop dumping
+ * @return FALSE if failed
+ */
+int mlx90640_set_rawdump(mlx90640_dev *d, const char *path){
+    if(!d) return FALSE;
+    FILE *f = NULL;
+    if(path && !(f = fopen(path, "w"))){
+        WARN("Can't open %s", path);
+        return FALSE;
+    }
+    pthread_mutex_lock(&d->bus->mutex); // file could be used by bus thread
+    FILE *old = d->rawdump;
+    d->rawdump = f;
+    pthread_mutex_unlock(&d->bus->mutex);
+    if(old) fclose(old);
+    return TRUE;
+}
+
+/**
+ * @brief mlx90640_restart - reset sensor and reload its calibration
+ * @param d - sensor (not streaming)
+ * @return FALSE if stream is running or failed
+ */
+int mlx90640_restart(mlx90640_dev *d){
+    if(!d || !d->bus->i2c) return FALSE;
+    int ret = FALSE;
+    pthread_mutex_lock(&d->bus->mutex); // parameters can be used by bus thread, I2C bus is shared with it
+    if(!d->stream.run){
+        memset(&d->params, 0, sizeof(d->params));
+        ret = process_firstrun(d);
+    }
+    pthread_mutex_unlock(&d->bus->mutex);
+    return ret;
 }
 
 // if state of MLX allows, make an image else return error
 // @param simple ==1 for simplest image processing (without T calibration)
-int mlx90640_take_image(uint8_t simple, double **image){
-    if(I2Cfd < 1) return FALSE;
-    if(params.kVdd == 0){ // no parameters -> make first run
-        if(!process_firstrun()) return FALSE;
+int mlx90640_take_image(mlx90640_dev *d, uint8_t simple, double **image){
+    if(!d || !d->bus->i2c || d->stream.run) return FALSE;
+    if(d->params.kVdd == 0){ // no parameters -> make first run
+        if(!process_firstrun(d)) return FALSE;
     }
     DBG("\n\n\n-> M_STARTIMA");
-    for(int sp = 0; sp < 2; ++sp){
-        if(!process_startima(sp)) return FALSE; // get first subpage
-        process_subpage(sp, simple);
+    d->sched.polls = 0;
+    if(d->sub.mode == MLX_FILL_NONE){
+        for(int sp = 0; sp < 2; ++sp){
+            if(!process_startima(d, sp)) return FALSE; // get first subpage
+            process_subpage(d, sp, simple, d->image);
+        }
+        interp_badpix(d, d->image);
+    }else{ // only next subpage (both of them at first run in MLX_FILL_PREV mode)
+        int ready = FALSE;
+        while(!ready){
+            int sp = d->sub.next;
+            if(!process_startima(d, sp)){
+                d->sub.have = 0;
+                return FALSE;
+            }
+            d->sub.next = !sp;
+            ready = fill_subpage(d, sp, simple, d->image);
+        }
     }
-    if(image) *image = mlx_image;
+    d->sched.lastpolls = d->sched.polls;
+    if(image) *image = d->image;
     return TRUE;
 }
 
-int mlx90640_init(const char *dev, uint8_t ID){
-    if(I2Cfd > 0) close(I2Cfd);
-    I2Cfd = open(dev, O_RDWR);
-    if(I2Cfd < 1) return FALSE;
-    if(!mlx90640_set_slave_address(ID)) return FALSE;
-    if(!read_reg(0, NULL)) return FALSE;
-    if(!process_firstrun()) return FALSE;
+// @return amount of REG_STATUS polls spent for last frame
+uint32_t mlx90640_get_polls(mlx90640_dev *d){
+    if(!d) return 0;
+    return d->sched.lastpolls;
+}
+
+/*****************************************************************************
+                Stream mode
+ *****************************************************************************/
+
+// publish frame `idx` of ring as the latest one
+static void stream_publish(mlx90640_dev *d, int idx){
+    mlx90640_frame *f = &d->stream.ring[idx];
+    pthread_mutex_lock(&d->stream.mutex);
+    f->seqno = ++d->stream.seqno;
+    f->dropped = d->stream.dropped;
+    f->polls = d->sched.lastpolls = d->sched.polls;
+    d->sched.polls = 0;
+    d->stream.latest = idx;
+    pthread_cond_broadcast(&d->stream.cond);
+    pthread_mutex_unlock(&d->stream.mutex);
+    if(d->stream.cb) d->stream.cb(d, f);
+}
+
+// check for new subpage, read it and clear NEWDATA flag
+// @return subpage number or -1 if no data yet or error occured
+static int stream_getsubpage(mlx90640_dev *d, double now){
+    uint16_t reg, N = MLX_PIXARRSZ;
+    ++d->sched.polls;
+    sched_notready(d, now);
+    if(!read_reg(d, REG_STATUS, &reg)) return -1;
+    if(!(reg & REG_STATUS_NEWDATA)) return -1;
+    sched_ready(d, now);
+    if(!read_data(d, REG_IMAGEDATA, &N) || N != MLX_PIXARRSZ) return -1;
+    if(!write_reg(d, REG_STATUS, REG_STATUS_OVWEN)) return -1; // clear NEWDATA
+    return reg & REG_STATUS_SPNO;
+}
+
+// poll streaming sensor once: sensor runs continuously, each pair of subpages 0, 1 gives next frame
+// @return TRUE if got new subpage
+static int stream_poll(mlx90640_dev *d, double now){
+    int sp = stream_getsubpage(d, now);
+    if(sp < 0){
+        if(dtime() - d->stream.tlast < MLX_TIMEOUT) return FALSE;
+        WARNX("Sensor 0x%02x: stream timeout, try to restart", d->addr);
+        if(++d->stream.errs > MLX_MAXERR_COUNT){
+            WARNX("Sensor 0x%02x: too much errors, stop stream", d->addr);
+            d->stream.run = 0;
+            return FALSE;
+        }
+        if(process_firstrun(d)) write_reg(d, REG_CONTROL, REG_CONTROL_STREAM(d));
+        d->stream.sp_expected = 0;
+        d->sub.have = 0;
+        d->stream.tlast = dtime();
+        return FALSE;
+    }
+    d->stream.errs = 0;
+    d->stream.tlast = dtime();
+    int widx = d->stream.widx;
+    mlx90640_frame *f = &d->stream.ring[widx];
+    if(d->sub.mode != MLX_FILL_NONE){ // image after each subpage
+        if(sp != d->stream.sp_expected) ++d->stream.dropped;
+        d->stream.sp_expected = !sp;
+        if(fill_subpage(d, sp, d->stream.simple, f->image)){
+            f->Tstamp = d->stream.tlast;
+            f->subpage = sp;
+            stream_publish(d, widx);
+            d->stream.widx = (widx + 1) % MLX_RING_SIZE;
+        }
+        return TRUE;
+    }
+    if(sp != d->stream.sp_expected){ // lost subpage: current frame is broken
+        DBG("Got subpage %d instead of %d", sp, d->stream.sp_expected);
+        ++d->stream.dropped;
+        d->stream.sp_expected = 0;
+        if(sp) return TRUE; // wait for subpage 0
+    }
+    process_subpage(d, sp, d->stream.simple, f->image);
+    if(sp){
+        interp_badpix(d, f->image);
+        f->Tstamp = d->stream.tlast;
+        f->subpage = sp;
+        stream_publish(d, widx);
+        d->stream.widx = (widx + 1) % MLX_RING_SIZE;
+    }
+    d->stream.sp_expected = !sp;
     return TRUE;
 }
 
+// wake up readers of stopped stream
+static void stream_wakeup(mlx90640_dev *d){
+    pthread_mutex_lock(&d->stream.mutex);
+    pthread_cond_broadcast(&d->stream.cond);
+    pthread_mutex_unlock(&d->stream.mutex);
+}
+
+// max sleeping time of bus thread (to check `run` flag), s
+#define BUS_IDLE_TIME       (0.1)
+
+// acquisition thread of bus: interleave all streaming sensors, sleeping until nearest predicted subpage
+static void *bus_thread(void *arg){
+    mlx_bus *bus = (mlx_bus*)arg;
+    DBG("bus %s: thread started", bus->path);
+    while(bus->run){
+        double now = mono_time(), tnext = now + BUS_IDLE_TIME;
+        pthread_mutex_lock(&bus->mutex);
+        mlx90640_dev **pd = &bus->streaming;
+        while(*pd){
+            mlx90640_dev *d = *pd;
+            if(d->sched.tpoll <= now){
+                stream_poll(d, now);
+                now = mono_time();
+            }
+            if(!d->stream.run){ // too much errors: remove from list
+                *pd = d->next;
+                d->next = NULL;
+                stream_wakeup(d);
+                continue;
+            }
+            if(d->sched.tpoll < tnext) tnext = d->sched.tpoll;
+            pd = &d->next;
+        }
+        pthread_mutex_unlock(&bus->mutex);
+        sleep_until(tnext);
+    }
+    DBG("bus %s: thread stopped", bus->path);
+    return NULL;
+}
+
+/**
+ * @brief mlx90640_stream_start - run continuous acquisition in bus thread
+ * @param d - sensor
+ * @param simple - image processing type (like in `mlx90640_take_image`)
+ * @param cb - callback for each new frame or NULL; it runs in acquisition thread (shared by all
+ *          sensors on this bus), so should be fast and mustn't call stream functions
+ * @return FALSE if failed
+ */
+int mlx90640_stream_start(mlx90640_dev *d, uint8_t simple, mlx90640_frame_cb cb){
+    if(!d || !d->bus->i2c || d->stream.run) return FALSE;
+    if(d->params.kVdd == 0){
+        if(!process_firstrun(d)) return FALSE;
+    }
+    if(!write_reg(d, REG_CONTROL, REG_CONTROL_STREAM(d))){
+        WARNX("Can't write REG_CONTROL");
+        return FALSE;
+    }
+    mlx_bus *bus = d->bus;
+    pthread_mutex_lock(&buses_mutex);
+    pthread_mutex_lock(&bus->mutex);
+    d->stream.simple = simple;
+    d->stream.cb = cb;
+    d->stream.latest = -1;
+    d->stream.seqno = 0;
+    d->stream.dropped = 0;
+    d->stream.sp_expected = 0;
+    d->sub.have = 0;
+    d->stream.widx = 0;
+    d->stream.errs = 0;
+    d->stream.tlast = dtime();
+    d->sched.tpoll = 0.;
+    d->sched.polls = 0;
+    d->stream.run = 1;
+    d->next = bus->streaming;
+    bus->streaming = d;
+    pthread_mutex_unlock(&bus->mutex);
+    int ret = TRUE;
+    if(!bus->run){
+        bus->run = 1;
+        if(pthread_create(&bus->thread, NULL, bus_thread, bus)){
+            WARN("pthread_create()");
+            bus->run = 0;
+            pthread_mutex_lock(&bus->mutex);
+            bus->streaming = d->next;
+            d->next = NULL;
+            d->stream.run = 0;
+            pthread_mutex_unlock(&bus->mutex);
+            ret = FALSE;
+        }
+    }
+    pthread_mutex_unlock(&buses_mutex);
+    return ret;
+}
+
+// stop acquisition of sensor `d` (and bus thread if there's no more streaming sensors)
+void mlx90640_stream_stop(mlx90640_dev *d){
+    if(!d) return;
+    mlx_bus *bus = d->bus;
+    pthread_mutex_lock(&buses_mutex);
+    pthread_mutex_lock(&bus->mutex);
+    for(mlx90640_dev **pd = &bus->streaming; *pd; pd = &(*pd)->next){
+        if(*pd != d) continue;
+        *pd = d->next;
+        d->next = NULL;
+        break;
+    }
+    d->stream.run = 0;
+    int empty = (bus->streaming == NULL);
+    pthread_mutex_unlock(&bus->mutex);
+    if(empty && bus->run){
+        bus->run = 0;
+        pthread_join(bus->thread, NULL);
+    }
+    pthread_mutex_unlock(&buses_mutex);
+    stream_wakeup(d);
+}
+
+/**
+ * @brief mlx90640_stream_latest - get copy of latest frame
+ * @param d - sensor
+ * @param frame (o) - frame copy
+ * @param seqno - number of frame got last time (return only frames newer than this)
+ * @param tmout - max time to wait for new frame, s
+ * @return FALSE if no new frames for `tmout`
+ */
+int mlx90640_stream_latest(mlx90640_dev *d, mlx90640_frame *frame, uint32_t seqno, double tmout){
+    if(!d || !frame) return FALSE;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long ns = ts.tv_nsec + (long)((tmout - (long)tmout) * 1e9);
+    ts.tv_sec += (time_t)tmout + ns / 1000000000L;
+    ts.tv_nsec = ns % 1000000000L;
+    int ret = FALSE;
+    pthread_mutex_lock(&d->stream.mutex);
+    while(d->stream.run && (d->stream.latest < 0 || d->stream.seqno == seqno)){
+        if(pthread_cond_timedwait(&d->stream.cond, &d->stream.mutex, &ts)) break;
+    }
+    if(d->stream.latest > -1 && d->stream.seqno != seqno){
+        memcpy(frame, &d->stream.ring[d->stream.latest], sizeof(mlx90640_frame));
+        ret = TRUE;
+    }
+    pthread_mutex_unlock(&d->stream.mutex);
+    return ret;
+}
+
+/*****************************************************************************
+                Devices & buses
+ *****************************************************************************/
+
+// find opened bus or open new one
+static mlx_bus *bus_get(const char *path){
+    pthread_mutex_lock(&buses_mutex);
+    mlx_bus *bus = buses;
+    while(bus && strcmp(bus->path, path)) bus = bus->next;
+    if(!bus){
+        i2cbus *i2c = i2cbus_open(path);
+        if(i2c){
+            bus = MALLOC(mlx_bus, 1);
+            bus->path = strdup(path);
+            bus->i2c = i2c;
+            pthread_mutex_init(&bus->mutex, NULL);
+            bus->next = buses;
+            buses = bus;
+        }
+    }
+    if(bus) ++bus->nref;
+    pthread_mutex_unlock(&buses_mutex);
+    return bus;
+}
+
+// release bus; close it when there's no more sensors
+static void bus_put(mlx_bus *bus){
+    pthread_mutex_lock(&buses_mutex);
+    if(--bus->nref == 0){
+        for(mlx_bus **pb = &buses; *pb; pb = &(*pb)->next){
+            if(*pb != bus) continue;
+            *pb = bus->next;
+            break;
+        }
+        i2cbus_close(bus->i2c);
+        pthread_mutex_destroy(&bus->mutex);
+        FREE(bus->path);
+        FREE(bus);
+    }
+    pthread_mutex_unlock(&buses_mutex);
+}
+
+/**
+ * @brief mlx90640_init - open sensor and read its calibration
+ * @param dev - I2C device path (sensors on the same bus share its file descriptor and acquisition thread)
+ * @param ID - sensor I2C address
+ * @return sensor handle or NULL if failed
+ */
+mlx90640_dev *mlx90640_init(const char *dev, uint8_t ID){
+    if(!dev) return NULL;
+    mlx_bus *bus = bus_get(dev);
+    if(!bus) return NULL;
+    mlx90640_dev *d;
+    if(posix_memalign((void**)&d, 16, sizeof(mlx90640_dev))){
+        bus_put(bus);
+        return NULL;
+    }
+    memset(d, 0, sizeof(mlx90640_dev));
+    d->bus = bus;
+    d->addr = ID;
+    d->calcache.thres_dTa = MLX_CACHE_DTA;
+    d->calcache.thres_dvdd = MLX_CACHE_DVDD;
+    d->stream.latest = -1;
+    d->control = REG_CONTROL_BASE | REG_CONTROL_REFR_8HZ | REG_CONTROL_RES18;
+    d->sched.period = subpage_period(d->control);
+    pthread_mutex_init(&d->stream.mutex, NULL);
+    pthread_cond_init(&d->stream.cond, NULL);
+    if(!read_reg(d, 0, NULL) || !process_firstrun(d)){
+        mlx90640_close(d);
+        return NULL;
+    }
+    return d;
+}
+
+// stop stream, free sensor `d` and close its bus if no more sensors use it
+void mlx90640_close(mlx90640_dev *d){
+    if(!d) return;
+    mlx90640_stream_stop(d);
+    if(d->rawdump) fclose(d->rawdump);
+    bus_put(d->bus);
+    pthread_mutex_destroy(&d->stream.mutex);
+    pthread_cond_destroy(&d->stream.cond);
+    free(d);
+}
+
+/*
+ * Offline processing (see mlx90640_internal.h): data are put into `dataarray` by caller instead of I2C
+ */
+
+/**
+ * @brief mlx90640_offline_new - sensor without I2C bus (for processing of dumps)
+ * @return sensor handle (free it by `mlx90640_offline_free`)
+ */
+mlx90640_dev *mlx90640_offline_new(){
+    mlx90640_dev *d;
+    if(posix_memalign((void**)&d, 16, sizeof(mlx90640_dev))) return NULL;
+    memset(d, 0, sizeof(mlx90640_dev));
+    d->calcache.thres_dTa = MLX_CACHE_DTA;
+    d->calcache.thres_dvdd = MLX_CACHE_DVDD;
+    d->stream.latest = -1;
+    d->control = REG_CONTROL_BASE | REG_CONTROL_REFR_8HZ | REG_CONTROL_RES18;
+    return d;
+}
+
+void mlx90640_offline_free(mlx90640_dev *d){
+    if(!d) return;
+    if(d->rawdump) fclose(d->rawdump);
+    free(d);
+}
+
+// buffer for EEPROM (REG_CALIDATA_LEN words) or subpage data (MLX_PIXARRSZ words) in host byte order
+uint16_t *mlx90640_dataarray(mlx90640_dev *d){
+    return d->dataarray;
+}
+
+// get calibration from EEPROM data in `dataarray`; @return FALSE if data is bad
+int mlx90640_calibrate(mlx90640_dev *d){
+    if(!get_parameters(d)) return FALSE;
+    mkfparams(d);
+    return TRUE;
+}
+
+// invalidate calibration cache (it will be rebuilt by next subpage)
+void mlx90640_cache_reset(mlx90640_dev *d){
+    d->calcache.valid[0] = d->calcache.valid[1] = 0;
+}
+
+/**
+ * @brief mlx90640_process - calculate subpage from `dataarray`
+ * @param d - sensor
+ * @param subpageno - number of subpage
+ * @param simpleimage - the same as in `process_subpage`
+ * @param kernel - single precision kernel or NULL for double precision reference
+ * @param ima - output image (only pixels of given subpage are changed)
+ * @return TRUE if calibration cache was rebuilt for this subpage (always FALSE for reference)
+ */
+int mlx90640_process(mlx90640_dev *d, int subpageno, int simpleimage, mlx_kernel_fn kernel, double *ima){
+    framevals fv;
+    get_framevals(d, &fv);
+    if(kernel) return process_subpage_float(d, subpageno, simpleimage, &fv, kernel, ima);
+    process_subpage_ref(d, subpageno, simpleimage, &fv, ima);
+    return FALSE;
+}
+
+// replace outliers and dead pixels of `ima` by interpolation
+void mlx90640_interpolate(mlx90640_dev *d, double *ima){
+    interp_badpix(d, ima);
+}
@@ -29,10 +29,33 @@
 // wait after power on, s
 #define MLX_POWON_WAIT      2.
 
+// wake up before predicted subpage ready time (part of subpage period)
+#define MLX_WAKE_ADVANCE    (0.03)
+// minimal interval between status polls, s
+#define MLX_POLL_INTERVAL   (0.001)
+
+// ADC resolution limits, bits
+#define MLX_RESOL_MIN       (16)
+#define MLX_RESOL_MAX       (19)
+// I2C clock reserve for reading each subpage in time (1. - bare minimum, 64Hz works at 1MHz)
+#define MLX_I2C_MARGIN      (1.)
+
+// default Ta (degrC) and Vdd (V) drift thresholds to rebuild calibration cache
+#define MLX_CACHE_DTA       (0.05)
+#define MLX_CACHE_DVDD      (0.002)
+
 // amount of pixels
 #define MLX_W               (32)
 #define MLX_H               (24)
 #define MLX_PIXNO           (MLX_W*MLX_H)
+// amount of pixels in one subpage
+#define MLX_SPPIXNO         (MLX_PIXNO/2)
+// size of bad pixels bitmask (in 32-bit words)
+#define MLX_OUTLWORDS       (MLX_PIXNO/32)
+// max amount of interpolated bad pixels
+#define MLX_MAXBADPIX       (64)
+// check bit of pixel `n` in bitmask `o`
+#define MLX_ISOUTLIER(o, n) (((o)[(n) >> 5] >> ((n) & 31)) & 1)
 // pixels + service data
 #define MLX_PIXARRSZ        (MLX_PIXNO + 64)
 
@@ -58,16 +81,71 @@ typedef struct{
     double cpAlpha[2];   // alpha_CP_subpage 0 and 1
     uint8_t resolEE; // resolution_EE
     int16_t cpOffset[2];
-    uint8_t outliers[MLX_PIXNO]; // outliers - bad pixels (if == 1)
+    uint32_t outliers[MLX_OUTLWORDS]; // outliers - bad pixels bitmask (bit n for pixel n)
 } MLX90640_params;
 
+// single precision calibration data in subpage-major pixel order (`i`th pixel of subpage `sp` is `idx[sp][i]`)
+typedef struct{
+    float offset[2][MLX_SPPIXNO];
+    float kta[2][MLX_SPPIXNO];
+    float kv[2][MLX_SPPIXNO];
+    float alpha[2][MLX_SPPIXNO];
+    uint16_t idx[2][MLX_SPPIXNO];       // pixel numbers (row*MLX_W + col)
+    uint32_t outliers[MLX_OUTLWORDS];   // the same as in MLX90640_params
+} __attribute__((aligned(16))) MLX90640_fparams;
+
 // default I2C address
 #define MLX_DEFAULT_ADDR    (0x33)
 // max datalength by one read (in 16-bit values)
 #define MLX_DMA_MAXLEN      (832)
 
-void mlx90640_dump_parameters();
-int mlx90640_init(const char *dev, uint8_t ID);
-int mlx90640_set_slave_address(uint8_t addr);
-int mlx90640_take_image(uint8_t simple, double **image);
-void mlx90640_restart();
+// stream mode: amount of preallocated frames in ring buffer
+#define MLX_RING_SIZE       (4)
+
+// what to do with pixels of other subpage when image is given after each subpage
+typedef enum{
+    MLX_FILL_NONE = 0,      // image after each pair of subpages (default)
+    MLX_FILL_PREV,          // image after each subpage, other half from previous subpage
+    MLX_FILL_INTERP,        // image after each subpage, other half interpolated by its neighbours
+    MLX_FILL_AMOUNT
+} mlx_fillmode;
+
+// record of raw subpages dump (see mlx90640_set_rawdump())
+typedef struct{
+    uint16_t subpage;
+    uint16_t data[MLX_PIXARRSZ];    // RAM values from REG_IMAGEDATA
+} mlx90640_rawrec;
+
+// opaque sensor handle
+typedef struct mlx90640_dev mlx90640_dev;
+
+typedef struct{
+    double image[MLX_PIXNO];    // processed image
+    double Tstamp;              // time of last subpage readout
+    uint32_t seqno;             // frame number since stream start
+    uint32_t dropped;           // total amount of lost subpages
+    uint32_t polls;             // amount of status polls spent for this frame
+    int subpage;                // subpage got last
+} mlx90640_frame;
+
+// stream mode callback (called from acquisition thread!)
+typedef void (*mlx90640_frame_cb)(mlx90640_dev *d, const mlx90640_frame *frame);
+
+void mlx90640_dump_parameters(mlx90640_dev *d);
+const MLX90640_fparams *mlx90640_get_fparams(mlx90640_dev *d);
+mlx90640_dev *mlx90640_init(const char *dev, uint8_t ID);
+void mlx90640_close(mlx90640_dev *d);
+int mlx90640_set_slave_address(mlx90640_dev *d, uint8_t addr);
+int mlx90640_set_mode(mlx90640_dev *d, double refresh, int resolution);
+int mlx90640_take_image(mlx90640_dev *d, uint8_t simple, double **image);
+int mlx90640_restart(mlx90640_dev *d);
+int mlx90640_set_deadpixels(mlx90640_dev *d, const uint32_t *mask);
+uint32_t mlx90640_get_polls(mlx90640_dev *d);
+void mlx90640_set_cachethres(mlx90640_dev *d, double dTa, double dVdd);
+int mlx90640_set_fillmode(mlx90640_dev *d, mlx_fillmode mode);
+void mlx90640_set_caldir(const char *dir);
+int mlx90640_dump_eeprom(mlx90640_dev *d, const char *path);
+int mlx90640_set_rawdump(mlx90640_dev *d, const char *path);
+int mlx90640_stream_start(mlx90640_dev *d, uint8_t simple, mlx90640_frame_cb cb);
+void mlx90640_stream_stop(mlx90640_dev *d);
+int mlx90640_stream_latest(mlx90640_dev *d, mlx90640_frame *frame, uint32_t seqno, double tmout);
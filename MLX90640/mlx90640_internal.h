@@ -0,0 +1,35 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// internal interface of processing (for benchmark and checks by data dumps), not for applications
+
+#include "mlx90640.h"
+#include "mlx90640_kernel.h"
+
+// single precision kernel (`mlx_kernel` or `mlx_kernel_scalar`)
+typedef void (*mlx_kernel_fn)(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple);
+
+mlx90640_dev *mlx90640_offline_new();
+void mlx90640_offline_free(mlx90640_dev *d);
+uint16_t *mlx90640_dataarray(mlx90640_dev *d);
+int mlx90640_calibrate(mlx90640_dev *d);
+void mlx90640_cache_reset(mlx90640_dev *d);
+int mlx90640_process(mlx90640_dev *d, int subpageno, int simpleimage, mlx_kernel_fn kernel, double *ima);
+void mlx90640_interpolate(mlx90640_dev *d, double *ima);
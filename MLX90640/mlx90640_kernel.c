@@ -0,0 +1,143 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "mlx90640_kernel.h"
+#include "simd.h"
+
+// see `process_subpage` in mlx90640.c for all formulas: this is the same in single precision
+
+const char *mlx_kernel_name(){
+#ifdef MLX_SIMD
+    return MLX_SIMD;
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * @brief mlx_bswap16 - swap bytes of 16-bit words in place (big-endian I2C data -> host)
+ * @param data - words
+ * @param n - amount of words
+ */
+void mlx_bswap16(uint16_t *data, int n){
+    int i = 0;
+#ifdef MLX_SIMD
+    for(; i + 8 <= n; i += 8) v8u16_bswap(data + i);
+#endif
+    for(; i < n; ++i) data[i] = (uint16_t)((data[i] << 8) | (data[i] >> 8));
+}
+
+/**
+ * @brief mlx_kernel_fuse - calculate per-pixel values which depend only on Ta and Vdd
+ * @param k - calibration values, `dTa` and `dvdd`
+ * @param f (o) - fused values
+ */
+void mlx_kernel_fuse(const mlx_kernel_t *k, mlx_fused_t *f){
+    float acpcomp = k->tgc * k->cpAlpha, ksta = 1.f / (1.f + k->KsTa * k->dTa);
+    for(int i = 0; i < MLX_SPPIXNO; ++i){
+        // 11.2.2.5.3
+        f->off[i] = k->offset[i] * (1.f + k->kta[i] * k->dTa) * (1.f + k->kv[i] * k->dvdd);
+        // 11.2.2.8
+        float alphaComp = (k->alpha[i] - acpcomp) * ksta;
+        f->alpha[i] = alphaComp;
+        f->a3[i] = alphaComp * alphaComp * alphaComp;
+    }
+}
+
+/**
+ * @brief mlx_kernel_scalar - reference (not vectorized) kernel
+ * @param k - frame values
+ * @param f - fused calibration values (by `mlx_kernel_fuse`)
+ * @param raw - raw pixel values of subpage (in subpage order)
+ * @param out - output values
+ * @param simple - the same as `simpleimage` of `process_subpage`
+ */
+void mlx_kernel_scalar(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple){
+    float IRcp = k->tgc * k->pixOS, ks1 = 1.f - 273.15f * k->ksTo[1];
+    for(int i = 0; i < MLX_SPPIXNO; ++i){
+        // 11.2.2.5.1 - 11.2.2.7
+        float IR = raw[i] * k->Kgain - f->off[i] - IRcp;
+        if(simple == 0){
+            out[i] = IR;
+            continue;
+        }
+        // 11.2.2.9
+        float alphaComp = f->alpha[i];
+        float Sx = k->ksTo[1] * sqrtf(sqrtf(f->a3[i] * (IR + alphaComp * k->Tar)));
+        float T = sqrtf(sqrtf(IR / (alphaComp * ks1 + Sx) + k->Tar)) - 273.15f;
+        if(simple == 2){ // the same range selection as in `process_subpage`
+            int idx; float ctx;
+            if(T > k->CT[0] && T < k->CT[1]){ idx = 1; ctx = k->CT[0]; }
+            else if(T < k->CT[2]){ idx = 2; ctx = k->CT[1]; }
+            else{ idx = 3; ctx = k->CT[2]; }
+            T = sqrtf(sqrtf(IR / (alphaComp * k->alphacorr[idx] * (1.f + k->ksTo[idx] * (T - ctx))) + k->Tar)) - 273.15f;
+        }
+        out[i] = T;
+    }
+}
+
+#ifdef MLX_SIMD
+// sqrt(sqrt(x))
+static inline v4f v4_qrt(v4f x){ return v4_sqrt(v4_sqrt(x)); }
+
+static void mlx_kernel_simd(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple){
+    const v4f one = v4_set(1.f), zeroC = v4_set(273.15f), Kgain = v4_set(k->Kgain), IRcp = v4_set(k->tgc * k->pixOS);
+    const v4f ks1 = v4_set(1.f - 273.15f * k->ksTo[1]), ksTo1 = v4_set(k->ksTo[1]), Tar = v4_set(k->Tar);
+    const v4f CT0 = v4_set(k->CT[0]), CT1 = v4_set(k->CT[1]), CT2 = v4_set(k->CT[2]);
+    const v4f ac1 = v4_set(k->alphacorr[1]), ac2 = v4_set(k->alphacorr[2]), ac3r = v4_set(k->alphacorr[3]);
+    const v4f ksTo2 = v4_set(k->ksTo[2]), ksTo3 = v4_set(k->ksTo[3]);
+    for(int i = 0; i < MLX_SPPIXNO; i += 4){
+        v4f IR = v4_sub(v4_sub(v4_mul(v4_load(raw + i), Kgain), v4_load(f->off + i)), IRcp);
+        if(simple == 0){
+            v4_store(out + i, IR);
+            continue;
+        }
+        v4f alphaComp = v4_load(f->alpha + i);
+        v4f Sx = v4_mul(ksTo1, v4_qrt(v4_mul(v4_load(f->a3 + i), v4_add(IR, v4_mul(alphaComp, Tar)))));
+        v4f T = v4_sub(v4_qrt(v4_add(v4_div(IR, v4_add(v4_mul(alphaComp, ks1), Sx)), Tar)), zeroC);
+        if(simple == 2){
+            // range 2 if CT0 < T < CT1, range 3 if T < CT2 and range 4 for the rest
+            v4m r2 = v4_and(v4_gt(T, CT0), v4_lt(T, CT1)), r3 = v4_lt(T, CT2);
+            v4f acorr = v4_sel(r2, ac1, v4_sel(r3, ac2, ac3r));
+            v4f ks = v4_sel(r2, ksTo1, v4_sel(r3, ksTo2, ksTo3));
+            v4f ctx = v4_sel(r2, CT0, v4_sel(r3, CT1, CT2));
+            v4f den = v4_mul(v4_mul(alphaComp, acorr), v4_add(one, v4_mul(ks, v4_sub(T, ctx))));
+            T = v4_sub(v4_qrt(v4_add(v4_div(IR, den), Tar)), zeroC);
+        }
+        v4_store(out + i, T);
+    }
+}
+#endif
+
+/**
+ * @brief mlx_kernel - calculate image values of one subpage (vectorized if possible)
+ * @param k - frame values
+ * @param f - fused calibration values (by `mlx_kernel_fuse`)
+ * @param raw - raw pixel values of subpage (in subpage order)
+ * @param out - output values
+ * @param simple - the same as `simpleimage` of `process_subpage`
+ */
+void mlx_kernel(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple){
+#ifdef MLX_SIMD
+    mlx_kernel_simd(k, f, raw, out, simple);
+#else
+    mlx_kernel_scalar(k, f, raw, out, simple);
+#endif
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mlx90640.h"
+
+// input data for calibration kernel: single subpage in single precision
+typedef struct{
+    // per-pixel calibration values in subpage order
+    const float *offset;    // offset
+    const float *kta;       // K_ta
+    const float *kv;        // K_V
+    const float *alpha;     // alpha
+    // values for `mlx_kernel_fuse`
+    float dTa;              // Ta - 25
+    float dvdd;             // Vdd - 3.3
+    // per-frame values
+    float Kgain;            // gain compensation
+    float pixOS;            // CP offset of subpage (after 11.2.2.6.2)
+    float Tar;              // T_a-r = (Ta + 273.15)^4
+    // calibration constants
+    float tgc;
+    float cpAlpha;          // CP alpha of subpage
+    float KsTa;
+    float ksTo[4];
+    float alphacorr[4];
+    float CT[3];
+} mlx_kernel_t;
+
+// per-pixel values depending only on calibration and Ta/Vdd (rebuilt when they drift)
+typedef struct{
+    float off[MLX_SPPIXNO];     // offset * (1 + kta*dTa) * (1 + kv*dvdd)
+    float alpha[MLX_SPPIXNO];   // compensated alpha (11.2.2.8)
+    float a3[MLX_SPPIXNO];      // alpha^3
+} __attribute__((aligned(16))) mlx_fused_t;
+
+const char *mlx_kernel_name();
+void mlx_bswap16(uint16_t *data, int n);
+void mlx_kernel_fuse(const mlx_kernel_t *k, mlx_fused_t *f);
+void mlx_kernel_scalar(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple);
+void mlx_kernel(const mlx_kernel_t *k, const mlx_fused_t *f, const float *raw, float *out, int simple);
@@ -38,6 +38,7 @@
 #define REG_CONTROL_REFR_16HZ   (5<<7)
 #define REG_CONTROL_REFR_32HZ   (6<<7)
 #define REG_CONTROL_REFR_64HZ   (7<<7)
+#define REG_CONTROL_REFRMASK    (7<<7)
 #define REG_CONTROL_SUBP1       (1<<4)
 #define REG_CONTROL_SUBPMASK    (3<<4)
 #define REG_CONTROL_SUBPSEL     (1<<3)
@@ -47,6 +48,10 @@
 // default value
 #define REG_CONTROL_DEFAULT     (REG_CONTROL_CHESS|REG_CONTROL_RES18|REG_CONTROL_REFR_2HZ|REG_CONTROL_SUBPEN)
 
+// device ID (unique for each sensor)
+#define REG_DEVID               0x2407
+#define REG_DEVID_LEN           3
+
 // calibration data start & len
 #define REG_CALIDATA            0x2410
 #define REG_CALIDATA_LEN        816
@@ -0,0 +1,104 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// playback of records made by `mlx -w`
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <usefull_macros.h>
+
+#include "recorder.h"
+
+static int help = 0, realtime = 0, grid = 0, info = 0, nframes = 0;
+static double tstart = 0.;
+static char *input = NULL;
+
+static myoption cmdlnopts[] = {
+    {"help",    NO_ARGS,    NULL,   'h',    arg_int,    APTR(&help),        _("show this help")},
+    {"input",   NEED_ARG,   NULL,   'i',    arg_string, APTR(&input),       _("record file name")},
+    {"start",   NEED_ARG,   NULL,   't',    arg_double, APTR(&tstart),      _("start from first frame not older than given UNIX time")},
+    {"nframes", NEED_ARG,   NULL,   'n',    arg_int,    APTR(&nframes),     _("amount of frames to play (default: all)")},
+    {"realtime",NO_ARGS,    NULL,   'r',    arg_int,    APTR(&realtime),    _("play in real time (with original frame intervals)")},
+    {"grid",    NO_ARGS,    NULL,   'g',    arg_int,    APTR(&grid),        _("print full image of each frame")},
+    {"info",    NO_ARGS,    NULL,   'I',    arg_int,    APTR(&info),        _("show record information and exit")},
+   end_option
+};
+
+static void showinfo(const mlxrec_reader *r){
+    uint32_t n = mlxrec_nframes(r), nkey = 0;
+    green("%u frames\n", n);
+    if(n == 0) return;
+    for(uint32_t i = 0; i < n; ++i) if(mlxrec_index(r, i)->type == MLXREC_KEY) ++nkey;
+    const mlxrec_idx *first = mlxrec_index(r, 0), *last = mlxrec_index(r, n - 1);
+    double dt = last->Tstamp - first->Tstamp;
+    printf("Keyframes: %u\nSeqno: %u..%u\nTime: %.3f..%.3f (%.1fs)\n", nkey, first->seqno, last->seqno,
+           first->Tstamp, last->Tstamp, dt);
+    if(dt > 0.) printf("Mean rate: %.2f frames/s\n", (n - 1) / dt);
+    printf("Mean frame size: %.1f bytes\n", (double)last->offset / n);
+}
+
+int main(int argc, char **argv){
+    initial_setup();
+    parseargs(&argc, &argv, cmdlnopts);
+    if(help) showhelp(-1, cmdlnopts);
+    if(!input) ERRX("Point record file name");
+    if(nframes < 0) ERRX("nframes should be >= 0");
+    mlxrec_reader *r = mlxrec_open(input);
+    if(!r) ERRX("Can't open %s", input);
+    if(info){
+        showinfo(r);
+        mlxrec_reader_close(r);
+        return 0;
+    }
+    int64_t first = mlxrec_find(r, tstart);
+    if(first < 0) ERRX("No frames after %.3f", tstart);
+    uint32_t last = mlxrec_nframes(r);
+    if(nframes && first + nframes < last) last = (uint32_t)(first + nframes);
+    static double ima[MLX_PIXNO];
+    double T0 = mlxrec_index(r, (uint32_t)first)->Tstamp, t0 = dtime();
+    for(uint32_t n = (uint32_t)first; n < last; ++n){
+        const mlxrec_idx *idx = mlxrec_index(r, n);
+        if(!mlxrec_read(r, n, ima)) ERRX("Can't read frame %u", n);
+        if(realtime){
+            double dt = (idx->Tstamp - T0) - (dtime() - t0);
+            if(dt > 0.){
+                struct timespec ts = {.tv_sec = (time_t)dt, .tv_nsec = (long)((dt - floor(dt)) * 1e9)};
+                nanosleep(&ts, NULL);
+            }
+        }
+        double min = ima[0], max = ima[0], sum = 0.;
+        for(int i = 0; i < MLX_PIXNO; ++i){
+            if(ima[i] < min) min = ima[i];
+            else if(ima[i] > max) max = ima[i];
+            sum += ima[i];
+        }
+        printf("%u\t%.3f\t%.2f\t%.2f\t%.2f\n", idx->seqno, idx->Tstamp, min, max, sum / MLX_PIXNO);
+        if(grid){
+            double *im = ima;
+            for(int row = 0; row < MLX_H; ++row){
+                for(int col = 0; col < MLX_W; ++col){
+                    printf("%6.1f ", *im++);
+                }
+                printf("\n");
+            }
+        }
+    }
+    mlxrec_reader_close(r);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pixstat.h"
+#include "simd.h"
+
+/**
+ * @brief pixstat_init - clear statistics
+ * @param ps - statistics
+ * @param window - averaging window (frames), 0 - infinite
+ */
+void pixstat_init(pixstat *ps, uint32_t window){
+    memset(ps, 0, sizeof(pixstat));
+    ps->window = window;
+}
+
+/**
+ * @brief pixstat_push - add next image to statistics (Welford's algorithm)
+ * @param ps - statistics
+ * @param image - MLX_PIXNO values
+ * For weight a = 1/n: mean += a*delta; var = (1-a)*(var + a*delta^2),
+ * when n reaches window, a stays 1/window (exponential averaging)
+ */
+void pixstat_push(pixstat *ps, const double *image){
+    if(ps->window == 0 || ps->n < ps->window) ++ps->n;
+    float a = 1.f / (float)ps->n, a1 = 1.f - a;
+    float *mean = ps->mean, *var = ps->var;
+    int i = 0;
+#ifdef MLX_SIMD
+    const v4f va = v4_set(a), va1 = v4_set(a1);
+    float x[4] __attribute__((aligned(16)));
+    for(; i + 4 <= MLX_PIXNO; i += 4){
+        for(int j = 0; j < 4; ++j) x[j] = (float)image[i + j];
+        v4f m = v4_load(mean + i), delta = v4_sub(v4_load(x), m);
+        v4_store(mean + i, v4_add(m, v4_mul(va, delta)));
+        v4f v = v4_add(v4_load(var + i), v4_mul(va, v4_mul(delta, delta)));
+        v4_store(var + i, v4_mul(va1, v));
+    }
+#endif
+    for(; i < MLX_PIXNO; ++i){
+        float delta = (float)image[i] - mean[i];
+        mean[i] += a * delta;
+        var[i] = a1 * (var[i] + a * delta * delta);
+    }
+}
+
+// calculate RMS of each pixel
+void pixstat_rms(const pixstat *ps, float *rms){
+    for(int i = 0; i < MLX_PIXNO; ++i) rms[i] = sqrtf(ps->var[i]);
+}
+
+static int fcmp(const void *a, const void *b){
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief pixstat_median_rms - median RMS over all pixels (NETD estimation for images in degrC)
+ * @param ps - statistics
+ * @return median RMS
+ */
+float pixstat_median_rms(const pixstat *ps){
+    float v[MLX_PIXNO];
+    memcpy(v, ps->var, sizeof(v));
+    qsort(v, MLX_PIXNO, sizeof(float), fcmp);
+    return sqrtf(v[MLX_PIXNO/2]);
+}
+
+/**
+ * @brief pixstat_badmaps - find dead (stuck) and noisy pixels
+ * @param ps - statistics
+ * @param deadrms - pixels with RMS less than this (or NaN) are dead
+ * @param noisyk - pixels with RMS greater than `noisyk` * median RMS are noisy
+ * @param dead (o) - bitmask of dead pixels (MLX_OUTLWORDS words) or NULL
+ * @param noisy (o) - bitmask of noisy pixels or NULL
+ * @return amount of bad pixels
+ */
+int pixstat_badmaps(const pixstat *ps, float deadrms, float noisyk, uint32_t *dead, uint32_t *noisy){
+    if(dead) memset(dead, 0, MLX_OUTLWORDS * sizeof(uint32_t));
+    if(noisy) memset(noisy, 0, MLX_OUTLWORDS * sizeof(uint32_t));
+    if(ps->n < 2) return 0;
+    float med = pixstat_median_rms(ps), dvar = deadrms * deadrms, nvar = noisyk * noisyk * med * med;
+    int nbad = 0;
+    for(int i = 0; i < MLX_PIXNO; ++i){
+        uint32_t bit = 1U << (i & 31);
+        if(!(ps->var[i] >= dvar)){ // NaN too
+            if(dead) dead[i >> 5] |= bit;
+            ++nbad;
+        }else if(ps->var[i] > nvar){
+            if(noisy) noisy[i >> 5] |= bit;
+            ++nbad;
+        }
+    }
+    return nbad;
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mlx90640.h"
+
+// default relative RMS limit for noisy pixels (related to median RMS)
+#define PIXSTAT_NOISY_K     (3.f)
+// default RMS limit for dead (stuck) pixels
+#define PIXSTAT_DEAD_RMS    (1e-3f)
+
+// running per-pixel mean and variance: cumulative for first `window` frames, then exponential with weight 1/window
+typedef struct{
+    float mean[MLX_PIXNO];
+    float var[MLX_PIXNO];       // population variance
+    uint32_t window;            // averaging window, frames
+    uint32_t n;                 // amount of frames pushed
+} __attribute__((aligned(16))) pixstat;
+
+void pixstat_init(pixstat *ps, uint32_t window);
+void pixstat_push(pixstat *ps, const double *image);
+void pixstat_rms(const pixstat *ps, float *rms);
+float pixstat_median_rms(const pixstat *ps);
+int pixstat_badmaps(const pixstat *ps, float deadrms, float noisyk, uint32_t *dead, uint32_t *noisy);
@@ -0,0 +1,351 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <usefull_macros.h>
+
+#include "recorder.h"
+
+// max payload size: delta of 16-bit value takes up to 3 bytes
+#define MAXPAYLOAD      (3 * MLX_PIXNO)
+#define KEYSIZE         (MLX_PIXNO * sizeof(int16_t))
+// frame records are aligned by 8 bytes
+#define ALIGN8(x)       (((x) + 7) & ~(size_t)7)
+
+struct mlxrec{
+    int fd;                     // data file
+    int idxfd;                  // index file
+    uint8_t *map;               // mapped data file
+    size_t maplen;              // its length
+    size_t pos;                 // current write position
+    uint16_t keyint;            // keyframe interval
+    uint32_t nframes;           // frames written
+    int16_t prev[MLX_PIXNO];    // previous frame
+};
+
+struct mlxrec_reader{
+    mmapbuf *map;               // data file
+    mlxrec_idx *idx;            // index (loaded from file and/or built by scan)
+    uint32_t nframes;
+    uint32_t idxsize;           // allocated size of `idx`
+    float scale;
+    int64_t last;               // number of frame in `cur` (-1 if none)
+    int16_t cur[MLX_PIXNO];     // last decoded frame
+};
+
+static inline int16_t tofix(double v){
+    if(isnan(v)) return 0;
+    v = round(v * MLXREC_SCALE);
+    if(v > INT16_MAX) return INT16_MAX;
+    if(v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v){
+    while(v >= 0x80){
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// @return NULL if out of buffer
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v){
+    uint32_t x = 0;
+    for(int shift = 0; p < end && shift < 32; shift += 7){
+        uint8_t b = *p++;
+        x |= (uint32_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)){
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t zigzag(int32_t x){ return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31); }
+static inline int32_t unzigzag(uint32_t x){ return (int32_t)(x >> 1) ^ -(int32_t)(x & 1); }
+
+/*****************************************************************************
+                Writer
+ *****************************************************************************/
+
+// extend file & its mapping to have at least `need` free bytes
+static int rec_grow(mlxrec *r, size_t need){
+    if(r->pos + need <= r->maplen) return TRUE;
+    size_t len = r->maplen;
+    while(len < r->pos + need) len += MLXREC_CHUNK;
+    if(ftruncate(r->fd, (off_t)len)){
+        WARN("ftruncate()");
+        return FALSE;
+    }
+    void *m = r->map ? mremap(r->map, r->maplen, len, MREMAP_MAYMOVE) :
+                       mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+    if(m == MAP_FAILED){
+        WARN("mmap()");
+        return FALSE;
+    }
+    r->map = m;
+    r->maplen = len;
+    return TRUE;
+}
+
+/**
+ * @brief mlxrec_create - create new record (file `path` and its index `path`.idx)
+ * @param path - data file name (will be overwritten)
+ * @param keyint - keyframe interval (0 or 1 - all frames are keyframes)
+ * @return recorder or NULL if failed
+ */
+mlxrec *mlxrec_create(const char *path, uint16_t keyint){
+    if(!path) return NULL;
+    char idxname[PATH_MAX];
+    snprintf(idxname, PATH_MAX, "%s" MLXREC_IDXEXT, path);
+    mlxrec *r = MALLOC(mlxrec, 1);
+    r->keyint = keyint ? keyint : 1;
+    r->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    r->idxfd = open(idxname, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if(r->fd < 0 || r->idxfd < 0){
+        WARN("Can't create %s", (r->fd < 0) ? path : idxname);
+        mlxrec_close(r);
+        return NULL;
+    }
+    if(!rec_grow(r, MLXREC_CHUNK)){
+        mlxrec_close(r);
+        return NULL;
+    }
+    mlxrec_header *h = (mlxrec_header*)r->map;
+    memcpy(h->magic, "MLXR", 4);
+    h->version = MLXREC_VERSION;
+    h->keyint = r->keyint;
+    h->width = MLX_W;
+    h->height = MLX_H;
+    h->scale = MLXREC_SCALE;
+    r->pos = ALIGN8(sizeof(mlxrec_header));
+    return r;
+}
+
+/**
+ * @brief mlxrec_write - append frame to record
+ * @param r - recorder
+ * @param image - MLX_PIXNO values
+ * @param Tstamp - frame time
+ * @param seqno - frame number
+ * @return FALSE if failed
+ */
+int mlxrec_write(mlxrec *r, const double *image, double Tstamp, uint32_t seqno){
+    if(!r || !image) return FALSE;
+    if(!rec_grow(r, sizeof(mlxrec_frame) + ALIGN8(MAXPAYLOAD))) return FALSE;
+    int16_t cur[MLX_PIXNO];
+    for(int i = 0; i < MLX_PIXNO; ++i) cur[i] = tofix(image[i]);
+    mlxrec_frame *f = (mlxrec_frame*)(r->map + r->pos);
+    uint8_t *data = (uint8_t*)(f + 1), *p = data;
+    uint16_t type = MLXREC_KEY;
+    if(r->nframes % r->keyint){
+        type = MLXREC_DELTA;
+        for(int i = 0; i < MLX_PIXNO; ++i) p = put_varint(p, zigzag((int32_t)cur[i] - r->prev[i]));
+        if((size_t)(p - data) >= KEYSIZE) type = MLXREC_KEY; // delta is useless
+    }
+    if(type == MLXREC_KEY){
+        memcpy(data, cur, KEYSIZE);
+        p = data + KEYSIZE;
+    }
+    f->seqno = seqno;
+    f->Tstamp = Tstamp;
+    f->type = type;
+    f->size = (uint32_t)(p - data); // the last: nonzero size means complete frame
+    mlxrec_idx idx = {.Tstamp = Tstamp, .offset = r->pos, .seqno = seqno, .type = type};
+    if(write(r->idxfd, &idx, sizeof(idx)) != (ssize_t)sizeof(idx)) WARN("Can't write index");
+    r->pos += sizeof(mlxrec_frame) + ALIGN8(f->size);
+    memcpy(r->prev, cur, sizeof(cur));
+    ++r->nframes;
+    return TRUE;
+}
+
+// schedule writing of dirty pages
+void mlxrec_sync(mlxrec *r){
+    if(!r || !r->map) return;
+    msync(r->map, r->pos, MS_ASYNC);
+}
+
+// close record and truncate data file to its real size
+void mlxrec_close(mlxrec *r){
+    if(!r) return;
+    if(r->map) munmap(r->map, r->maplen);
+    if(r->fd > -1){
+        if(r->map && ftruncate(r->fd, (off_t)r->pos)) WARN("ftruncate()");
+        close(r->fd);
+    }
+    if(r->idxfd > -1) close(r->idxfd);
+    FREE(r);
+}
+
+/*****************************************************************************
+                Reader
+ *****************************************************************************/
+
+static void idx_add(mlxrec_reader *r, const mlxrec_idx *i){
+    if(r->nframes == r->idxsize){
+        r->idxsize = r->idxsize ? r->idxsize * 2 : 1024;
+        r->idx = realloc(r->idx, r->idxsize * sizeof(mlxrec_idx));
+        if(!r->idx) ERR("realloc()");
+    }
+    r->idx[r->nframes++] = *i;
+}
+
+// get frame header at `offset` or NULL if there's no complete frame
+static const mlxrec_frame *frame_at(const mlxrec_reader *r, size_t offset){
+    if(offset + sizeof(mlxrec_frame) > r->map->len) return NULL;
+    const mlxrec_frame *f = (const mlxrec_frame*)(r->map->data + offset);
+    if(f->size == 0 || f->size > MAXPAYLOAD || offset + sizeof(mlxrec_frame) + f->size > r->map->len) return NULL;
+    if(f->type != MLXREC_KEY && f->type != MLXREC_DELTA) return NULL;
+    return f;
+}
+
+// build index by data file starting from `offset`
+static void rec_scan(mlxrec_reader *r, size_t offset){
+    const mlxrec_frame *f;
+    while((f = frame_at(r, offset))){
+        mlxrec_idx i = {.Tstamp = f->Tstamp, .offset = offset, .seqno = f->seqno, .type = f->type};
+        idx_add(r, &i);
+        offset += sizeof(mlxrec_frame) + ALIGN8(f->size);
+    }
+}
+
+/**
+ * @brief mlxrec_open - open record for reading
+ * @param path - data file name
+ * @return reader or NULL if failed
+ * Index file is used if present; frames after its end (e.g. after crash) are found by scanning data file.
+ */
+mlxrec_reader *mlxrec_open(const char *path){
+    if(!path) return NULL;
+    mmapbuf *map = My_mmap((char*)path);
+    if(!map) return NULL;
+    const mlxrec_header *h = (const mlxrec_header*)map->data;
+    if(map->len < sizeof(mlxrec_header) || memcmp(h->magic, "MLXR", 4) || h->version != MLXREC_VERSION
+            || h->width != MLX_W || h->height != MLX_H || h->scale <= 0.f){
+        WARNX("%s isn't MLX90640 record", path);
+        My_munmap(map);
+        return NULL;
+    }
+    mlxrec_reader *r = MALLOC(mlxrec_reader, 1);
+    r->map = map;
+    r->scale = h->scale;
+    r->last = -1;
+    size_t offset = ALIGN8(sizeof(mlxrec_header));
+    char idxname[PATH_MAX];
+    snprintf(idxname, PATH_MAX, "%s" MLXREC_IDXEXT, path);
+    if(access(idxname, R_OK) == 0){
+        mmapbuf *imap = My_mmap(idxname);
+        if(imap){
+            const mlxrec_idx *i = (const mlxrec_idx*)imap->data;
+            size_t n = imap->len / sizeof(mlxrec_idx);
+            for(size_t k = 0; k < n; ++k, ++i){ // check that index matches data
+                const mlxrec_frame *f = frame_at(r, i->offset);
+                if(i->offset != offset || !f || f->seqno != i->seqno || f->type != i->type) break;
+                idx_add(r, i);
+                offset += sizeof(mlxrec_frame) + ALIGN8(f->size);
+            }
+            My_munmap(imap);
+        }
+    }
+    rec_scan(r, offset);
+    DBG("%s: %u frames", path, r->nframes);
+    return r;
+}
+
+uint32_t mlxrec_nframes(const mlxrec_reader *r){
+    if(!r) return 0;
+    return r->nframes;
+}
+
+// @return index record of frame `n` or NULL
+const mlxrec_idx *mlxrec_index(const mlxrec_reader *r, uint32_t n){
+    if(!r || n >= r->nframes) return NULL;
+    return &r->idx[n];
+}
+
+/**
+ * @brief mlxrec_find - find first frame with timestamp not less than `t`
+ * @param r - reader
+ * @param t - time
+ * @return frame number or -1 if all frames are older
+ */
+int64_t mlxrec_find(const mlxrec_reader *r, double t){
+    if(!r || r->nframes == 0 || r->idx[r->nframes - 1].Tstamp < t) return -1;
+    uint32_t lo = 0, hi = r->nframes - 1;
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(r->idx[mid].Tstamp < t) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// decode frame `n` into `cur` (previous frame should be in `cur` for delta frames)
+static int decode(mlxrec_reader *r, uint32_t n){
+    r->last = -1;
+    const mlxrec_frame *f = frame_at(r, r->idx[n].offset);
+    if(!f) return FALSE;
+    const uint8_t *p = (const uint8_t*)(f + 1), *end = p + f->size;
+    if(f->type == MLXREC_KEY){
+        if(f->size != KEYSIZE) return FALSE;
+        memcpy(r->cur, p, KEYSIZE);
+    }else for(int i = 0; i < MLX_PIXNO; ++i){
+        uint32_t v;
+        if(!(p = get_varint(p, end, &v))) return FALSE;
+        r->cur[i] = (int16_t)(r->cur[i] + unzigzag(v));
+    }
+    r->last = n;
+    return TRUE;
+}
+
+/**
+ * @brief mlxrec_read - read frame
+ * @param r - reader
+ * @param n - frame number
+ * @param image (o) - MLX_PIXNO values
+ * @return FALSE if failed
+ * Sequential reading decodes one frame per call, random access - starting from nearest keyframe.
+ */
+int mlxrec_read(mlxrec_reader *r, uint32_t n, double *image){
+    if(!r || !image || n >= r->nframes) return FALSE;
+    if(r->last != (int64_t)n){
+        int64_t s = n;
+        while(s > 0 && r->idx[s].type != MLXREC_KEY && s != r->last + 1) --s;
+        if(r->idx[s].type != MLXREC_KEY && s != r->last + 1) return FALSE;
+        for(; s <= n; ++s) if(!decode(r, (uint32_t)s)) return FALSE;
+    }
+    for(int i = 0; i < MLX_PIXNO; ++i) image[i] = r->cur[i] / r->scale;
+    return TRUE;
+}
+
+void mlxrec_reader_close(mlxrec_reader *r){
+    if(!r) return;
+    My_munmap(r->map);
+    FREE(r->idx);
+    FREE(r);
+}
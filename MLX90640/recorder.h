@@ -0,0 +1,81 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "mlx90640.h"
+
+// data file grows by this size (it's mmapped, so not written chunk is a hole on disk)
+#define MLXREC_CHUNK        (1<<20)
+// default keyframe interval
+#define MLXREC_KEYINT       (64)
+// values are stored as int16_t value*MLXREC_SCALE (centi-degrees)
+#define MLXREC_SCALE        (100.)
+#define MLXREC_VERSION      (1)
+// extension of index file
+#define MLXREC_IDXEXT       ".idx"
+
+// frame types
+enum{
+    MLXREC_KEY = 1,         // int16_t values
+    MLXREC_DELTA            // zigzag varint difference with previous frame
+};
+
+// data file header
+typedef struct{
+    char magic[4];          // "MLXR"
+    uint16_t version;
+    uint16_t keyint;        // keyframe interval (1 - no delta frames)
+    uint16_t width;
+    uint16_t height;
+    float scale;            // value = int16_t / scale
+} mlxrec_header;
+
+// header of each frame in data file; payload follows, padded to 8 bytes
+typedef struct{
+    uint32_t size;          // payload size, bytes (0 - end of data)
+    uint32_t seqno;         // frame number
+    double Tstamp;          // frame time
+    uint16_t type;          // MLXREC_KEY or MLXREC_DELTA
+    uint16_t reserved[3];
+} mlxrec_frame;
+
+// record of index file
+typedef struct{
+    double Tstamp;
+    uint64_t offset;        // offset of mlxrec_frame in data file
+    uint32_t seqno;
+    uint32_t type;
+} mlxrec_idx;
+
+typedef struct mlxrec mlxrec;
+typedef struct mlxrec_reader mlxrec_reader;
+
+mlxrec *mlxrec_create(const char *path, uint16_t keyint);
+int mlxrec_write(mlxrec *r, const double *image, double Tstamp, uint32_t seqno);
+void mlxrec_sync(mlxrec *r);
+void mlxrec_close(mlxrec *r);
+
+mlxrec_reader *mlxrec_open(const char *path);
+uint32_t mlxrec_nframes(const mlxrec_reader *r);
+const mlxrec_idx *mlxrec_index(const mlxrec_reader *r, uint32_t n);
+int64_t mlxrec_find(const mlxrec_reader *r, double t);
+int mlxrec_read(mlxrec_reader *r, uint32_t n, double *image);
+void mlxrec_reader_close(mlxrec_reader *r);
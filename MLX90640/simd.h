@@ -0,0 +1,90 @@
+/*
+ * This file is part of the mxl90640wPi project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Minimal 4 x float32 vector abstraction: NEON (ARM) or SSE2 (x86),
+// if none of them available MLX_SIMD is undefined and only scalar code should be used
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MLX_SIMD    "NEON"
+
+typedef float32x4_t v4f;
+typedef uint32x4_t  v4m; // comparison mask
+
+static inline v4f v4_load(const float *p){ return vld1q_f32(p); }
+static inline void v4_store(float *p, v4f a){ vst1q_f32(p, a); }
+static inline v4f v4_set(float x){ return vdupq_n_f32(x); }
+static inline v4f v4_add(v4f a, v4f b){ return vaddq_f32(a, b); }
+static inline v4f v4_sub(v4f a, v4f b){ return vsubq_f32(a, b); }
+static inline v4f v4_mul(v4f a, v4f b){ return vmulq_f32(a, b); }
+static inline v4m v4_lt(v4f a, v4f b){ return vcltq_f32(a, b); }
+static inline v4m v4_gt(v4f a, v4f b){ return vcgtq_f32(a, b); }
+static inline v4m v4_and(v4m a, v4m b){ return vandq_u32(a, b); }
+// a where mask is set, else b
+static inline v4f v4_sel(v4m m, v4f a, v4f b){ return vbslq_f32(m, a, b); }
+// swap bytes of 8 uint16_t in place
+static inline void v8u16_bswap(uint16_t *p){ vst1q_u8((uint8_t*)p, vrev16q_u8(vld1q_u8((const uint8_t*)p))); }
+#ifdef __aarch64__
+static inline v4f v4_div(v4f a, v4f b){ return vdivq_f32(a, b); }
+static inline v4f v4_sqrt(v4f a){ return vsqrtq_f32(a); }
+#else
+// ARMv7 have no division & sqrt: use estimation + two Newton-Raphson steps
+static inline v4f v4_div(v4f a, v4f b){
+    v4f r = vrecpeq_f32(b);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    r = vmulq_f32(vrecpsq_f32(b, r), r);
+    return vmulq_f32(a, r);
+}
+static inline v4f v4_sqrt(v4f a){
+    v4f r = vrsqrteq_f32(a);
+    r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+    r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+    // sqrt(0) = 0*inf = NaN, so fix it
+    return vbslq_f32(vceqq_f32(a, vdupq_n_f32(0.f)), a, vmulq_f32(a, r));
+}
+#endif
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MLX_SIMD    "SSE2"
+
+typedef __m128 v4f;
+typedef __m128 v4m;
+
+static inline v4f v4_load(const float *p){ return _mm_loadu_ps(p); }
+static inline void v4_store(float *p, v4f a){ _mm_storeu_ps(p, a); }
+static inline v4f v4_set(float x){ return _mm_set1_ps(x); }
+static inline v4f v4_add(v4f a, v4f b){ return _mm_add_ps(a, b); }
+static inline v4f v4_sub(v4f a, v4f b){ return _mm_sub_ps(a, b); }
+static inline v4f v4_mul(v4f a, v4f b){ return _mm_mul_ps(a, b); }
+static inline v4f v4_div(v4f a, v4f b){ return _mm_div_ps(a, b); }
+static inline v4f v4_sqrt(v4f a){ return _mm_sqrt_ps(a); }
+static inline v4m v4_lt(v4f a, v4f b){ return _mm_cmplt_ps(a, b); }
+static inline v4m v4_gt(v4f a, v4f b){ return _mm_cmpgt_ps(a, b); }
+static inline v4m v4_and(v4m a, v4m b){ return _mm_and_ps(a, b); }
+static inline v4f v4_sel(v4m m, v4f a, v4f b){ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline void v8u16_bswap(uint16_t *p){
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    _mm_storeu_si128((__m128i*)p, _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+}
+
+#endif
@@ -44,14 +44,31 @@
 static HTU21D_status htustatus = HTU21D_RELAX;
 static float Tmeasured, Hmeasured;
 static double lastw = 0.; // last time of measurements start
+static double convtime = 0.; // max time of current conversion
+static HTU21D_resolution htures = HTU21D_RES_T14_H12;
+// max conversion times (s) of T and RH for each resolution
+static const double Tconv[HTU21D_RES_AMOUNT] = {0.050, 0.013, 0.025, 0.007};
+static const double Hconv[HTU21D_RES_AMOUNT] = {0.016, 0.003, 0.005, 0.008};
+// resolution bits of user register
+#define HTU21_REG_RESMASK   (HTU21_REG_D1 | HTU21_REG_D0)
+#define RES2REG(r)          ((((r) & 2) ? HTU21_REG_D1 : 0) | (((r) & 1) ? HTU21_REG_D0 : 0))
+#define REG2RES(v)          ((HTU21D_resolution)((((v) & HTU21_REG_D1) ? 2 : 0) | (((v) & HTU21_REG_D0) ? 1 : 0)))
 
 HTU21D_status HTU21D_get_status(){
     return htustatus;
 }
 
+/**
+ * @brief HTU21D_deadline - expected end of current conversion
+ * @return time (by dtime()) when data should be ready or 0 if there's no conversion in progress
+ */
+double HTU21D_deadline(){
+    if(htustatus != HTU21D_BUSY) return 0.;
+    return lastw + convtime;
+}
+
 static int writecmd(uint8_t cmd){
-    if(1 != write(i2c_getfd(), &cmd, 1)) return FALSE;
-    return TRUE;
+    return i2c_write_raw(&cmd, 1);
 }
 
 /**
@@ -66,11 +83,13 @@ int HTU21D_read_ID(){
         return FALSE;
     }
     DBG("HTU, reg: 0x%02x", ID);
-    if(ID != HTU21_REG_DEFVAL){
+    // resolution and heater could be changed by previous run
+    if((ID & ~(HTU21_REG_RESMASK | HTU21_REG_HTR)) != HTU21_REG_DEFVAL){
         DBG("Not HTU21D or need reloading\n");
         writecmd(HTU21_SOFT_RESET);
         return FALSE;
     }
+    htures = REG2RES(ID);
     return TRUE;
 }
 
@@ -82,6 +101,7 @@ int HTU21D_startmeasure(){
     }
     DBG("Wait for T\n");
     lastw = dtime();
+    convtime = Tconv[htures];
     return TRUE;
 }
 
@@ -93,6 +113,7 @@ static void HTU21D_cmdH(){
     }
     DBG("Wait for H, dt=%g", dtime() - lastw);
     lastw = dtime();
+    convtime = Hconv[htures];
 }
 
 int HTU21D_getTH(float *T, float *H){
@@ -121,7 +142,7 @@ static uint32_t htu_check_crc(uint8_t *crc){
 void HTU21D_process(){
 	uint8_t d[3];
     if(htustatus != HTU21D_BUSY) return;
-    if(3 != read(i2c_getfd(), d, 3)){ // NACK'ed - not ready
+    if(!i2c_read_raw(d, 3)){ // NACK'ed - not ready
         if(dtime() - lastw > HTU21D_CONVTIMEOUT){
             DBG("Wait too long -> err");
             htustatus = HTU21D_ERR;
@@ -164,3 +185,28 @@ int HTU21D_heater(int ON){
     }
     return TRUE;
 }
+
+/**
+ * @brief HTU21D_set_resolution - change measurement resolution (and conversion time)
+ * @return FALSE if failed
+ */
+int HTU21D_set_resolution(HTU21D_resolution r){
+    if(htustatus != HTU21D_RELAX || r >= HTU21D_RES_AMOUNT) return FALSE;
+    uint8_t val;
+    if(!i2c_read_reg8(HTU21_READ_USERREG, &val)){
+        DBG("Can't read userreg");
+        return FALSE;
+    }
+    val = (val & ~HTU21_REG_RESMASK) | RES2REG(r);
+    DBG("REG -> 0x%02x", val);
+    if(!i2c_write_reg8(HTU21_WRITE_USERREG, val)){
+        DBG("Can't write userreg");
+        return FALSE;
+    }
+    htures = r;
+    return TRUE;
+}
+
+HTU21D_resolution HTU21D_get_resolution(){
+    return htures;
+}
@@ -28,11 +28,23 @@ typedef enum{
     HTU21D_RDY,         // data ready - can get it
 } HTU21D_status;
 
+// measurement resolution (user register bits D1, D0)
+typedef enum{
+    HTU21D_RES_T14_H12 = 0, // default
+    HTU21D_RES_T12_H8,
+    HTU21D_RES_T13_H10,
+    HTU21D_RES_T11_H11,
+    HTU21D_RES_AMOUNT
+} HTU21D_resolution;
+
 HTU21D_status HTU21D_get_status();
 
 int HTU21D_read_ID();
 void HTU21D_process();
+double HTU21D_deadline();
 int HTU21D_startmeasure();
 int HTU21D_getTH(float *T, float *H);
 int HTU21D_heater(int ON);
+int HTU21D_set_resolution(HTU21D_resolution r);
+HTU21D_resolution HTU21D_get_resolution();
 
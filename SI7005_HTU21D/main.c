@@ -17,7 +17,9 @@
  */
 
 #include <math.h>
+#include <signal.h>
 #include <stdio.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <usefull_macros.h>
 
@@ -26,22 +28,56 @@
 #include "i2c.h"
 
 #define DEVADDR     (0x40)
+// min interval between polls of busy sensor, s
+#define POLL_INTERVAL   (0.002)
 
 typedef struct{
     char *device;
     int help;
     int heater;
+    int nmeas;
+    int resolution;
+    int fast;
+    double period;
 } glob_pars;
 
-static glob_pars G = {.device = "/dev/i2c-3", .heater = -1};
+static glob_pars G = {.device = "/dev/i2c-3", .heater = -1, .nmeas = 4, .resolution = -1, .period = 1.};
 
 static myoption cmdlnopts[] = {
     {"help",    NO_ARGS,    NULL,   'h',    arg_int,    APTR(&G.help),      _("show this help")},
     {"device",  NEED_ARG,   NULL,   'd',    arg_string, APTR(&G.device),    _("I2C device path")},
     {"heater",  NEED_ARG,   NULL,   'H',    arg_int,    APTR(&G.heater),    _("turn on (>0) or off (0) heater")},
+    {"nmeas",   NEED_ARG,   NULL,   'N',    arg_int,    APTR(&G.nmeas),     _("amount of measurements (default: 4, 0 - run continuously)")},
+    {"period",  NEED_ARG,   NULL,   'p',    arg_double, APTR(&G.period),    _("measurements period, s (default: 1)")},
+    {"resolution",NEED_ARG, NULL,   'R',    arg_int,    APTR(&G.resolution),_("HTU21D resolution: 0 - T14/H12 bit, 1 - T12/H8, 2 - T13/H10, 3 - T11/H11")},
+    {"fast",    NO_ARGS,    NULL,   'F',    arg_int,    APTR(&G.fast),      _("SI7005 fast conversion mode")},
    end_option
 };
 
+// counters
+static uint32_t nmeasured = 0, npolls = 0, nerrors = 0;
+static double tstart = 0.;
+
+void signals(int sig){
+    if(sig){
+        signal(sig, SIG_IGN);
+        DBG("Get signal %d, quit.\n", sig);
+    }
+    struct rusage ru;
+    double t = dtime() - tstart;
+    printf("%u measurements in %.1fs, %u polls, %u errors\n", nmeasured, t, npolls, nerrors);
+    i2cdev *d = i2c_getdev();
+    if(d) printf("I2C: %llu transfers, %llu messages, %llu bytes, %llu errors\n",
+                 (unsigned long long)d->bus->stat.transfers, (unsigned long long)d->bus->stat.msgs,
+                 (unsigned long long)d->bus->stat.bytes, (unsigned long long)d->bus->stat.errors);
+    if(getrusage(RUSAGE_SELF, &ru) == 0){
+        double u = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6, s = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+        printf("CPU: user %.3fs, system %.3fs (%.2f%%)\n", u, s, (t > 0.) ? 100. * (u + s) / t : 0.);
+    }
+    i2c_close();
+    exit(sig);
+}
+
 static void showd(float T, float H){
 // Sonntag1990
 #define dB  17.62f
@@ -50,55 +86,85 @@ static void showd(float T, float H){
     float gamma = logf(H/100.f) + dB*T/(dC + T);
     float Tdp = dC * gamma / (dB - gamma);
     printf("T=%.1fC, H=%.1f%%, Tdp=%.1fC\n", T, H, Tdp);
-    static int i = 0;
-    if(++i > 3) signals(0);
+    fflush(stdout);
+    if(G.nmeas && ++nmeasured >= (uint32_t)G.nmeas) signals(0);
+    else if(!G.nmeas) ++nmeasured;
 }
 
-static void processSI(){
-    static double t0 = 0.;
-    si7005_process();
-    si7005_status s = si7005_get_status();
-    if(s == SI7005_RELAX){
-        if(dtime() - t0 > 1.){
-            DBG("need to start measure");
-            if(si7005_startmeasure()) t0 = dtime();
+// time of next poll of busy sensor: expected conversion end but not earlier than POLL_INTERVAL from now
+static double nextpoll(double deadline){
+    double t = dtime() + POLL_INTERVAL;
+    return (deadline > t) ? deadline : t;
+}
+
+// these functions return time (by dtime()) of next call
+static double processSI(){
+    static double t0 = 0.; // time of last measurement start
+    if(si7005_get_status() == SI7005_BUSY){
+        ++npolls;
+        si7005_process();
+    }
+    switch(si7005_get_status()){
+        case SI7005_BUSY:
+            return nextpoll(si7005_deadline());
+        case SI7005_RDY:{ // humidity can be shown
+            DBG("Got data");
+            float T, H;
+            if(si7005_getTH(&T, &H)) showd(T, H);
         }
-    }else if(s == SI7005_RDY){ // humidity can be shown
-        DBG("Got data");
-        float T, H;
-        if(!si7005_getTH(&T, &H)) return;
-        showd(T, H);
-        t0 = dtime();
-    }else if(s == SI7005_ERR){
-        DBG("got error");
-        if(si7005_startmeasure()) t0 = dtime();
+        break;
+        case SI7005_ERR:
+            DBG("got error");
+            ++nerrors;
+        break;
+        default:
+        break;
     }
+    // relaxed or error: start next measurement in time
+    double now = dtime();
+    if(now < t0 + G.period) return t0 + G.period;
+    DBG("need to start measure");
+    t0 = now;
+    if(!si7005_startmeasure()) return t0 + G.period;
+    return nextpoll(si7005_deadline());
 }
-static void processHTU(){
+static double processHTU(){
     static double t0 = 0.;
-    HTU21D_process();
-    HTU21D_status s = HTU21D_get_status();
-    if(s == HTU21D_RELAX){
-        if(dtime() - t0 > 1.){
-            DBG("need to start measure");
-            if(HTU21D_startmeasure()) t0 = dtime();
+    if(HTU21D_get_status() == HTU21D_BUSY){
+        ++npolls;
+        HTU21D_process();
+    }
+    switch(HTU21D_get_status()){
+        case HTU21D_BUSY:
+            return nextpoll(HTU21D_deadline());
+        case HTU21D_RDY:{
+            DBG("Got data");
+            float T, H;
+            if(HTU21D_getTH(&T, &H)) showd(T, H);
         }
-    }else if(s == HTU21D_RDY){ // humidity can be shown
-        DBG("Got data");
-        float T, H;
-        if(!HTU21D_getTH(&T, &H)) return;
-        showd(T, H);
-        t0 = dtime();
-    }else if(s == HTU21D_ERR){
-        DBG("got error");
-        if(HTU21D_startmeasure()) t0 = dtime();
+        break;
+        case HTU21D_ERR:
+            DBG("got error");
+            ++nerrors;
+        break;
+        default:
+        break;
     }
+    double now = dtime();
+    if(now < t0 + G.period) return t0 + G.period;
+    DBG("need to start measure");
+    t0 = now;
+    if(!HTU21D_startmeasure()) return t0 + G.period;
+    return nextpoll(HTU21D_deadline());
 }
 
 int main(int argc, char **argv){
     initial_setup();
     parseargs(&argc, &argv, cmdlnopts);
     if(G.help) showhelp(-1, cmdlnopts);
+    if(G.nmeas < 0) ERRX("nmeas should be >= 0");
+    if(G.period < POLL_INTERVAL) ERRX("period should be not less than %gs", POLL_INTERVAL);
+    if(G.resolution >= HTU21D_RES_AMOUNT) ERRX("resolution should be 0..%d", HTU21D_RES_AMOUNT - 1);
     if(!i2c_open(G.device)) ERR("Can't open %s", G.device);
     if(!i2c_set_slave_address((uint8_t)DEVADDR)){
         WARN("Can't set slave address 0x%02x", DEVADDR);
@@ -109,19 +175,24 @@ int main(int argc, char **argv){
     if(!si7005_read_ID()){
         DBG("Don't see SI7005");
         si = 0;
-        if(!HTU21D_read_ID()){
-            ERRX("Neither SI7005 nor HTU21D not found");
-        }else while(!HTU21D_startmeasure()) usleep(1000);
-    }else while(!si7005_startmeasure()) usleep(1000);
+        if(!HTU21D_read_ID()) ERRX("Neither SI7005 nor HTU21D not found");
+    }
     if(G.heater > -1){
         int ans = FALSE;
         if(si) ans = si7005_heater(G.heater);
         else ans = HTU21D_heater(G.heater);
         if(!ans) WARNX("Can't turn on heater");
     }
+    if(si && G.fast && !si7005_fastmode(1)) WARNX("Can't set fast mode");
+    if(!si && G.resolution > -1 && !HTU21D_set_resolution((HTU21D_resolution)G.resolution)) WARNX("Can't change resolution");
+    signal(SIGTERM, signals);
+    signal(SIGINT, signals);
+    signal(SIGQUIT, signals);
+    tstart = dtime();
+    // sleep till conversion end or next measurement start
     while(1){
-        if(si) processSI();
-        else processHTU();
+        double dt = (si ? processSI() : processHTU()) - dtime();
+        if(dt > 0.) usleep((useconds_t)(dt * 1e6));
     }
 clo:
     i2c_close();
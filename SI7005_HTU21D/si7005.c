@@ -18,7 +18,6 @@
 
 #include <stdio.h>
 #include <usefull_macros.h>
-#include <unistd.h>
 
 #include "i2c.h"
 #include "si7005.h"
@@ -39,11 +38,21 @@ static si7005_status sistatus = SI7005_RELAX;
 
 static float Tmeasured, Hmeasured;
 static double lastw = 0.; // last time of measurements start
+static uint8_t confbits = 0; // heater and fast mode bits of config register (kept on measurement start)
 
 si7005_status si7005_get_status(){
     return sistatus;
 }
 
+/**
+ * @brief si7005_deadline - expected end of current conversion
+ * @return time (by dtime()) when data should be ready or 0 if there's no conversion in progress
+ */
+double si7005_deadline(){
+    if(sistatus != SI7005_BUSY) return 0.;
+    return lastw + ((confbits & SI7005_CONFFAST) ? SI7005_CONVTIMEFAST : SI7005_CONVTIME);
+}
+
 /**
  * @brief si7005_read_ID - read device ID
  * @return TRUE if all OK
@@ -69,7 +78,7 @@ int si7005_read_ID(){
  */
 int si7005_startmeasure(){
     sistatus = SI7005_BUSY;
-    if(!i2c_write_reg8(SI7005_REGCONFIG, SI7005_CONFTEMP | SI7005_CONFSTART)){
+    if(!i2c_write_reg8(SI7005_REGCONFIG, confbits | SI7005_CONFTEMP | SI7005_CONFSTART)){
         DBG("Can't write start Tmeas");
         sistatus = SI7005_ERR;
         return FALSE;
@@ -84,8 +93,8 @@ int si7005_startmeasure(){
  */
 static void si7005_cmdH(){
     sistatus = SI7005_BUSY;
-    i2c_write_reg8(SI7005_REGCONFIG, SI7005_CONFSTART);
-    if(!i2c_write_reg8(SI7005_REGCONFIG, SI7005_CONFSTART)){
+    i2c_write_reg8(SI7005_REGCONFIG, confbits | SI7005_CONFSTART);
+    if(!i2c_write_reg8(SI7005_REGCONFIG, confbits | SI7005_CONFSTART)){
         DBG("Can't write start Hmeas");
         sistatus = SI7005_ERR;
         return;
@@ -116,26 +125,24 @@ int si7005_getTH(float *T, float *H){
 void si7005_process(){
 	uint8_t c, d[3];
     if(sistatus != SI7005_BUSY) return;
-    if(3 != read(i2c_getfd(), d, 3)){
-        DBG("Can't read status");
+    // status with data (pointer is at STATUS after STOP) and config by one transfer
+    i2cbatch b;
+    i2cbatch_init(&b, i2c_getdev());
+    i2cbatch_read_raw(&b, d, 3);
+    i2cbatch_read8(&b, SI7005_REGCONFIG, 1, &c);
+    if(!i2cbatch_run(&b)){
+        DBG("Can't read status & config");
         sistatus = SI7005_ERR;
         return;
     }
     DBG("Status: 0x%02x, H: 0x%02x, L: 0x%02x", d[0], d[1], d[2]);
-    if(!i2c_read_reg8(SI7005_REGCONFIG, &c)){
-        DBG("Can't read config");
-        sistatus = SI7005_ERR;
-        return;
-    }
     DBG("Config: 0x%02x", c);
-    if(d[0] & SI7005_STATUSNRDY){ // not ready yet
+    if(d[0] & SI7005_STATUSNRDY){ // not ready yet: caller should wait till si7005_deadline()
     //if(c & SI7005_CONFSTART){
         if(dtime() - lastw > SI7005_CONVTIMEOUT){
             DBG("Wait too long -> err");
             sistatus = SI7005_ERR;
-            return;
         }
-        usleep(20000);
         return;
     }
     uint16_t TH = (uint16_t)((d[1]<<8) | d[2]);
@@ -159,10 +166,23 @@ void si7005_process(){
  */
 int si7005_heater(int ON){
     if(sistatus != SI7005_RELAX) return FALSE;
-    uint8_t reg = (ON) ? SI7005_CONFHEAT : 0;
+    uint8_t reg = (ON) ? (confbits | SI7005_CONFHEAT) : (confbits & ~SI7005_CONFHEAT);
     if(!i2c_write_reg8(SI7005_REGCONFIG, reg)){
         DBG("Can't write write regconfig");
         return FALSE;
     }
+    confbits = reg;
+    return TRUE;
+}
+
+/**
+ * @brief si7005_fastmode - turn on/off fast conversion mode (18ms instead of 35ms, lower resolution)
+ * @param ON == 1 to turn on
+ * @return FALSE if failed
+ */
+int si7005_fastmode(int ON){
+    if(sistatus != SI7005_RELAX) return FALSE;
+    if(ON) confbits |= SI7005_CONFFAST;
+    else confbits &= ~SI7005_CONFFAST;
     return TRUE;
 }
@@ -22,6 +22,9 @@
 
 // conversion timeout (s)
 #define SI7005_CONVTIMEOUT  2.0
+// conversion time (s) in normal and fast modes
+#define SI7005_CONVTIME     (0.035)
+#define SI7005_CONVTIMEFAST (0.018)
 
 typedef enum{
     SI7005_BUSY,        // measurement in progress
@@ -34,8 +37,10 @@ si7005_status si7005_get_status();
 
 int si7005_read_ID();
 void si7005_process();
+double si7005_deadline();
 int si7005_startmeasure();
 int si7005_getTH(float *T, float *H);
 int si7005_heater(int ON);
+int si7005_fastmode(int ON);
 
 
@@ -24,6 +24,7 @@
 #include <usefull_macros.h>
 
 #include "cmdlnopts.h"
+#include "sslsock.h"
 
 
 /*
@@ -41,6 +42,11 @@ static int help;
 #define DEFCA       "ca_cert.pem"
 
 #define DEFGPIO     "/dev/gpiochip0"
+#ifdef THERMAL
+#include "frameserver.h"
+#define DEFI2C      "/dev/i2c-3"
+#define DEFADDR     0x33
+#endif
 // default global parameters
 glob_pars G = {
     .pidfile = DEFAULT_PIDFILE,
@@ -48,9 +54,21 @@ glob_pars G = {
     .cert = DEFCERT,
     .key = DEFKEY,
     .ca = DEFCA,
+#ifdef SERVER
+    .backlog = BACKLOG,
+    .maxclients = MAXCLIENTS,
+#endif
 #ifdef __arm__
     .gpiodevpath  = DEFGPIO,
 #endif
+#ifdef THERMAL
+    .i2cdev = DEFI2C,
+    .addr = DEFADDR,
+    .refresh = 8.,
+    .resolution = 18,
+    .simple = 2,
+    .qlen = FRAMEQ_DEFAULT,
+#endif
 };
 
 /*
@@ -70,9 +88,26 @@ static myoption cmdlnopts[] = {
 #ifdef __arm__
     {"gpiopath",NEED_ARG,   NULL,   'g',    arg_string, APTR(&G.gpiodevpath),_("path to GPIO device (default:" DEFGPIO ")")},
 #endif
+#ifdef THERMAL
+    {"i2cdev",  NEED_ARG,   NULL,   'd',    arg_string, APTR(&G.i2cdev),    _("MLX90640 I2C device path (default: " DEFI2C ")")},
+    {"address", NEED_ARG,   NULL,   'A',    arg_int,    APTR(&G.addr),      _("MLX90640 slave address (default: 0x33)")},
+    {"refresh", NEED_ARG,   NULL,   'r',    arg_double, APTR(&G.refresh),   _("refresh rate, Hz (0.5, 1, 2, 4, 8, 16, 32, 64; default: 8)")},
+    {"resolution",NEED_ARG, NULL,   'R',    arg_int,    APTR(&G.resolution),_("ADC resolution, bits (16..19, default: 18)")},
+    {"simple",  NEED_ARG,   NULL,   's',    arg_int,    APTR(&G.simple),    _("image processing type (0..2, default: 2)")},
+    {"fill",    NEED_ARG,   NULL,   'f',    arg_int,    APTR(&G.fill),      _("frame after each subpage: 0 - no (default), 1 - other half from previous subpage, 2 - interpolate other half")},
+    {"caldir",  NEED_ARG,   NULL,   'D',    arg_string, APTR(&G.caldir),    _("directory for calibration cache (don't use cache if absent)")},
+    {"qlen",    NEED_ARG,   NULL,   'q',    arg_int,    APTR(&G.qlen),      _("max amount of frames queued for each client (default: 4)")},
+#endif
+#ifdef SERVER
+    {"backlog", NEED_ARG,   NULL,   'b',    arg_int,    APTR(&G.backlog),   _("listen() backlog (default: 128)")},
+    {"maxclients",NEED_ARG, NULL,   'm',    arg_int,    APTR(&G.maxclients),_("max amount of clients (default: 256)")},
+#endif
 #ifdef CLIENT
     {"server",  NEED_ARG,   NULL,   's',    arg_string, APTR(&G.serverhost),  _("server IP address or name")},
     {"command", MULT_PAR,   NULL,   'C',    arg_string, APTR(&G.commands),  _("don't run client as daemon, just send given commands to server")},
+    {"session", NEED_ARG,   NULL,   'S',    arg_string, APTR(&G.session),   _("file to store TLS session (to resume it on next run)")},
+    {"bench",   NEED_ARG,   NULL,   'B',    arg_int,    APTR(&G.bench),     _("measure rate of full and resumed handshakes by given amount of connections")},
+    {"load",    NEED_ARG,   NULL,   'L',    arg_int,    APTR(&G.load),      _("load test: open given amount of concurrent connections and send command by each")},
 #endif
    end_option
 };
@@ -37,9 +37,26 @@ typedef struct{
     char *port;             // port number
     int verbose;            // logfile verbose level
     char *ca;               // ca
+#ifdef SERVER
+    int backlog;            // listen() backlog
+    int maxclients;         // max amount of connected clients
+#endif
 #ifdef CLIENT
     char *serverhost;       // server IP address
     char **commands;        // don't run as daemon, just send given commands to server
+    char *session;          // file to store TLS session for resumption
+    int bench;              // amount of connections for handshake benchmark
+    int load;               // amount of concurrent connections for load test
+#endif
+#ifdef THERMAL
+    char *i2cdev;           // I2C device path
+    int addr;               // MLX90640 slave address
+    double refresh;         // refresh rate, Hz
+    int resolution;         // ADC resolution, bits
+    int simple;             // image processing type
+    int fill;               // image after each subpage: mlx_fillmode
+    char *caldir;           // directory for calibration cache files
+    int qlen;               // max length of per-client frame queue
 #endif
 #ifdef __arm__
     char *gpiodevpath;      // path to gpio device file
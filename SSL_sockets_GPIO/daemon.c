@@ -86,7 +86,7 @@ int start_daemon(_U_ char *self){
     LOGMSG("Started");
 #ifndef EBUG
 #ifdef CLIENT
-    if(G.commands) return open_socket();
+    if(G.commands || G.bench || G.load) return open_socket();
 #endif
     while(1){
         childpid = fork();
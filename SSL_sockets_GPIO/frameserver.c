@@ -0,0 +1,316 @@
+/*
+ * This file is part of the sslsosk project.
+ * Copyright 2023 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <usefull_macros.h>
+
+#include "cmdlnopts.h"
+#include "frameserver.h"
+#include "mlx90640.h"
+
+// frame values are sent as int16_t degC*FRAME_SCALE
+#define FRAME_SCALE     (100.f)
+
+// encoded frame shared by all clients
+// reference counter is changed only in server thread (acquisition thread only creates buffers)
+typedef struct{
+    int refcnt;
+    size_t len;
+    uint8_t data[];
+} framebuf;
+
+typedef struct{
+    SSL *ssl;
+    int fd;
+    int handshake;          // TRUE while SSL_accept() isn't done
+    short hsevents;         // poll events needed for handshake
+    double tconn;           // time of connection
+    framebuf *q[FRAMEQ_MAX];// frame queue, q[0] is being sent
+    int qlen;
+    size_t off;             // bytes of q[0] already sent
+    int pending;            // q[0] write is started (SSL holds its record): it can't be dropped or replaced
+    uint32_t dropped;       // frames dropped due to slow connection
+} fclient;
+
+// frame handoff from acquisition thread
+static struct{
+    pthread_mutex_t mutex;
+    framebuf *pending;      // the newest frame not taken by server yet
+    int evfd;               // eventfd to wake up server
+    uint32_t lost;          // frames replaced before server took them
+} pub = {.mutex = PTHREAD_MUTEX_INITIALIZER, .evfd = -1};
+
+static fclient *clients = NULL; // G.maxclients items
+static int nclients = 0;
+static int qmax = FRAMEQ_DEFAULT;
+
+static framebuf *fb_ref(framebuf *b){
+    ++b->refcnt;
+    return b;
+}
+
+static void fb_unref(framebuf *b){
+    if(b && --b->refcnt == 0) free(b);
+}
+
+// encode frame (once for all clients)
+static framebuf *fb_encode(const mlx90640_frame *frame){
+    size_t len = sizeof(frame_header) + MLX_PIXNO * sizeof(int16_t);
+    framebuf *b = malloc(sizeof(framebuf) + len);
+    if(!b) ERR("malloc()");
+    b->refcnt = 1;
+    b->len = len;
+    frame_header *h = (frame_header*)b->data;
+    memcpy(h->magic, "MLXF", 4);
+    h->seqno = frame->seqno;
+    h->Tstamp = frame->Tstamp;
+    h->width = MLX_W;
+    h->height = MLX_H;
+    h->scale = FRAME_SCALE;
+    int16_t *out = (int16_t*)(h + 1);
+    for(int i = 0; i < MLX_PIXNO; ++i){
+        float v = roundf((float)frame->image[i] * FRAME_SCALE);
+        if(v > INT16_MAX) v = INT16_MAX;
+        else if(v < INT16_MIN) v = INT16_MIN;
+        out[i] = (int16_t)v;
+    }
+    return b;
+}
+
+// stream callback: runs in acquisition thread, so never waits for clients
+static void frame_cb(_U_ mlx90640_dev *d, const mlx90640_frame *frame){
+    framebuf *b = fb_encode(frame);
+    pthread_mutex_lock(&pub.mutex);
+    framebuf *old = pub.pending;
+    pub.pending = b;
+    if(old) ++pub.lost;
+    pthread_mutex_unlock(&pub.mutex);
+    fb_unref(old); // server didn't see it, so we are the only owner
+    uint64_t one = 1;
+    if(write(pub.evfd, &one, sizeof(one)) < 0) WARN("write(eventfd)");
+}
+
+static mlx90640_dev *thermal_open(){
+    if(G.simple < 0 || G.simple > 2) ERRX("simple = 0..2");
+    if(G.addr < 0 || G.addr > 0x7f) ERRX("Wrong I2C address");
+    if(G.caldir) mlx90640_set_caldir(G.caldir);
+    mlx90640_dev *mlx = mlx90640_init(G.i2cdev, (uint8_t)G.addr);
+    if(!mlx){
+        LOGERR("Can't open MLX90640 @ %s", G.i2cdev);
+        ERRX("Can't open MLX90640 @ %s", G.i2cdev);
+    }
+    if(!mlx90640_set_mode(mlx, G.refresh, G.resolution)) ERRX("Wrong refresh rate or resolution");
+    if(!mlx90640_set_fillmode(mlx, G.fill)) ERRX("Wrong fill mode");
+    if(!mlx90640_stream_start(mlx, (uint8_t)G.simple, frame_cb)) ERRX("Can't run stream mode");
+    return mlx;
+}
+
+// remove q[idx] from client's queue
+static void q_drop(fclient *c, int idx){
+    fb_unref(c->q[idx]);
+    --c->qlen;
+    memmove(&c->q[idx], &c->q[idx+1], (c->qlen - idx) * sizeof(framebuf*));
+}
+
+// add frame to queue; if it's full drop the oldest frame which isn't being sent
+static void q_add(fclient *c, framebuf *b){
+    if(c->qlen == qmax){
+        ++c->dropped;
+        int idx = c->pending ? 1 : 0;
+        if(idx == c->qlen) return; // the only frame is being sent: drop new one
+        q_drop(c, idx);
+    }
+    c->q[c->qlen++] = fb_ref(b);
+}
+
+// send queued frames until socket is full
+// @return FALSE if client should be disconnected
+static int q_flush(fclient *c){
+    while(c->qlen){
+        framebuf *b = c->q[0];
+        int w = SSL_write(c->ssl, b->data + c->off, (int)(b->len - c->off));
+        if(w <= 0){
+            int e = SSL_get_error(c->ssl, w);
+            if(e == SSL_ERROR_WANT_WRITE || e == SSL_ERROR_WANT_READ){
+                c->pending = TRUE; // retry should be with the same buffer
+                return TRUE;
+            }
+            DBG("SSL_write() error %d @ fd=%d", e, c->fd);
+            return FALSE;
+        }
+        c->off += w;
+        if(c->off < b->len){
+            c->pending = TRUE;
+            continue;
+        }
+        c->off = 0;
+        c->pending = FALSE;
+        q_drop(c, 0);
+    }
+    return TRUE;
+}
+
+// @return FALSE if handshake failed
+static int handshake(fclient *c){
+    int x = SSL_accept(c->ssl);
+    if(x == 1){
+        c->handshake = FALSE;
+        DBG("fd=%d: handshake done", c->fd);
+        return TRUE;
+    }
+    int e = SSL_get_error(c->ssl, x);
+    if(e == SSL_ERROR_WANT_READ) c->hsevents = POLLIN;
+    else if(e == SSL_ERROR_WANT_WRITE) c->hsevents = POLLOUT;
+    else{
+        DBG("SSL_accept() error %d @ fd=%d", e, c->fd);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// clients only can send trash: read and forget it
+// @return FALSE if client disconnected
+static int drain_input(fclient *c){
+    char buf[256];
+    int r;
+    while((r = SSL_read(c->ssl, buf, sizeof(buf))) > 0);
+    int e = SSL_get_error(c->ssl, r);
+    return (e == SSL_ERROR_WANT_READ || e == SSL_ERROR_WANT_WRITE);
+}
+
+static void client_add(SSL_CTX *ctx, int fd){
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int sd = accept4(fd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK);
+    if(sd < 0){
+        if(errno != EAGAIN) WARN("accept4()");
+        return;
+    }
+    LOGMSG("Client %s connected to port %d (fd=%d)", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), sd);
+    if(nclients == G.maxclients){
+        LOGWARN("Max amount of connections: disconnect fd=%d", sd);
+        WARNX("Limit of connections reached");
+        close(sd);
+        return;
+    }
+    fclient *c = &clients[nclients++];
+    memset(c, 0, sizeof(fclient));
+    c->ssl = SSL_new(ctx);
+    SSL_set_fd(c->ssl, sd);
+    c->fd = sd;
+    c->handshake = TRUE;
+    c->hsevents = POLLIN;
+    c->tconn = dtime();
+}
+
+static void client_del(int idx){
+    fclient *c = &clients[idx];
+    LOGMSG("Client fd=%d disconnected, %u frames dropped", c->fd, c->dropped);
+    DBG("Client fd=%d disconnected, %u frames dropped", c->fd, c->dropped);
+    while(c->qlen) q_drop(c, c->qlen - 1);
+    SSL_free(c->ssl);
+    close(c->fd);
+    if(--nclients > idx) *c = clients[nclients]; // move last client to current position
+}
+
+// send new frame to all clients
+static void fanout(){
+    uint64_t cnt;
+    if(read(pub.evfd, &cnt, sizeof(cnt)) < 0) return;
+    pthread_mutex_lock(&pub.mutex);
+    framebuf *b = pub.pending;
+    pub.pending = NULL;
+    pthread_mutex_unlock(&pub.mutex);
+    if(!b) return;
+    for(int i = 0; i < nclients; ++i){
+        if(clients[i].handshake) continue;
+        q_add(&clients[i], b);
+    }
+    fb_unref(b);
+    for(int i = nclients - 1; i > -1; --i){ // try to send it right now
+        if(clients[i].handshake) continue;
+        if(!q_flush(&clients[i])) client_del(i);
+    }
+}
+
+/**
+ * @brief frameserverproc - main server loop: accept clients and send them MLX90640 frames
+ * @param ctx - SSL context
+ * @param fd - listening socket
+ * Acquisition runs in its own thread and only passes new frames here through eventfd, so slow
+ * clients only lose frames (the oldest queued frames are dropped) and never stall acquisition.
+ */
+void frameserverproc(SSL_CTX *ctx, int fd){
+    int enable = 1;
+    if(ioctl(fd, FIONBIO, (void *)&enable) < 0){
+        LOGERR("Can't make socket nonblocking");
+        ERRX("ioctl()");
+    }
+    if(G.qlen < 1 || G.qlen > FRAMEQ_MAX) ERRX("qlen should be from 1 to %d", FRAMEQ_MAX);
+    qmax = G.qlen;
+    // we always retry with the same frame, but it could be moved in queue
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    pub.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(pub.evfd < 0) ERR("eventfd()");
+    mlx90640_dev *mlx = thermal_open();
+    if(G.maxclients < 1) ERRX("maxclients should be positive");
+    clients = MALLOC(fclient, G.maxclients);
+    struct pollfd *poll_set = MALLOC(struct pollfd, G.maxclients + 2);
+    while(1){
+        poll_set[0] = (struct pollfd){.fd = fd, .events = POLLIN};
+        poll_set[1] = (struct pollfd){.fd = pub.evfd, .events = POLLIN};
+        for(int i = 0; i < nclients; ++i){
+            fclient *c = &clients[i];
+            short ev = c->handshake ? c->hsevents : (c->qlen ? POLLIN | POLLOUT : POLLIN);
+            poll_set[i+2] = (struct pollfd){.fd = c->fd, .events = ev};
+        }
+        int n = nclients; // clients could be added or removed below
+        if(poll(poll_set, n + 2, 1000) < 0){
+            if(errno == EINTR) continue;
+            ERR("poll()");
+        }
+        // from last to first: client_del() moves the last client to freed place
+        for(int i = n - 1; i > -1; --i){
+            short rev = poll_set[i+2].revents;
+            fclient *c = &clients[i];
+            int ok = TRUE;
+            if(c->handshake){
+                if(rev) ok = handshake(c);
+                if(ok && c->handshake && dtime() - c->tconn > ACCEPT_TIMEOUT){
+                    LOGWARN("fd=%d: handshake timeout", c->fd);
+                    ok = FALSE;
+                }
+            }else{
+                if(rev & (POLLERR | POLLHUP | POLLNVAL)) ok = FALSE;
+                if(ok && (rev & POLLIN)) ok = drain_input(c);
+                if(ok && (rev & POLLOUT)) ok = q_flush(c);
+            }
+            if(!ok) client_del(i);
+        }
+        if(poll_set[1].revents & POLLIN) fanout();
+        if(poll_set[0].revents & POLLIN) client_add(ctx, fd);
+    }
+    // never reached
+    mlx90640_close(mlx);
+}
@@ -1,6 +1,6 @@
 /*
- * This file is part of the sihtu project.
- * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ * This file is part of the sslsosk project.
+ * Copyright 2023 Edward V. Emelianov <edward.emelianoff@gmail.com>.
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -19,22 +19,21 @@
 #pragma once
 
 #include <stdint.h>
+#include "server.h"
 
-#ifndef FALSE
-#define FALSE 0
-#endif
-#ifndef TRUE
-#define TRUE 1
-#endif
+// max length of per-client frame queue
+#define FRAMEQ_MAX      (16)
+// default length of per-client frame queue
+#define FRAMEQ_DEFAULT  (4)
 
-int i2c_getfd();
-int i2c_open(const char *path);
-void i2c_close();
-int i2c_set_slave_address(uint8_t addr);
-int i2c_read_reg8(uint8_t regaddr, uint8_t *data);
-int i2c_write_reg8(uint8_t regaddr, uint8_t data);
-int i2c_read_data8(uint8_t regaddr, uint16_t N, uint8_t *array);
-int i2c_read_reg16(uint16_t regaddr, uint16_t *data);
-int i2c_write_reg16(uint16_t regaddr, uint16_t data);
-int i2c_read_data16(uint16_t regaddr, uint16_t N, uint8_t *array);
+// header of each frame sent to clients (followed by `width*height` int16_t values, degC*scale)
+typedef struct{
+    char magic[4];          // "MLXF"
+    uint32_t seqno;         // frame number
+    double Tstamp;          // time of frame acquisition (UNIX time)
+    uint16_t width;
+    uint16_t height;
+    float scale;            // value = data / scale
+} frame_header;
 
+void frameserverproc(SSL_CTX *ctx, int fd);
@@ -148,7 +148,15 @@ int gpio_setup_inputs(){
 }
 
 /**
- * @brief gpio_poll - poll inputs, return only last event
+ * @brief gpio_event_fd - descriptor of input line events (to wait for them in epoll)
+ * @return rq_in.fd
+ */
+int gpio_event_fd(){
+    return rq_in.fd;
+}
+
+/**
+ * @brief gpio_poll - poll inputs (don't wait), return only last event
  * @return bit mask of changing inputs (edge falling), 0 if nothing happen or -1 if error
  */
 int gpio_poll(uint32_t *up, uint32_t *down){
@@ -161,7 +169,7 @@ int gpio_poll(uint32_t *up, uint32_t *down){
     do{
         pfd.fd = rq_in.fd;
         pfd.events = POLLIN | POLLPRI;
-        int p = poll(&pfd, 1, 1);
+        int p = poll(&pfd, 1, 0);
         if(p == 0) break; // nothing happened
         else if(p == -1){
             LOGERR("poll() error: %s", strerror(errno));
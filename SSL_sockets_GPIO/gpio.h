@@ -38,6 +38,7 @@
 int gpio_open_device(const char *path);
 int gpio_setup_outputs();
 int gpio_setup_inputs();
+int gpio_event_fd();
 int gpio_poll(uint32_t *up, uint32_t *down);
 int gpio_set_output(int input);
 int gpio_clear_output(int input);
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the sslsosk project.
+ * Copyright 2023 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// check of line buffer: strings (including much longer than buffer) fed by random portions should be got
+// byte-exact; run by `make check`
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linebuf.h"
+
+// lengths of test strings
+static const int lengths[] = {3, 0, 2*LINEBUF_SZ + 952, 5, LINEBUF_SZ - 1, LINEBUF_SZ, LINEBUF_SZ + 1, 1, 3*LINEBUF_SZ, 7};
+#define NSTR    ((int)(sizeof(lengths)/sizeof(lengths[0])))
+
+int main(){
+    // input stream and expected output: strings longer than buffer are given by parts of LINEBUF_SZ bytes
+    int inlen = 0;
+    for(int i = 0; i < NSTR; ++i) inlen += lengths[i] + 1;
+    char *in = malloc(inlen), *exp = malloc(inlen), *out = malloc(inlen);
+    int *explen = malloc(inlen * sizeof(int)), nexp = 0, nout = 0, outpos = 0, bad = 0;
+    if(!in || !exp || !out || !explen){
+        perror("malloc()");
+        return 1;
+    }
+    char *p = in;
+    uint32_t r = 1;
+    for(int i = 0; i < NSTR; ++i){
+        int rest = lengths[i];
+        for(int j = 0; j < lengths[i]; ++j){
+            r = r * 1103515245u + 12345u;
+            *p++ = 'a' + (r >> 16) % 26;
+        }
+        *p++ = '\n';
+        for(; rest >= LINEBUF_SZ; rest -= LINEBUF_SZ) explen[nexp++] = LINEBUF_SZ;
+        explen[nexp++] = rest;
+    }
+    for(int i = 0, j = 0; i < inlen; ++i) if(in[i] != '\n') exp[j++] = in[i];
+    // feed buffer by random portions and get all strings after each
+    static linebuf lb;
+    char line[LINEBUF_SZ + 1];
+    for(int pos = 0; pos < inlen && nout <= nexp;){
+        int sz;
+        char *ptr = lb_space(&lb, &sz);
+        if(ptr){
+            r = r * 1103515245u + 12345u;
+            int n = 1 + (r >> 16) % 700;
+            if(n > sz) n = sz;
+            if(n > inlen - pos) n = inlen - pos;
+            memcpy(ptr, in + pos, n);
+            lb.len += n;
+            pos += n;
+        }
+        int l;
+        while(nout <= nexp && (l = lb_getline(&lb, line, sizeof(line))) > -1){
+            if(nout >= nexp || l != explen[nout]){
+                printf("String %d: length %d instead of %d\n", nout, l, nout < nexp ? explen[nout] : -1);
+                ++bad;
+            }
+            if(outpos + l <= inlen) memcpy(out + outpos, line, l);
+            outpos += l;
+            ++nout;
+        }
+    }
+    if(lb.len){
+        printf("%d bytes left in buffer\n", lb.len);
+        ++bad;
+    }
+    if(nout != nexp){
+        printf("Got %d strings instead of %d\n", nout, nexp);
+        ++bad;
+    }
+    if(outpos != inlen - NSTR || memcmp(out, exp, outpos)){
+        printf("Data differs (got %d bytes of %d)\n", outpos, inlen - NSTR);
+        ++bad;
+    }
+    printf("%s\n", bad ? "FAIL" : "OK");
+    free(in); free(exp); free(out); free(explen);
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the sslsosk project.
+ * Copyright 2023 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// input ring buffer splitted by '\n' (for commands from SSL connections)
+
+#include <string.h>
+
+#include "linebuf.h"
+
+/**
+ * @brief lb_space - get contiguous free space of ring buffer to write data in
+ * @param lb - line buffer
+ * @param sz (o) - size of space
+ * @return pointer to free space or NULL if buffer is full
+ * Written data should be added by `lb->len += written`
+ */
+char *lb_space(linebuf *lb, int *sz){
+    if(lb->len >= LINEBUF_SZ) return NULL;
+    int tail = (lb->head + lb->len) % LINEBUF_SZ;
+    *sz = (tail < lb->head) ? lb->head - tail : LINEBUF_SZ - tail;
+    return lb->buf + tail;
+}
+
+/**
+ * @brief lb_getline - get next '\n'-terminated string from ring buffer
+ * @param lb - line buffer
+ * @param line - buffer for string ('\n' replaced by 0)
+ * @param l - max `line` length (including zero), longer strings are truncated
+ *            (should be greater than LINEBUF_SZ to get each string or part of it whole)
+ * @return string length or -1 if there's no full string in buffer
+ * Overfull buffer without '\n' is returned as one string (its part if `l` isn't enough).
+ */
+int lb_getline(linebuf *lb, char *line, int l){
+    if(!lb || !line || l < 1) return -1;
+    int i = lb->checked, idx = (lb->head + i) % LINEBUF_SZ;
+    for(; i < lb->len; ++i){
+        if(lb->buf[idx] == '\n') break;
+        if(++idx == LINEBUF_SZ) idx = 0;
+    }
+    int nonl = (i == lb->len);
+    if(nonl && lb->len < LINEBUF_SZ){ // string not ready, don't check these bytes again
+        lb->checked = i;
+        return -1;
+    }
+    int n = (i < l) ? i : l - 1, part = LINEBUF_SZ - lb->head;
+    if(part > n) part = n;
+    memcpy(line, lb->buf + lb->head, part);
+    memcpy(line + part, lb->buf, n - part);
+    line[n] = 0;
+    if(nonl) i = n; // the rest of overfull buffer stays for next call
+    else ++i; // remove '\n' too
+    lb->len -= i;
+    lb->head = lb->len ? (lb->head + i) % LINEBUF_SZ : 0;
+    lb->checked = 0;
+    return n;
+}
@@ -16,19 +16,42 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <usefull_macros.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <usefull_macros.h>
+
+#include "cmdlnopts.h"
 #include "server.h"
+#ifdef __arm__
+#include "gpio.h"
+#endif
+
+// epoll data of non-client descriptors (clients have pointer to their conn_t)
+static char evtags[3];
+#define EV_LISTEN   ((void*)&evtags[0])
+#define EV_GPIO     ((void*)&evtags[1])
+#define EV_TIMER    ((void*)&evtags[2])
 
 static const char *maxcl = "Max client number reached, connect later\n";
 static const char *sslerr = "SSL error occured\n";
 
-// return 0 if client disconnected
-static int handle_connection(SSL *ssl){
-    char buf[1024];
-    int r = read_string(ssl, buf, 1024);
-    if(r < 0) return 0;
+// connections table: slabs of conn_t with list of free items and array of active connections
+static conn_t *freeconn = NULL;     // free connections
+static conn_t *closed = NULL;       // closed in current cycle (could have events in it)
+static conn_t **active = NULL;      // active connections
+static int nactive = 0, activesz = 0;
+// connections in handshake ordered by `tconn` (the oldest is the first to timeout)
+static conn_t *hshead = NULL, *hstail = NULL;
+static int epfd = -1;
+// handshakes statistics
+static hsstat hstat = {0};
+
+// run command `buf` (of size > LINEBUF_SZ) got from client and send answer
+static void handle_command(SSL *ssl, char *buf){
     int sd = SSL_get_fd(ssl);
     int l = 0;
     printf("Client %d msg: \"%s\"\n", sd, buf);
@@ -36,118 +59,325 @@ static int handle_connection(SSL *ssl){
 #ifdef __arm__
     const char *ans = "FAIL";
     if(handle_message(buf)) ans = "OK";
-    l = snprintf(buf, 1023, "%s\n", ans);
+    l = snprintf(buf, LINEBUF_SZ, "%s\n", ans);
 #else
-    l = snprintf(buf, 1023, "Hello, your FD=%d\n", sd);
+    l = snprintf(buf, LINEBUF_SZ, "Hello, your FD=%d\n", sd);
 #endif
     if(SSL_write(ssl, buf, l) <= 0) WARNX("SSL write error");
-    return 1;
+}
+
+// handle all commands got from client; return 0 if client disconnected
+static int handle_connection(conn_t *c){
+    char buf[LINEBUF_SZ + 1];
+    int r;
+    do{ // commands sent before disconnection are executed too
+        r = lb_fill(c->ssl, &c->lb);
+        while(lb_getline(&c->lb, buf, sizeof(buf)) > -1) handle_command(c->ssl, buf);
+    }while(r > 0);
+    return (r == 0);
 }
 
 /**
- * @brief timeouted_sslaccept - SSL_accept with timeout
- * @param ssl - SSL
- * @return 1 if connection ready or 0 if error
+ * @brief conn_new - get free connection from slab (allocate new slab if there's no free items)
+ * @return connection (with idx set and added to `active`) or NULL if limit reached
  */
-static int timeouted_sslaccept(SSL *ssl){
-    double t0 = dtime();
-    while(dtime() - t0 < ACCEPT_TIMEOUT){
-        int x = SSL_accept(ssl);
-        if(x < 0){
-            int sslerr = SSL_get_error(ssl, x);
-            if(SSL_ERROR_WANT_READ == sslerr ||
-                SSL_ERROR_WANT_WRITE == sslerr) continue;
-            DBG("SSL error %d", sslerr);
-            return FALSE;
+static conn_t *conn_new(){
+    if(nactive >= G.maxclients) return NULL;
+    if(!freeconn){
+        conn_t *slab = MALLOC(conn_t, CONN_SLAB); // never freed: connections are reused
+        for(int i = 0; i < CONN_SLAB; ++i){
+            slab[i].next = freeconn;
+            freeconn = &slab[i];
         }
-        else return TRUE;
+        DBG("New slab of %d connections", CONN_SLAB);
+    }
+    if(nactive == activesz){
+        activesz += CONN_SLAB;
+        active = realloc(active, activesz * sizeof(conn_t*));
+        if(!active) ERR("realloc()");
+    }
+    conn_t *c = freeconn;
+    freeconn = c->next;
+    c->idx = nactive;
+    active[nactive++] = c;
+    return c;
+}
+
+/**
+ * @brief conn_del - remove connection from active (move last active to its place)
+ * Connection returns to free list only after current epoll cycle: its events could be not processed yet
+ */
+static void conn_del(conn_t *c){
+    conn_t *last = active[--nactive];
+    active[c->idx] = last;
+    last->idx = c->idx;
+    c->ssl = NULL;
+    c->next = closed;
+    closed = c;
+}
+
+// return all closed connections to free list
+static void conn_release(){
+    while(closed){
+        conn_t *c = closed;
+        closed = c->next;
+        c->next = freeconn;
+        freeconn = c;
+    }
+}
+
+// add new connection to the end of handshakes list
+static void hs_add(conn_t *c){
+    c->hsnext = NULL;
+    c->hsprev = hstail;
+    if(hstail) hstail->hsnext = c;
+    else hshead = c;
+    hstail = c;
+}
+
+// remove connection from handshakes list
+static void hs_remove(conn_t *c){
+    if(c->hsprev) c->hsprev->hsnext = c->hsnext;
+    else hshead = c->hsnext;
+    if(c->hsnext) c->hsnext->hsprev = c->hsprev;
+    else hstail = c->hsprev;
+    c->hsprev = c->hsnext = NULL;
+}
+
+static void epoll_add(int fd, void *ptr){
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLPRI, .data.ptr = ptr};
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)){
+        LOGERR("epoll_ctl(): %s", strerror(errno));
+        ERR("epoll_ctl()");
+    }
+}
+
+// change events waited for client
+static void epoll_mod(conn_t *c){
+    uint32_t events = c->events ? c->events : EPOLLIN | EPOLLPRI;
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    if(epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev)) WARN("epoll_ctl()");
+}
+
+/**
+ * @brief timer_set - run one-shot timer
+ * @param tfd - timerfd
+ * @param tnext - time (by dtime()) when timer should fire or negative to stop timer
+ */
+static void timer_set(int tfd, double tnext){
+    struct itimerspec t = {0};
+    if(tnext > 0.){
+        double dt = tnext - dtime();
+        if(dt < 1e-3) dt = 1e-3; // zero value disarms timer
+        t.it_value.tv_sec = (time_t)dt;
+        t.it_value.tv_nsec = (long)((dt - t.it_value.tv_sec) * 1e9);
+    }
+    if(timerfd_settime(tfd, 0, &t, NULL)) WARN("timerfd_settime()");
+}
+
+static void client_close(conn_t *c){
+    if(c->events) hs_remove(c);
+    SSL_free(c->ssl);
+    DBG("Client fd=%d disconnected", c->fd);
+    LOGMSG("Client fd=%d disconnected", c->fd);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    conn_del(c);
+}
+
+static void hs_failed(conn_t *c){
+    LOGERR("SSL_accept() failed @ fd=%d", c->fd);
+    WARNX("SSL_accept()");
+    send(c->fd, sslerr, strlen(sslerr), MSG_NOSIGNAL);
+    client_close(c);
+}
+
+/**
+ * @brief handshake - next step of TLS handshake
+ * @param c - client
+ * @return FALSE if handshake failed
+ */
+static int handshake(conn_t *c){
+    int x = SSL_accept(c->ssl);
+    if(x == 1){
+        double dt = dtime() - c->tconn;
+        hs_remove(c);
+        c->events = 0;
+        epoll_mod(c);
+        if(hstat.done == 0 || dt < hstat.min) hstat.min = dt;
+        if(dt > hstat.max) hstat.max = dt;
+        hstat.sum += dt;
+        ++hstat.done;
+        int reused = SSL_session_reused(c->ssl);
+        if(reused) ++hstat.resumed;
+        DBG("fd=%d: %s handshake done in %.1fms", c->fd, reused ? "abbreviated" : "full", dt*1e3);
+        LOGMSG("fd=%d: %s handshake done in %.1fms (total: %u done, %u resumed, %u failed, %u timeouts; latency min/mean/max: %.1f/%.1f/%.1f ms)",
+               c->fd, reused ? "abbreviated" : "full", dt*1e3, hstat.done, hstat.resumed, hstat.failed, hstat.timeouts,
+               hstat.min*1e3, hstat.sum/hstat.done*1e3, hstat.max*1e3);
+        return TRUE;
+    }
+    uint32_t events;
+    int e = SSL_get_error(c->ssl, x);
+    if(e == SSL_ERROR_WANT_READ) events = EPOLLIN;
+    else if(e == SSL_ERROR_WANT_WRITE) events = EPOLLOUT;
+    else{
+        DBG("SSL error %d", e);
+        ++hstat.failed;
+        return FALSE;
+    }
+    if(events != c->events){
+        c->events = events;
+        epoll_mod(c);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief hs_timeouts - close clients with too long handshake
+ * @return time (by dtime()) of nearest handshake timeout or -1 if nobody in handshake
+ * ACCEPT_TIMEOUT is the same for all, so only the head of handshakes list can be expired
+ */
+static double hs_timeouts(){
+    double tnow = dtime();
+    while(hshead && hshead->tconn + ACCEPT_TIMEOUT <= tnow){
+        LOGWARN("fd=%d: handshake timeout", hshead->fd);
+        ++hstat.timeouts;
+        hs_failed(hshead); // removes it from list
+    }
+    return hshead ? hshead->tconn + ACCEPT_TIMEOUT : -1.;
+}
+
+// send message to all clients with finished handshake
+static void broadcast(const char *buf, int l){
+    for(int i = 0; i < nactive; ++i){
+        if(active[i]->events) continue; // handshake isn't done
+        if(SSL_write(active[i]->ssl, buf, l) <= 0) WARNX("SSL write error");
+    }
+}
+
+static void newclient(SSL_CTX *ctx, int fd){
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int client = accept4(fd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK);
+    if(client < 0){
+        if(errno == EMFILE || errno == ENFILE) LOGERR("accept4(): %s", strerror(errno));
+        if(errno != EAGAIN) WARN("accept4()");
+        return;
+    }
+    DBG("Connection: %s @ %d (fd=%d)\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), client);
+    LOGMSG("Client %s connected to port %d (fd=%d)", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), client);
+    conn_t *c = conn_new();
+    if(!c){
+        LOGWARN("Max amount of connections: disconnect fd=%d", client);
+        WARNX("Limit of connections reached");
+        send(client, maxcl, strlen(maxcl), MSG_NOSIGNAL);
+        close(client);
+        return;
     }
-    DBG("Timeout");
-    return FALSE;
+    c->ssl = SSL_new(ctx);
+    SSL_set_fd(c->ssl, client);
+    c->fd = client;
+    c->tconn = dtime();
+    c->events = EPOLLIN;
+    c->lb.head = c->lb.len = c->lb.checked = 0;
+    hs_add(c);
+    epoll_add(client, c);
+    DBG("nactive=%d, fd=%d: start handshake", nactive, client);
+    if(!handshake(c)) hs_failed(c);
 }
 
+// raise limit of open files if it's less than needed for G.maxclients
+static void chk_nofile(){
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl)) return;
+    rlim_t need = (rlim_t)G.maxclients + 32; // + log, GPIO, epoll etc
+    if(rl.rlim_cur >= need) return;
+    rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > need) ? need : rl.rlim_max;
+    if(setrlimit(RLIMIT_NOFILE, &rl)) WARN("setrlimit()");
+    if(rl.rlim_cur < need) LOGWARN("Max amount of open files (%lu) is less than needed for %d clients",
+                                   (unsigned long)rl.rlim_cur, G.maxclients);
+}
+
+/**
+ * @brief serverproc - main server loop
+ * @param ctx - SSL context
+ * @param fd - listening socket
+ * All descriptors (listening socket, clients, GPIO line events and timer) are watched by epoll,
+ * so server sleeps until something happens. TLS handshakes are made step by step by readiness
+ * events, so they never block established sessions.
+ */
 void serverproc(SSL_CTX *ctx, int fd){
     int enable = 1;
     if(ioctl(fd, FIONBIO, (void *)&enable) < 0){
         LOGERR("Can't make socket nonblocking");
         ERRX("ioctl()");
     }
-    int nfd = 1; // only one listening socket @start
-    struct pollfd poll_set[BACKLOG+1];
-    memset(poll_set, 0, sizeof(poll_set));
-    poll_set[0].fd = fd;
-    poll_set[0].events = POLLIN | POLLPRI;
-    SSL *ssls[BACKLOG+1] = {0}; // !!! start from 1 - like in poll_set !!!
-#ifndef __arm__
+    if(G.maxclients < 1) ERRX("maxclients should be positive");
+    chk_nofile();
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(epfd < 0){
+        LOGERR("Can't create epoll");
+        ERR("epoll_create1()");
+    }
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(tfd < 0){
+        LOGERR("Can't create timer");
+        ERR("timerfd_create()");
+    }
+    epoll_add(fd, EV_LISTEN);
+    epoll_add(tfd, EV_TIMER);
+#ifdef __arm__
+    epoll_add(gpio_event_fd(), EV_GPIO);
+#else
     double t0 = dtime(), tstart = t0;
     int P = 0;
 #endif
+    struct epoll_event events[EPOLL_MAXEVENTS];
     while(1){
-#ifdef __arm__
-        poll_gpio(ssls, nfd);
-#else
-        char buf[64];
-        if(dtime() - t0 > 5. && nfd > 1){ // broadcasting messages
-            //DBG("send ping");
-            int l = snprintf(buf, 63, "ping #%d; t=%g\n", ++P, dtime() - tstart);
-            for(int i = nfd-1; i > 0; --i){
-                DBG("send test to fd[%d]=%d", i, poll_set[i].fd);
-                if(SSL_write(ssls[i], buf, l) <= 0) WARNX("SSL write error");
-            }
-            t0 = dtime();
+        double tnext = hs_timeouts();
+        conn_release();
+#ifndef __arm__
+        double t = dtime();
+        if(t - t0 >= PING_INTERVAL){ // broadcasting messages
+            t0 = t;
+            char buf[64];
+            int l = snprintf(buf, 63, "ping #%d; t=%g\n", ++P, t - tstart);
+            broadcast(buf, l);
         }
+        if(tnext < 0. || t0 + PING_INTERVAL < tnext) tnext = t0 + PING_INTERVAL;
 #endif
-        poll(poll_set, nfd, 1); // max timeout - 1ms
-        // check for accept()
-        if(poll_set[0].revents & (POLLIN | POLLPRI)){
-            struct sockaddr_in addr;
-            socklen_t len = sizeof(addr);
-            int client = accept4(fd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK); // non-blocking for timeout of SSL_accept
-            DBG("Connection: %s @ %d (fd=%d)\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), client);
-            LOGMSG("Client %s connected to port %d (fd=%d)", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), client);
-            if(nfd == BACKLOG + 1){
-                LOGWARN("Max amount of connections: disconnect fd=%d", client);
-                WARNX("Limit of connections reached");
-                send(client, maxcl, sizeof(maxcl)-1, MSG_NOSIGNAL);
-                close(client);
-            }else{
-                DBG("New ssl");
-                SSL *ssl = SSL_new(ctx);
-                SSL_set_fd(ssl, client);
-                DBG("Accept");
-                if(timeouted_sslaccept(ssl)){
-                    DBG("OK");
-                    ssls[nfd] = ssl;
-                    bzero(&poll_set[nfd], sizeof(struct pollfd));
-                    poll_set[nfd].fd = client;
-                    poll_set[nfd].events = POLLIN | POLLPRI;
-                    DBG("nfd=%d, fd=%d, events=0x%x", nfd, poll_set[nfd].fd, poll_set[nfd].events);
-                    ++nfd;
-                }else{
-                    LOGERR("SSL_accept()");
-                    WARNX("SSL_accept()");
-                    SSL_free(ssl);
-                    send(client, sslerr, sizeof(sslerr)-1, MSG_NOSIGNAL);
-                    close(client);
-                }
-            }
+        timer_set(tfd, tnext);
+        int nev = epoll_wait(epfd, events, EPOLL_MAXEVENTS, -1);
+        if(nev < 0){
+            if(errno == EINTR) continue;
+            LOGERR("epoll_wait(): %s", strerror(errno));
+            ERR("epoll_wait()");
         }
-        // scan connections
-        for(int fdidx = 1; fdidx < nfd; ++fdidx){
-            if(poll_set[fdidx].revents) DBG("%d, revents=0x%x", fdidx, poll_set[fdidx].revents);
-            if((poll_set[fdidx].revents & (POLLIN | POLLPRI)) == 0) continue;
-            DBG("%d poll", fdidx);
-            int fd = poll_set[fdidx].fd;
-            if(!handle_connection(ssls[fdidx])){ // socket closed
-                SSL_free(ssls[fdidx]);
-                DBG("Client fd=%d disconnected", fd);
-                LOGMSG("Client fd=%d disconnected", fd);
-                close(fd);
-                if(--nfd > fdidx){ // move last FD to current position
-                    poll_set[fdidx] = poll_set[nfd];
-                    ssls[fdidx] = ssls[nfd];
-                }
+        for(int i = 0; i < nev; ++i){
+            void *id = events[i].data.ptr;
+            if(id == EV_LISTEN){
+                newclient(ctx, fd);
+                continue;
             }
+            if(id == EV_TIMER){ // all timer work is done in the beginning of cycle
+                uint64_t exp;
+                if(read(tfd, &exp, sizeof(exp)) < 0) DBG("timerfd read error");
+                continue;
+            }
+#ifdef __arm__
+            if(id == EV_GPIO){
+                char buf[64];
+                int l = gpio_message(buf, 64);
+                if(l > 0) broadcast(buf, l);
+                continue;
+            }
+#endif
+            conn_t *c = (conn_t*)id;
+            if(!c->ssl) continue; // already closed
+            DBG("fd=%d, events=0x%x", c->fd, events[i].events);
+            if(c->events){
+                if(!handshake(c)) hs_failed(c);
+            }else if(!handle_connection(c)) client_close(c); // socket closed
         }
     }
 }
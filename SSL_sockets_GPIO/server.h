@@ -18,9 +18,43 @@
 
 #pragma once
 
+#include <stdint.h>
 #include "sslsock.h"
 
 // timeout of SSL_accept (seconds)
 #define ACCEPT_TIMEOUT (10.)
+// lifetime of TLS sessions (tickets) for clients reconnection (seconds)
+#define SESSION_TIMEOUT (86400)
+// interval of test messages broadcasting (seconds)
+#define PING_INTERVAL  (5)
+
+// amount of connections allocated at once
+#define CONN_SLAB       (64)
+// max amount of events got by one epoll_wait()
+#define EPOLL_MAXEVENTS (64)
+
+// client connection (element of connections slab)
+typedef struct conn_t{
+    SSL *ssl;
+    int fd;
+    double tconn;           // time of connection
+    uint32_t events;        // epoll events waited by SSL_accept() or 0 if handshake is done
+    int idx;                // index in table of active connections
+    struct conn_t *hsprev;  // neighbours in list of connections in handshake
+    struct conn_t *hsnext;
+    linebuf lb;             // input data
+    struct conn_t *next;    // next free connection
+} conn_t;
+
+// statistics of TLS handshakes
+typedef struct{
+    uint32_t done;      // successful handshakes
+    uint32_t resumed;   // abbreviated handshakes (session resumption)
+    uint32_t failed;    // SSL_accept() errors
+    uint32_t timeouts;  // handshake longer than ACCEPT_TIMEOUT
+    double min;         // handshake latency: min, max and sum (for mean), seconds
+    double max;
+    double sum;
+} hsstat;
 
 void serverproc(SSL_CTX *ctx, int fd);
@@ -28,6 +28,8 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
+#include "linebuf.h"
+
 #if ! defined CLIENT && ! defined SERVER
 #error "Define CLIENT or SERVER before including this file"
 #endif
@@ -35,11 +37,21 @@
 #error "Both CLIENT and SERVER defined"
 #endif
 
-#define BACKLOG     10
+// default listen() backlog
+#define BACKLOG     (128)
+// default max amount of clients
+#define MAXCLIENTS  (256)
+
+// name of session ID context (resumption is possible only within the same context)
+#define SESSION_ID_CTX  "sslsosk"
 
 int open_socket();
-int read_string(SSL *ssl, char *buf, int l);
+#ifdef CLIENT
+void session_load(SSL *ssl);
+#endif
+int lb_fill(SSL *ssl, linebuf *lb);
 #ifdef __arm__
 int handle_message(const char *msg);
-void poll_gpio(SSL **ssls, int nfd);
+int gpio_message(char *buf, int l);
+void poll_gpio(SSL *ssl);
 #endif
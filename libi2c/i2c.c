@@ -0,0 +1,371 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "i2c.h"
+
+/*****************************************************************************
+                Device handle
+ *****************************************************************************/
+
+/**
+ * @brief i2cdev_open - open bus and create device on it
+ * @param path - full path to device or simulated bus ("sim:chip@addr,...")
+ * @param addr - 7-bit slave address
+ * @return device or NULL if failed
+ */
+i2cdev *i2cdev_open(const char *path, uint8_t addr){
+    if(addr > 0x7f){
+        WARNX("Wrong slave address 0x%02x", addr);
+        return NULL;
+    }
+    i2cbus *bus = i2cbus_open(path);
+    if(!bus) return NULL;
+    i2cdev *d = i2cdev_attach(bus, addr);
+    d->ownbus = 1;
+    return d;
+}
+
+/**
+ * @brief i2cdev_attach - create device on already opened bus (several devices can share one bus)
+ * @return device or NULL if failed
+ */
+i2cdev *i2cdev_attach(i2cbus *bus, uint8_t addr){
+    if(!bus || addr > 0x7f) return NULL;
+    i2cdev *d = MALLOC(i2cdev, 1);
+    d->bus = bus;
+    d->addr = addr;
+    return d;
+}
+
+void i2cdev_close(i2cdev *d){
+    if(!d) return;
+    if(d->ownbus) i2cbus_close(d->bus);
+    FREE(d);
+}
+
+int i2cdev_set_address(i2cdev *d, uint8_t addr){
+    if(!d || addr > 0x7f) return FALSE;
+    d->addr = addr;
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_read_reg8 - read 8-bit addressed register (8 bit)
+ * @param regaddr - register address
+ * @param data - data read (NULL to check presence of device)
+ * @return state
+ */
+int i2cdev_read_reg8(i2cdev *d, uint8_t regaddr, uint8_t *data){
+    if(!d) return FALSE;
+    uint8_t x;
+    if(!i2cbus_write_read(d->bus, d->addr, &regaddr, 1, &x, 1)){
+        WARN("i2c_read_reg8(0x%02x)", regaddr);
+        return FALSE;
+    }
+    if(data) *data = x;
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_write_reg8 - write to 8-bit addressed register
+ * @param regaddr - address
+ * @param data - data
+ * @return state
+ */
+int i2cdev_write_reg8(i2cdev *d, uint8_t regaddr, uint8_t data){
+    if(!d) return FALSE;
+    uint8_t b[2] = {regaddr, data};
+    if(!i2cbus_write(d->bus, d->addr, b, 2)){
+        WARN("i2c_write_reg8(0x%02x)", regaddr);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_read_data8 - read data from 8-bit addressed register (burst read with address auto-increment)
+ * @param regaddr - address
+ * @param N - amount of bytes
+ * @param array - data read
+ * @return state
+ */
+int i2cdev_read_data8(i2cdev *d, uint8_t regaddr, uint16_t N, uint8_t *array){
+    if(!d || N < 1 || N+regaddr > 0x100 || !array) return FALSE;
+    if(!i2cbus_write_read(d->bus, d->addr, &regaddr, 1, array, N)){
+        WARN("i2c_read_data8(0x%02x)", regaddr);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_read_reg16 - read 16-bit addressed register (to 16-bit data)
+ * @param regaddr - address
+ * @param data - data
+ * @return state
+ */
+int i2cdev_read_reg16(i2cdev *d, uint16_t regaddr, uint16_t *data){
+    if(!d) return FALSE;
+    uint8_t a[2] = {regaddr >> 8, regaddr & 0xff}, x[2] = {0};
+    if(!i2cbus_write_read(d->bus, d->addr, a, 2, x, 2)){
+        WARN("i2c_read_reg16(0x%04x)", regaddr);
+        return FALSE;
+    }
+    if(data) *data = (uint16_t)((x[0] << 8) | (x[1]));
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_write_reg16 - write 16-bit data value to 16-bit addressed register
+ * @param regaddr - address
+ * @param data - data to write
+ * @return state
+ */
+int i2cdev_write_reg16(i2cdev *d, uint16_t regaddr, uint16_t data){
+    if(!d) return FALSE;
+    uint8_t b[4] = {regaddr >> 8, regaddr & 0xff, data >> 8, data & 0xff};
+    if(!i2cbus_write(d->bus, d->addr, b, 4)){
+        WARN("i2c_write_reg16(0x%04x)", regaddr);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief i2cdev_read_data16 - read data from 16-bit addressed register
+ * @param regaddr - address
+ * @param N - amount of bytes
+ * @param array - data read
+ * @return state
+ */
+int i2cdev_read_data16(i2cdev *d, uint16_t regaddr, uint16_t N, uint8_t *array){
+    if(!d || N == 0 || !array) return FALSE;
+    uint8_t a[2] = {regaddr >> 8, regaddr & 0xff};
+    if(!i2cbus_write_read(d->bus, d->addr, a, 2, array, N)){
+        WARN("i2c_read_data16(0x%04x)", regaddr);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// read `N` bytes without register address (e.g. data of chip which NACKs while busy): don't warn
+int i2cdev_read_raw(i2cdev *d, uint8_t *data, uint16_t N){
+    if(!d || !data || N == 0) return FALSE;
+    return i2cbus_read(d->bus, d->addr, data, N);
+}
+
+// write `N` bytes (e.g. command)
+int i2cdev_write_raw(i2cdev *d, const uint8_t *data, uint16_t N){
+    if(!d || !data || N == 0) return FALSE;
+    return i2cbus_write(d->bus, d->addr, data, N);
+}
+
+/*****************************************************************************
+                Batched transactions
+ *****************************************************************************/
+
+// messages point into `b->buf`, so batch shouldn't be copied between adding and running
+void i2cbatch_init(i2cbatch *b, i2cdev *d){
+    if(!b) return;
+    b->dev = d;
+    b->nmsgs = 0;
+    b->buflen = 0;
+    b->overflow = 0;
+}
+
+// add message with external buffer `data`
+static int addmsg(i2cbatch *b, uint16_t flags, uint8_t *data, uint16_t len){
+    if(!b) return FALSE;
+    if(b->nmsgs == I2CBUS_MAXMSGS){
+        b->overflow = 1;
+        return FALSE;
+    }
+    struct i2c_msg *m = &b->msgs[b->nmsgs++];
+    m->addr = b->dev ? b->dev->addr : 0;
+    m->flags = flags;
+    m->len = len;
+    m->buf = data;
+    return TRUE;
+}
+
+// add write message with `len` bytes of `wr` copied into batch buffer
+static int addwrite(i2cbatch *b, const uint8_t *wr, uint16_t len){
+    if(!b) return FALSE;
+    if(b->buflen + len > I2CBATCH_BUFSZ){
+        b->overflow = 1;
+        return FALSE;
+    }
+    uint8_t *data = b->buf + b->buflen;
+    if(!addmsg(b, 0, data, len)) return FALSE;
+    memcpy(data, wr, len);
+    b->buflen += len;
+    return TRUE;
+}
+
+/**
+ * @brief i2cbatch_read8 - add burst read of `N` bytes starting from 8-bit addressed register
+ * @param array - buffer for data (filled by i2cbatch_run())
+ * @return FALSE if batch is full
+ */
+int i2cbatch_read8(i2cbatch *b, uint8_t regaddr, uint16_t N, uint8_t *array){
+    if(!array || N == 0) return FALSE;
+    if(!addwrite(b, &regaddr, 1)) return FALSE;
+    return addmsg(b, I2C_M_RD, array, N);
+}
+
+/**
+ * @brief i2cbatch_write8 - add write of `N` bytes starting from 8-bit addressed register
+ * @param data - data to write (copied into batch)
+ * @return FALSE if batch is full
+ */
+int i2cbatch_write8(i2cbatch *b, uint8_t regaddr, const uint8_t *data, uint16_t N){
+    if(!b || !data || N == 0 || b->buflen + N + 1 > I2CBATCH_BUFSZ){
+        if(b) b->overflow = 1;
+        return FALSE;
+    }
+    // register address and data should be in one message: put address first and append data to it
+    if(!addwrite(b, &regaddr, 1)) return FALSE;
+    memcpy(b->buf + b->buflen, data, N);
+    b->buflen += N;
+    b->msgs[b->nmsgs - 1].len += N;
+    return TRUE;
+}
+
+// add burst read from 16-bit addressed register
+int i2cbatch_read16(i2cbatch *b, uint16_t regaddr, uint16_t N, uint8_t *array){
+    if(!array || N == 0) return FALSE;
+    uint8_t a[2] = {regaddr >> 8, regaddr & 0xff};
+    if(!addwrite(b, a, 2)) return FALSE;
+    return addmsg(b, I2C_M_RD, array, N);
+}
+
+// add write of 16-bit data to 16-bit addressed register
+int i2cbatch_write16(i2cbatch *b, uint16_t regaddr, uint16_t data){
+    uint8_t a[4] = {regaddr >> 8, regaddr & 0xff, data >> 8, data & 0xff};
+    return addwrite(b, a, 4);
+}
+
+// add read of `N` bytes without register address
+int i2cbatch_read_raw(i2cbatch *b, uint8_t *data, uint16_t N){
+    if(!data || N == 0) return FALSE;
+    return addmsg(b, I2C_M_RD, data, N);
+}
+
+/**
+ * @brief i2cbatch_run - run all messages of batch by one transfer (single syscall on i2c-dev)
+ *        and clear batch for next use
+ * @return state
+ */
+int i2cbatch_run(i2cbatch *b){
+    if(!b || !b->dev) return FALSE;
+    int ret = FALSE;
+    if(b->overflow){
+        WARNX("I2C batch overflow");
+        errno = ENOBUFS;
+    }else if(b->nmsgs && !i2cbus_plain(b->dev->bus)){
+        WARNX("%s: I2C batches need plain I2C transfers, but adapter supports only SMBus", b->dev->bus->path);
+        errno = EOPNOTSUPP;
+    }else if(b->nmsgs) ret = i2cbus_transfer(b->dev->bus, b->msgs, b->nmsgs);
+    else ret = TRUE;
+    i2cbatch_init(b, b->dev);
+    return ret;
+}
+
+/*****************************************************************************
+                Default device
+ *****************************************************************************/
+
+static i2cdev *I2Cdev = NULL;
+static int ownI2Cdev = 0; // I2Cdev was opened by i2c_open()
+
+/**
+ * @brief i2c_open - open default I2C device (slave address should be set later)
+ * @param path - full path to device or simulated bus ("sim:chip@addr,...")
+ * @return state
+ */
+int i2c_open(const char *path){
+    i2c_close();
+    I2Cdev = i2cdev_open(path, 0);
+    if(!I2Cdev) return FALSE;
+    ownI2Cdev = 1;
+    return TRUE;
+}
+
+void i2c_close(){
+    if(ownI2Cdev) i2cdev_close(I2Cdev);
+    I2Cdev = NULL;
+    ownI2Cdev = 0;
+}
+
+i2cdev *i2c_getdev(){
+    return I2Cdev;
+}
+
+/**
+ * @brief i2c_setdev - make `d` default device (e.g. to run several single device drivers in one program)
+ *        default device set by this function isn't closed by i2c_close()
+ * @return previous default device
+ */
+i2cdev *i2c_setdev(i2cdev *d){
+    i2cdev *old = I2Cdev;
+    I2Cdev = d;
+    ownI2Cdev = 0;
+    return old;
+}
+
+int i2c_set_slave_address(uint8_t addr){
+    return i2cdev_set_address(I2Cdev, addr);
+}
+
+int i2c_read_reg8(uint8_t regaddr, uint8_t *data){
+    return i2cdev_read_reg8(I2Cdev, regaddr, data);
+}
+
+int i2c_write_reg8(uint8_t regaddr, uint8_t data){
+    return i2cdev_write_reg8(I2Cdev, regaddr, data);
+}
+
+int i2c_read_data8(uint8_t regaddr, uint16_t N, uint8_t *array){
+    return i2cdev_read_data8(I2Cdev, regaddr, N, array);
+}
+
+int i2c_read_reg16(uint16_t regaddr, uint16_t *data){
+    return i2cdev_read_reg16(I2Cdev, regaddr, data);
+}
+
+int i2c_write_reg16(uint16_t regaddr, uint16_t data){
+    return i2cdev_write_reg16(I2Cdev, regaddr, data);
+}
+
+int i2c_read_data16(uint16_t regaddr, uint16_t N, uint8_t *array){
+    return i2cdev_read_data16(I2Cdev, regaddr, N, array);
+}
+
+int i2c_read_raw(uint8_t *data, uint16_t N){
+    return i2cdev_read_raw(I2Cdev, data, N);
+}
+
+int i2c_write_raw(const uint8_t *data, uint16_t N){
+    return i2cdev_write_raw(I2Cdev, data, N);
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "i2cbus.h"
+
+// slave device on bus: all register functions work with its address
+typedef struct{
+    i2cbus *bus;
+    uint8_t addr;
+    uint8_t ownbus;             // bus was opened by i2cdev_open() and will be closed with device
+} i2cdev;
+
+i2cdev *i2cdev_open(const char *path, uint8_t addr);
+i2cdev *i2cdev_attach(i2cbus *bus, uint8_t addr);
+void i2cdev_close(i2cdev *d);
+int i2cdev_set_address(i2cdev *d, uint8_t addr);
+int i2cdev_read_reg8(i2cdev *d, uint8_t regaddr, uint8_t *data);
+int i2cdev_write_reg8(i2cdev *d, uint8_t regaddr, uint8_t data);
+int i2cdev_read_data8(i2cdev *d, uint8_t regaddr, uint16_t N, uint8_t *array);
+int i2cdev_read_reg16(i2cdev *d, uint16_t regaddr, uint16_t *data);
+int i2cdev_write_reg16(i2cdev *d, uint16_t regaddr, uint16_t data);
+int i2cdev_read_data16(i2cdev *d, uint16_t regaddr, uint16_t N, uint8_t *array);
+int i2cdev_read_raw(i2cdev *d, uint8_t *data, uint16_t N);
+int i2cdev_write_raw(i2cdev *d, const uint8_t *data, uint16_t N);
+
+// size of batch buffer for register addresses and data to write
+#define I2CBATCH_BUFSZ      (128)
+
+// several register reads/writes of one device packed into single I2C_RDWR transfer:
+// i2cbatch_init(), then i2cbatch_read8()/write8()/..., then i2cbatch_run() fills all read buffers
+typedef struct{
+    i2cdev *dev;
+    int nmsgs;                          // amount of messages
+    int buflen;                         // used part of `buf`
+    int overflow;                       // too much messages or data -> run fails
+    struct i2c_msg msgs[I2CBUS_MAXMSGS];
+    uint8_t buf[I2CBATCH_BUFSZ];
+} i2cbatch;
+
+void i2cbatch_init(i2cbatch *b, i2cdev *d);
+int i2cbatch_read8(i2cbatch *b, uint8_t regaddr, uint16_t N, uint8_t *array);
+int i2cbatch_write8(i2cbatch *b, uint8_t regaddr, const uint8_t *data, uint16_t N);
+int i2cbatch_read16(i2cbatch *b, uint16_t regaddr, uint16_t N, uint8_t *array);
+int i2cbatch_write16(i2cbatch *b, uint16_t regaddr, uint16_t data);
+int i2cbatch_read_raw(i2cbatch *b, uint8_t *data, uint16_t N);
+int i2cbatch_run(i2cbatch *b);
+
+// single device programs: functions of default device opened by i2c_open()
+int i2c_open(const char *path);
+void i2c_close();
+i2cdev *i2c_getdev();
+i2cdev *i2c_setdev(i2cdev *d);
+int i2c_set_slave_address(uint8_t addr);
+int i2c_read_reg8(uint8_t regaddr, uint8_t *data);
+int i2c_write_reg8(uint8_t regaddr, uint8_t data);
+int i2c_read_data8(uint8_t regaddr, uint16_t N, uint8_t *array);
+int i2c_read_reg16(uint16_t regaddr, uint16_t *data);
+int i2c_write_reg16(uint16_t regaddr, uint16_t data);
+int i2c_read_data16(uint16_t regaddr, uint16_t N, uint8_t *array);
+int i2c_read_raw(uint8_t *data, uint16_t N);
+int i2c_write_raw(const uint8_t *data, uint16_t N);
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <usefull_macros.h>
+#include <linux/i2c-dev.h>
+
+#include "i2cbus.h"
+
+/*****************************************************************************
+                Linux i2c-dev transport
+ *****************************************************************************/
+
+static int linux_open(i2cbus *b, const char *path){
+    int fd = open(path, O_RDWR);
+    if(fd < 0){
+        WARN("Can't open %s", path);
+        return FALSE;
+    }
+    b->priv = (void*)(intptr_t)fd;
+    if(ioctl(fd, I2C_FUNCS, &b->funcs) < 0){
+        WARN("%s: can't get adapter functionality, assume plain I2C", path);
+        b->funcs = I2C_FUNC_I2C;
+    }
+    if(!(b->funcs & I2C_FUNC_I2C))
+        WARNX("%s: SMBus-only adapter, transfers besides single register access aren't supported", path);
+    return TRUE;
+}
+
+static void linux_close(i2cbus *b){
+    close((int)(intptr_t)b->priv);
+}
+
+// all transfers are done by I2C_RDWR with explicit slave address, so file descriptor can be shared
+static int linux_transfer(i2cbus *b, struct i2c_msg *msgs, int n){
+    struct i2c_rdwr_ioctl_data x = {.msgs = msgs, .nmsgs = n};
+    if(ioctl((int)(intptr_t)b->priv, I2C_RDWR, &x) < 0) return FALSE;
+    return TRUE;
+}
+
+// SMBus adapters need slave address set for file descriptor before each command
+static int linux_smbus(i2cbus *b, uint8_t addr, uint8_t rw, uint8_t cmd, int size, union i2c_smbus_data *data){
+    int fd = (int)(intptr_t)b->priv;
+    struct i2c_smbus_ioctl_data x = {.read_write = rw, .command = cmd, .size = size, .data = data};
+    if(ioctl(fd, I2C_SLAVE, addr) < 0 || ioctl(fd, I2C_SMBUS, &x) < 0) return FALSE;
+    return TRUE;
+}
+
+const i2cbus_ops i2cbus_linux = {
+    .name = "i2c-dev",
+    .open = linux_open,
+    .close = linux_close,
+    .transfer = linux_transfer,
+    .smbus = linux_smbus
+};
+
+/*****************************************************************************
+                Common
+ *****************************************************************************/
+
+/**
+ * @brief i2cbus_open - open I2C bus
+ * @param path - device path (/dev/i2c-N) or simulated bus description (I2CBUS_SIM_PREFIX...)
+ * @return bus handle or NULL if failed
+ */
+i2cbus *i2cbus_open(const char *path){
+    if(!path) return NULL;
+    const i2cbus_ops *ops = &i2cbus_linux;
+    if(strncmp(path, I2CBUS_SIM_PREFIX, sizeof(I2CBUS_SIM_PREFIX) - 1) == 0) ops = &i2cbus_sim;
+    i2cbus *b = MALLOC(i2cbus, 1);
+    b->ops = ops;
+    b->path = strdup(path);
+    if(!ops->open(b, path)){
+        FREE(b->path);
+        FREE(b);
+        return NULL;
+    }
+    DBG("Opened %s by %s transport", path, ops->name);
+    return b;
+}
+
+void i2cbus_close(i2cbus *b){
+    if(!b) return;
+    b->ops->close(b);
+    FREE(b->path);
+    FREE(b);
+}
+
+// @return TRUE if adapter supports plain I2C transfers (I2C_RDWR) of any messages
+int i2cbus_plain(i2cbus *b){
+    return b && (b->funcs & I2C_FUNC_I2C);
+}
+
+/**
+ * @brief smbus_transfer - run transfer by SMBus command (adapters without I2C_FUNC_I2C)
+ * Only transfers with the same bus waveform are supported: send/receive byte, write of register address
+ * and 1..I2C_SMBUS_BLOCK_MAX bytes, read of 1..I2C_SMBUS_BLOCK_MAX bytes after register address.
+ * @return FALSE if failed (errno is EOPNOTSUPP for other transfers)
+ */
+static int smbus_transfer(i2cbus *b, struct i2c_msg *msgs, int n){
+    union i2c_smbus_data data;
+    struct i2c_msg *m = msgs;
+    uint8_t rw = I2C_SMBUS_WRITE, cmd = 0;
+    int size = -1;
+    unsigned long need = 0;
+    if(n == 1 && !(m->flags & I2C_M_RD)){
+        if(m->len) cmd = m->buf[0];
+        if(m->len == 1){
+            size = I2C_SMBUS_BYTE; need = I2C_FUNC_SMBUS_WRITE_BYTE;
+        }else if(m->len == 2){
+            size = I2C_SMBUS_BYTE_DATA; need = I2C_FUNC_SMBUS_WRITE_BYTE_DATA;
+            data.byte = m->buf[1];
+        }else if(m->len > 2 && m->len <= I2C_SMBUS_BLOCK_MAX + 1){
+            size = I2C_SMBUS_I2C_BLOCK_DATA; need = I2C_FUNC_SMBUS_WRITE_I2C_BLOCK;
+            data.block[0] = (uint8_t)(m->len - 1);
+            memcpy(data.block + 1, m->buf + 1, m->len - 1);
+        }
+    }else if(n == 1){
+        rw = I2C_SMBUS_READ;
+        if(m->len == 1){
+            size = I2C_SMBUS_BYTE; need = I2C_FUNC_SMBUS_READ_BYTE;
+        }
+    }else if(n == 2 && !(m[0].flags & I2C_M_RD) && m[0].len == 1 && (m[1].flags & I2C_M_RD) && m[0].addr == m[1].addr){
+        rw = I2C_SMBUS_READ;
+        cmd = m[0].buf[0];
+        if(m[1].len == 1){
+            size = I2C_SMBUS_BYTE_DATA; need = I2C_FUNC_SMBUS_READ_BYTE_DATA;
+        }else if(m[1].len > 1 && m[1].len <= I2C_SMBUS_BLOCK_MAX){
+            size = I2C_SMBUS_I2C_BLOCK_DATA; need = I2C_FUNC_SMBUS_READ_I2C_BLOCK;
+            data.block[0] = (uint8_t)m[1].len;
+        }
+    }
+    if(size < 0 || (b->funcs & need) != need || !b->ops->smbus){
+        DBG("%s: transfer isn't supported by SMBus adapter", b->path);
+        errno = EOPNOTSUPP;
+        return FALSE;
+    }
+    if(!b->ops->smbus(b, m->addr, rw, cmd, size, &data)) return FALSE;
+    if(rw == I2C_SMBUS_READ){
+        struct i2c_msg *r = &msgs[n-1];
+        if(size == I2C_SMBUS_I2C_BLOCK_DATA) memcpy(r->buf, data.block + 1, r->len);
+        else r->buf[0] = data.byte;
+    }
+    return TRUE;
+}
+
+/**
+ * @brief i2cbus_transfer - run `n` messages in one transaction (repeated start between messages)
+ * @return FALSE if failed (errno is set)
+ * On SMBus-only adapters only single register access is available (see `smbus_transfer`)
+ */
+int i2cbus_transfer(i2cbus *b, struct i2c_msg *msgs, int n){
+    if(!b || !msgs || n < 1 || n > I2CBUS_MAXMSGS){
+        errno = EINVAL;
+        return FALSE;
+    }
+    ++b->stat.transfers;
+    b->stat.msgs += n;
+    for(int i = 0; i < n; ++i) b->stat.bytes += msgs[i].len;
+    if(i2cbus_plain(b) ? b->ops->transfer(b, msgs, n) : smbus_transfer(b, msgs, n)) return TRUE;
+    ++b->stat.errors;
+    return FALSE;
+}
+
+// write `len` bytes to slave `addr`
+int i2cbus_write(i2cbus *b, uint8_t addr, const uint8_t *data, uint16_t len){
+    struct i2c_msg m = {.addr = addr, .flags = 0, .len = len, .buf = (uint8_t*)data};
+    return i2cbus_transfer(b, &m, 1);
+}
+
+// read `len` bytes from slave `addr` (without register address)
+int i2cbus_read(i2cbus *b, uint8_t addr, uint8_t *data, uint16_t len){
+    struct i2c_msg m = {.addr = addr, .flags = I2C_M_RD, .len = len, .buf = data};
+    return i2cbus_transfer(b, &m, 1);
+}
+
+// write `wlen` bytes (e.g. register address) and read `rlen` bytes after repeated start
+int i2cbus_write_read(i2cbus *b, uint8_t addr, const uint8_t *wr, uint16_t wlen, uint8_t *rd, uint16_t rlen){
+    struct i2c_msg m[2] = {
+        {.addr = addr, .flags = 0, .len = wlen, .buf = (uint8_t*)wr},
+        {.addr = addr, .flags = I2C_M_RD, .len = rlen, .buf = rd}
+    };
+    return i2cbus_transfer(b, m, 2);
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <linux/i2c.h>
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+// prefix of simulated bus path: "sim:chip[@addr][,chip[@addr]...]", e.g. "sim:bme280@76,htu21d"
+#define I2CBUS_SIM_PREFIX   "sim:"
+// max messages in one transfer (the same as I2C_RDWR_IOCTL_MAX_MSGS)
+#define I2CBUS_MAXMSGS      (42)
+
+typedef struct i2cbus i2cbus;
+
+// transport: each transfer is a sequence of messages with repeated start between them (I2C_RDWR semantic)
+typedef struct{
+    const char *name;
+    int (*open)(i2cbus *b, const char *path);                   // open bus, fill `b->priv` and `b->funcs`
+    void (*close)(i2cbus *b);
+    int (*transfer)(i2cbus *b, struct i2c_msg *msgs, int n);   // FALSE if failed (errno is set)
+    // single SMBus command (I2C_SMBUS semantic) for adapters without I2C_FUNC_I2C, FALSE if failed
+    int (*smbus)(i2cbus *b, uint8_t addr, uint8_t rw, uint8_t cmd, int size, union i2c_smbus_data *data);
+} i2cbus_ops;
+
+// bus statistics
+typedef struct{
+    uint64_t transfers;         // calls of transport `transfer`
+    uint64_t msgs;              // messages
+    uint64_t bytes;             // data bytes (without addresses)
+    uint64_t errors;            // failed transfers
+} i2cbus_stat;
+
+struct i2cbus{
+    const i2cbus_ops *ops;
+    char *path;
+    void *priv;                 // transport private data
+    unsigned long funcs;        // adapter functionality (I2C_FUNC_*)
+    i2cbus_stat stat;
+};
+
+extern const i2cbus_ops i2cbus_linux;
+extern const i2cbus_ops i2cbus_sim;
+
+i2cbus *i2cbus_open(const char *path);
+void i2cbus_close(i2cbus *b);
+int i2cbus_plain(i2cbus *b);
+int i2cbus_transfer(i2cbus *b, struct i2c_msg *msgs, int n);
+int i2cbus_write(i2cbus *b, uint8_t addr, const uint8_t *data, uint16_t len);
+int i2cbus_read(i2cbus *b, uint8_t addr, uint8_t *data, uint16_t len);
+int i2cbus_write_read(i2cbus *b, uint8_t addr, const uint8_t *wr, uint16_t wlen, uint8_t *rd, uint16_t rlen);
@@ -0,0 +1,192 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// simulated I2C bus: chips with register maps and conversion delays, for tests and benchmarks without hardware
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "i2csim.h"
+
+// all known models
+static const simchip_model *models[] = {
+    &sim_bmp180, &sim_bmp280, &sim_bme280, &sim_si7005, &sim_htu21d, &sim_as3935, &sim_mlx90640, NULL
+};
+
+typedef struct{
+    simchip *chips;
+    pthread_mutex_t mutex;      // transfers are atomic as on real adapter
+} simbus;
+
+int simregs_write(simchip *c, const uint8_t *buf, uint16_t len){
+    simregs *r = (simregs*)c->state;
+    if(len == 0) return TRUE;
+    r->ptr = *buf++;
+    while(--len){
+        if(r->onwrite) r->onwrite(c, r->ptr, *buf);
+        else r->reg[r->ptr] = *buf;
+        ++buf; ++r->ptr;
+    }
+    return TRUE;
+}
+
+int simregs_read(simchip *c, uint8_t *buf, uint16_t len){
+    simregs *r = (simregs*)c->state;
+    while(len--){
+        if(r->onread) r->onread(c, r->ptr);
+        *buf++ = r->reg[r->ptr++];
+    }
+    return TRUE;
+}
+
+void simregs_free(simchip *c){
+    FREE(c->state);
+}
+
+static void freechips(simchip *c){
+    while(c){
+        simchip *nxt = c->next;
+        if(c->state) c->model->free(c);
+        FREE(c);
+        c = nxt;
+    }
+}
+
+// add chip described as "name[@hexaddr]"
+static int addchip(simbus *s, const char *descr){
+    char name[32];
+    const char *at = strchr(descr, '@');
+    size_t l = at ? (size_t)(at - descr) : strlen(descr);
+    if(l == 0 || l >= sizeof(name)){
+        WARNX("Wrong simulated chip: %s", descr);
+        return FALSE;
+    }
+    memcpy(name, descr, l);
+    name[l] = 0;
+    const simchip_model **m = models;
+    while(*m && strcasecmp((*m)->name, name)) ++m;
+    if(!*m){
+        WARNX("Unknown simulated chip %s; available:", name);
+        for(m = models; *m; ++m) fprintf(stderr, "\t%s (0x%02x)\n", (*m)->name, (*m)->addr);
+        return FALSE;
+    }
+    long addr = (*m)->addr;
+    if(at){
+        char *eptr;
+        addr = strtol(at + 1, &eptr, 16);
+        if(*eptr || eptr == at + 1 || addr < 1 || addr > 0x7f){
+            WARNX("Wrong I2C address of %s: %s", name, at + 1);
+            return FALSE;
+        }
+    }
+    for(simchip *c = s->chips; c; c = c->next) if(c->addr == addr){
+        WARNX("Address 0x%02lx of %s is busy by %s", addr, name, c->model->name);
+        return FALSE;
+    }
+    simchip *c = MALLOC(simchip, 1);
+    c->model = *m;
+    c->addr = (uint8_t)addr;
+    c->next = s->chips;
+    s->chips = c;
+    if(!c->model->init(c)){
+        WARNX("Can't init simulated %s", name);
+        return FALSE;
+    }
+    DBG("Simulated %s @ 0x%02x", name, c->addr);
+    return TRUE;
+}
+
+// pseudo-chip making simulated adapter SMBus-only
+#define SIM_SMBUS_ONLY  "smbus"
+
+static int sim_open(i2cbus *b, const char *path){
+    simbus *s = MALLOC(simbus, 1);
+    char *descr = strdup(path + sizeof(I2CBUS_SIM_PREFIX) - 1), *saveptr = NULL;
+    int ok = TRUE;
+    b->funcs = I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+    for(char *tok = strtok_r(descr, ",", &saveptr); tok && ok; tok = strtok_r(NULL, ",", &saveptr)){
+        if(strcasecmp(tok, SIM_SMBUS_ONLY) == 0) b->funcs = I2C_FUNC_SMBUS_EMUL;
+        else ok = addchip(s, tok);
+    }
+    FREE(descr);
+    if(!ok || !s->chips){
+        if(ok) WARNX("No chips on simulated bus %s", path);
+        freechips(s->chips);
+        FREE(s);
+        return FALSE;
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+    b->priv = s;
+    return TRUE;
+}
+
+static void sim_close(i2cbus *b){
+    simbus *s = (simbus*)b->priv;
+    freechips(s->chips);
+    pthread_mutex_destroy(&s->mutex);
+    FREE(b->priv);
+}
+
+static int sim_transfer(i2cbus *b, struct i2c_msg *msgs, int n){
+    simbus *s = (simbus*)b->priv;
+    int ret = TRUE;
+    pthread_mutex_lock(&s->mutex);
+    for(int i = 0; i < n && ret; ++i){
+        simchip *c = s->chips;
+        while(c && c->addr != msgs[i].addr) c = c->next;
+        if(!c) ret = FALSE;
+        else if(msgs[i].flags & I2C_M_RD) ret = c->model->read(c, msgs[i].buf, msgs[i].len);
+        else ret = c->model->write(c, msgs[i].buf, msgs[i].len);
+    }
+    for(simchip *c = s->chips; c; c = c->next) if(c->model->stop) c->model->stop(c);
+    pthread_mutex_unlock(&s->mutex);
+    if(!ret) errno = ENXIO; // NACK
+    return ret;
+}
+
+// SMBus command by messages with the same waveform
+static int sim_smbus(i2cbus *b, uint8_t addr, uint8_t rw, uint8_t cmd, int size, union i2c_smbus_data *data){
+    uint8_t wr[I2C_SMBUS_BLOCK_MAX + 1] = {cmd};
+    struct i2c_msg m[2] = {{.addr = addr, .flags = 0, .len = 1, .buf = wr}, {.addr = addr, .flags = I2C_M_RD}};
+    int n = 1;
+    if(rw == I2C_SMBUS_WRITE){
+        if(size == I2C_SMBUS_BYTE_DATA){
+            wr[1] = data->byte; m[0].len = 2;
+        }else if(size == I2C_SMBUS_I2C_BLOCK_DATA){
+            memcpy(wr + 1, data->block + 1, data->block[0]); m[0].len = 1 + data->block[0];
+        }
+    }else if(size == I2C_SMBUS_BYTE){
+        m[0] = m[1]; m[0].len = 1; m[0].buf = &data->byte;
+    }else{
+        n = 2;
+        m[1].len = (size == I2C_SMBUS_I2C_BLOCK_DATA) ? data->block[0] : 1;
+        m[1].buf = (size == I2C_SMBUS_I2C_BLOCK_DATA) ? data->block + 1 : &data->byte;
+    }
+    return sim_transfer(b, m, n);
+}
+
+const i2cbus_ops i2cbus_sim = {
+    .name = "simulator",
+    .open = sim_open,
+    .close = sim_close,
+    .transfer = sim_transfer,
+    .smbus = sim_smbus
+};
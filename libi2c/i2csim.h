@@ -0,0 +1,64 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "i2cbus.h"
+
+typedef struct simchip simchip;
+
+// model of simulated chip; `write`/`read` get data of one message and return FALSE for NACK
+typedef struct{
+    const char *name;
+    uint8_t addr;                                               // default slave address
+    int (*init)(simchip *c);                                    // allocate `c->state`, set power-on state
+    void (*free)(simchip *c);
+    int (*write)(simchip *c, const uint8_t *buf, uint16_t len);
+    int (*read)(simchip *c, uint8_t *buf, uint16_t len);
+    void (*stop)(simchip *c);                                   // STOP condition (may be NULL)
+} simchip_model;
+
+struct simchip{
+    const simchip_model *model;
+    uint8_t addr;
+    void *state;
+    simchip *next;
+};
+
+// 8-bit register map with auto-increment of register pointer (the first byte of each write)
+typedef struct{
+    uint8_t reg[256];
+    uint8_t ptr;
+    void (*onwrite)(simchip *c, uint8_t reg, uint8_t val);     // store `val` instead of plain writing
+    void (*onread)(simchip *c, uint8_t reg);                    // update `reg` before reading
+} simregs;
+
+// chip state for register map models should begin with `simregs`
+int simregs_write(simchip *c, const uint8_t *buf, uint16_t len);
+int simregs_read(simchip *c, uint8_t *buf, uint16_t len);
+void simregs_free(simchip *c);
+
+// noise of simulated values: uniform in [-amp, amp]
+static inline int sim_noise(uint32_t *seed, int amp){
+    *seed = *seed * 1103515245u + 12345u;
+    return (int)((*seed >> 16) % (uint32_t)(2 * amp + 1)) - amp;
+}
+
+extern const simchip_model sim_bmp180, sim_bmp280, sim_bme280, sim_si7005, sim_htu21d, sim_as3935, sim_mlx90640;
@@ -0,0 +1,5 @@
+# I2C transport (Linux i2c-dev or simulator) shared by sensor programs:
+# `include` this file, add $(I2CSRCS) to sources and -I$(I2CDIR) to defines
+I2CDIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+I2CSRCS := i2c.c i2cbus.c i2csim.c sim_bmp.c sim_sihtu.c sim_as3935.c sim_mlx90640.c
+vpath %.c $(I2CDIR)
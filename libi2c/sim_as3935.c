@@ -0,0 +1,152 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// simulated AS3935 lightning sensor: register map, RCO calibration and random lightnings/disturbers
+
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "i2csim.h"
+
+#define AS3935_AFE_GAIN     (0x00)
+#define AS3935_LIGHTNING    (0x02)
+#define AS3935_INT_MASK_ANT (0x03)
+#define AS3935_S_LIG_L      (0x04)
+#define AS3935_S_LIG_M      (0x05)
+#define AS3935_S_LIG_MM     (0x06)
+#define AS3935_DISTANCE     (0x07)
+#define AS3935_CALIB_TRCO   (0x3A)
+#define AS3935_CALIB_SRCO   (0x3B)
+#define AS3935_PRESET       (0x3C)
+#define AS3935_CALIB_RCO    (0x3D)
+#define AS3935_DIRECT_CMD   (0x96)
+#define AS3935_AFE_PWD      (1<<0)
+#define AS3935_MASK_DIST    (1<<5)
+#define AS3935_INT_MASK     (0x0f)
+#define AS3935_INT_D        (4)
+#define AS3935_INT_L        (8)
+#define AS3935_CALIB_DONE   (1<<7)
+// RCO calibration time, s
+#define AS3935_TCALIB       (0.002)
+// mean interval between events, s
+#define AS3935_EVT_INTERVAL (10.)
+
+// power-on values of registers 0..8
+static const uint8_t as3935_defaults[9] = {0x24, 0x22, 0xC2, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x00};
+// possible distances, km
+static const uint8_t as3935_dist[] = {1, 5, 6, 8, 10, 12, 14, 17, 20, 24, 27, 31, 34, 37, 40, 0x3F};
+
+typedef struct{
+    simregs r;
+    double tcalib;          // end of RCO calibration
+    int calib;
+    double tevent;          // time of next event
+    int intread;            // INT_MASK_ANT was read in current transfer
+    uint32_t seed;
+} as3935_state;
+
+static void as3935_preset(as3935_state *s){
+    memset(s->r.reg, 0, sizeof(s->r.reg));
+    memcpy(s->r.reg, as3935_defaults, sizeof(as3935_defaults));
+}
+
+static void as3935_nextevent(as3935_state *s, double now){
+    s->tevent = now + AS3935_EVT_INTERVAL * (1. + sim_noise(&s->seed, 500) / 1000.);
+}
+
+// generate events while sensor is powered up, finish calibration
+static void as3935_update(simchip *c, uint8_t reg){
+    as3935_state *s = (as3935_state*)c->state;
+    uint8_t *r = s->r.reg;
+    double now = dtime();
+    if(s->calib && now >= s->tcalib){
+        r[AS3935_CALIB_TRCO] = r[AS3935_CALIB_SRCO] = AS3935_CALIB_DONE;
+        s->calib = 0;
+    }
+    if(r[AS3935_AFE_GAIN] & AS3935_AFE_PWD) s->tevent = 0.;
+    else if(s->tevent == 0.) as3935_nextevent(s, now);
+    else if(now >= s->tevent){
+        as3935_nextevent(s, now);
+        if(sim_noise(&s->seed, 5) > -5){ // lightning; 1/11 of events are disturbers
+            uint32_t E = (uint32_t)(sim_noise(&s->seed, 0xfffff) + 0x100000);
+            r[AS3935_S_LIG_L] = E & 0xff;
+            r[AS3935_S_LIG_M] = (E >> 8) & 0xff;
+            r[AS3935_S_LIG_MM] = (E >> 16) & 0x1f;
+            r[AS3935_DISTANCE] = (r[AS3935_DISTANCE] & 0xc0) | as3935_dist[sim_noise(&s->seed, 7) + 7];
+            r[AS3935_INT_MASK_ANT] = (r[AS3935_INT_MASK_ANT] & ~AS3935_INT_MASK) | AS3935_INT_L;
+        }else if(!(r[AS3935_INT_MASK_ANT] & AS3935_MASK_DIST))
+            r[AS3935_INT_MASK_ANT] = (r[AS3935_INT_MASK_ANT] & ~AS3935_INT_MASK) | AS3935_INT_D;
+    }
+    if(reg == AS3935_INT_MASK_ANT) s->intread = 1;
+}
+
+// interrupt flags are cleared after reading
+static void as3935_stop(simchip *c){
+    as3935_state *s = (as3935_state*)c->state;
+    if(!s->intread) return;
+    s->r.reg[AS3935_INT_MASK_ANT] &= ~AS3935_INT_MASK;
+    s->intread = 0;
+}
+
+static void as3935_write(simchip *c, uint8_t reg, uint8_t val){
+    as3935_state *s = (as3935_state*)c->state;
+    uint8_t *r = s->r.reg;
+    switch(reg){
+        case AS3935_PRESET:
+            if(val == AS3935_DIRECT_CMD) as3935_preset(s);
+        break;
+        case AS3935_CALIB_RCO:
+            if(val != AS3935_DIRECT_CMD) break;
+            r[AS3935_CALIB_TRCO] = r[AS3935_CALIB_SRCO] = 0;
+            s->tcalib = dtime() + AS3935_TCALIB;
+            s->calib = 1;
+        break;
+        case AS3935_INT_MASK_ANT:
+            r[reg] = (val & ~AS3935_INT_MASK) | (r[reg] & AS3935_INT_MASK);
+        break;
+        case AS3935_S_LIG_L:
+        case AS3935_S_LIG_M:
+        case AS3935_S_LIG_MM:
+        case AS3935_DISTANCE:
+        case AS3935_CALIB_TRCO:
+        case AS3935_CALIB_SRCO:
+        break; // read-only
+        default:
+            if(reg <= 0x08) r[reg] = val;
+    }
+}
+
+static int as3935_init(simchip *c){
+    as3935_state *s = MALLOC(as3935_state, 1);
+    c->state = s;
+    s->r.onwrite = as3935_write;
+    s->r.onread = as3935_update;
+    s->seed = c->addr;
+    as3935_preset(s);
+    return TRUE;
+}
+
+const simchip_model sim_as3935 = {
+    .name = "as3935",
+    .addr = 0x03,
+    .init = as3935_init,
+    .free = simregs_free,
+    .write = simregs_write,
+    .read = simregs_read,
+    .stop = as3935_stop
+};
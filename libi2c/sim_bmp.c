@@ -0,0 +1,303 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// simulated Bosch pressure sensors: BMP180, BMP280 and BME280
+// (calibration and raw data are examples from datasheets)
+
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "i2csim.h"
+
+/*****************************************************************************
+                BMP180
+ *****************************************************************************/
+
+#define BMP180_ID           (0x55)
+#define BMP180_REG_CALIB    (0xAA)
+#define BMP180_REG_ID       (0xD0)
+#define BMP180_REG_RESET    (0xE0)
+#define BMP180_REG_CTRL     (0xF4)
+#define BMP180_REG_OUT      (0xF6)
+#define BMP180_CTRL_SCO     (1<<5)
+#define BMP180_CMD_T        (0x0E)
+#define BMP180_RESET_VAL    (0xB6)
+// raw values for T=15.0degC and P=69964Pa (oss=0)
+#define BMP180_UT           (27898)
+#define BMP180_UP           (23843)
+
+// AC1..AC6, B1, B2, MB, MC, MD
+static const int16_t bmp180_calib[11] = {408, -72, -14383, (int16_t)32741, (int16_t)32757, 23153, 6190, 4, -32768, -8711, 2868};
+
+typedef struct{
+    simregs r;
+    double tready;          // end of conversion
+    int busy;
+    uint32_t seed;
+} bmp180_state;
+
+static void bmp180_reset(simchip *c){
+    bmp180_state *s = (bmp180_state*)c->state;
+    memset(s->r.reg, 0, sizeof(s->r.reg));
+    for(int i = 0; i < 11; ++i){
+        s->r.reg[BMP180_REG_CALIB + 2*i] = (uint16_t)bmp180_calib[i] >> 8;
+        s->r.reg[BMP180_REG_CALIB + 2*i + 1] = (uint16_t)bmp180_calib[i] & 0xff;
+    }
+    s->r.reg[BMP180_REG_ID] = BMP180_ID;
+    s->busy = 0;
+}
+
+// finish conversion if its time passed
+static void bmp180_update(simchip *c, _U_ uint8_t reg){
+    bmp180_state *s = (bmp180_state*)c->state;
+    if(!s->busy || dtime() < s->tready) return;
+    uint8_t *r = s->r.reg, ctrl = r[BMP180_REG_CTRL];
+    if((ctrl & 0x1f) == BMP180_CMD_T){
+        uint16_t ut = (uint16_t)(BMP180_UT + sim_noise(&s->seed, 2));
+        r[BMP180_REG_OUT] = ut >> 8;
+        r[BMP180_REG_OUT + 1] = ut & 0xff;
+    }else{
+        int oss = ctrl >> 6;
+        uint32_t up = (uint32_t)((BMP180_UP + sim_noise(&s->seed, 4)) << oss) << (8 - oss);
+        r[BMP180_REG_OUT] = (up >> 16) & 0xff;
+        r[BMP180_REG_OUT + 1] = (up >> 8) & 0xff;
+        r[BMP180_REG_OUT + 2] = up & 0xff;
+    }
+    r[BMP180_REG_CTRL] &= ~BMP180_CTRL_SCO;
+    s->busy = 0;
+}
+
+static void bmp180_write(simchip *c, uint8_t reg, uint8_t val){
+    bmp180_state *s = (bmp180_state*)c->state;
+    if(reg == BMP180_REG_RESET){
+        if(val == BMP180_RESET_VAL) bmp180_reset(c);
+        return;
+    }
+    if(reg != BMP180_REG_CTRL) return; // the rest is read-only
+    bmp180_update(c, reg);
+    s->r.reg[reg] = val;
+    if(!(val & BMP180_CTRL_SCO)) return;
+    // conversion time: T - 4.5ms, P - 4.5..25.5ms by oversampling
+    static const double tconv[4] = {0.0045, 0.0075, 0.0135, 0.0255};
+    s->tready = dtime() + (((val & 0x1f) == BMP180_CMD_T) ? 0.0045 : tconv[val >> 6]);
+    s->busy = 1;
+}
+
+static int bmp180_init(simchip *c){
+    bmp180_state *s = MALLOC(bmp180_state, 1);
+    c->state = s;
+    s->r.onwrite = bmp180_write;
+    s->r.onread = bmp180_update;
+    s->seed = c->addr;
+    bmp180_reset(c);
+    return TRUE;
+}
+
+const simchip_model sim_bmp180 = {
+    .name = "bmp180",
+    .addr = 0x77,
+    .init = bmp180_init,
+    .free = simregs_free,
+    .write = simregs_write,
+    .read = simregs_read
+};
+
+/*****************************************************************************
+                BMP280/BME280
+ *****************************************************************************/
+
+#define BMP280_ID           (0x58)
+#define BME280_ID           (0x60)
+#define BMP280_REG_CALIBA   (0x88)
+#define BMP280_REG_CALIB_H1 (0xA1)
+#define BMP280_REG_ID       (0xD0)
+#define BMP280_REG_RESET    (0xE0)
+#define BMP280_REG_CALIBB   (0xE1)
+#define BMP280_REG_CTRL_HUM (0xF2)
+#define BMP280_REG_STATUS   (0xF3)
+#define BMP280_REG_CTRL     (0xF4)
+#define BMP280_REG_CONFIG   (0xF5)
+#define BMP280_REG_DATA     (0xF7)
+#define BMP280_STATUS_MSRNG (1<<3)
+#define BMP280_STATUS_UPD   (1<<0)
+#define BMP280_RESET_VAL    (0xB6)
+// raw values for T=25.08degC, P=100653Pa and H=45%
+#define BMP280_ADC_T        (519888)
+#define BMP280_ADC_P        (415148)
+#define BMP280_ADC_H        (28200)
+// NVM copying after reset or power on, s
+#define BMP280_TSTARTUP     (0.002)
+
+// dig_T1..dig_T3, dig_P1..dig_P9
+static const int16_t bmp280_calib[12] = {
+    (int16_t)27504, 26435, -1000, (int16_t)36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+// dig_H1; dig_H2..dig_H6 packed as in registers 0xE1..0xE7
+static const uint8_t bme280_calibH1 = 75;
+static const uint8_t bme280_calibH[7] = {0x6A, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1E};
+
+typedef struct{
+    simregs r;
+    int bme;
+    double tupdate;         // end of NVM copying
+    double tready;          // end of current measurement
+    double tnext;           // normal mode: start of next measurement
+    int busy;
+    uint32_t seed;
+} bmp280_state;
+
+static void bmp280_reset(simchip *c){
+    bmp280_state *s = (bmp280_state*)c->state;
+    uint8_t *r = s->r.reg;
+    memset(r, 0, sizeof(s->r.reg));
+    for(int i = 0; i < 12; ++i){
+        r[BMP280_REG_CALIBA + 2*i] = (uint16_t)bmp280_calib[i] & 0xff; // little-endian
+        r[BMP280_REG_CALIBA + 2*i + 1] = (uint16_t)bmp280_calib[i] >> 8;
+    }
+    r[BMP280_REG_ID] = s->bme ? BME280_ID : BMP280_ID;
+    if(s->bme){
+        r[BMP280_REG_CALIB_H1] = bme280_calibH1;
+        memcpy(&r[BMP280_REG_CALIBB], bme280_calibH, sizeof(bme280_calibH));
+    }
+    // data registers after reset: "skipped" values
+    r[BMP280_REG_DATA] = r[BMP280_REG_DATA + 3] = 0x80;
+    if(s->bme) r[BMP280_REG_DATA + 6] = 0x80;
+    s->tupdate = dtime() + BMP280_TSTARTUP;
+    s->busy = 0;
+}
+
+// oversampling code -> amount of samples
+static int bmp280_os(int code){
+    if(code > 5) code = 5;
+    return code ? 1 << (code - 1) : 0;
+}
+
+// measurement time (typical, datasheet of BME280), s
+static double bmp280_tmeas(bmp280_state *s){
+    uint8_t ctrl = s->r.reg[BMP280_REG_CTRL];
+    double t = 1. + 2. * bmp280_os(ctrl >> 5);
+    int n = bmp280_os((ctrl >> 2) & 7);
+    if(n) t += 2. * n + 0.5;
+    if(s->bme && (n = bmp280_os(s->r.reg[BMP280_REG_CTRL_HUM] & 7))) t += 2. * n + 0.5;
+    return t * 1e-3;
+}
+
+// standby time in normal mode, s
+static double bmp280_tsb(bmp280_state *s){
+    static const double tsb280[8] = {0.0005, 0.0625, 0.125, 0.25, 0.5, 1., 2., 4.};
+    static const double tsb_bme[8] = {0.0005, 0.0625, 0.125, 0.25, 0.5, 1., 0.01, 0.02};
+    int code = s->r.reg[BMP280_REG_CONFIG] >> 5;
+    return s->bme ? tsb_bme[code] : tsb280[code];
+}
+
+static void bmp280_putdata(bmp280_state *s){
+    uint8_t *r = s->r.reg, ctrl = r[BMP280_REG_CTRL];
+    uint32_t p = 0x80000, t = 0x80000, h = 0x8000;
+    if(ctrl & (7<<2)) p = (uint32_t)(BMP280_ADC_P + sim_noise(&s->seed, 16));
+    if(ctrl & (7<<5)) t = (uint32_t)(BMP280_ADC_T + sim_noise(&s->seed, 16));
+    if(s->bme && (r[BMP280_REG_CTRL_HUM] & 7)) h = (uint32_t)(BMP280_ADC_H + sim_noise(&s->seed, 8));
+    r[BMP280_REG_DATA] = (p >> 12) & 0xff;
+    r[BMP280_REG_DATA + 1] = (p >> 4) & 0xff;
+    r[BMP280_REG_DATA + 2] = (p << 4) & 0xf0;
+    r[BMP280_REG_DATA + 3] = (t >> 12) & 0xff;
+    r[BMP280_REG_DATA + 4] = (t >> 4) & 0xff;
+    r[BMP280_REG_DATA + 5] = (t << 4) & 0xf0;
+    if(s->bme){
+        r[BMP280_REG_DATA + 6] = h >> 8;
+        r[BMP280_REG_DATA + 7] = h & 0xff;
+    }
+}
+
+// run measurements which should be done to this moment and refresh status
+static void bmp280_update(simchip *c, _U_ uint8_t reg){
+    bmp280_state *s = (bmp280_state*)c->state;
+    uint8_t *r = s->r.reg;
+    double now = dtime();
+    if(s->busy && now >= s->tready){
+        bmp280_putdata(s);
+        s->busy = 0;
+        if((r[BMP280_REG_CTRL] & 3) != 3) r[BMP280_REG_CTRL] &= ~3; // forced mode -> sleep
+    }
+    if(!s->busy && (r[BMP280_REG_CTRL] & 3) == 3 && now >= s->tnext){ // normal mode
+        double tm = bmp280_tmeas(s);
+        s->tready = now + tm;
+        s->tnext = s->tready + bmp280_tsb(s);
+        s->busy = 1;
+    }
+    r[BMP280_REG_STATUS] = (s->busy ? BMP280_STATUS_MSRNG : 0) | ((now < s->tupdate) ? BMP280_STATUS_UPD : 0);
+}
+
+static void bmp280_write(simchip *c, uint8_t reg, uint8_t val){
+    bmp280_state *s = (bmp280_state*)c->state;
+    switch(reg){
+        case BMP280_REG_RESET:
+            if(val == BMP280_RESET_VAL) bmp280_reset(c);
+        break;
+        case BMP280_REG_CTRL_HUM:
+            if(s->bme) s->r.reg[reg] = val & 7;
+        break;
+        case BMP280_REG_CONFIG:
+            s->r.reg[reg] = val & 0xfd;
+        break;
+        case BMP280_REG_CTRL:
+            bmp280_update(c, reg);
+            s->r.reg[reg] = val;
+            if(s->busy) break; // new settings will be used next time
+            if((val & 3) == 1 || (val & 3) == 2){ // forced
+                s->tready = dtime() + bmp280_tmeas(s);
+                s->busy = 1;
+            }else if((val & 3) == 3){
+                s->tnext = 0.;
+                bmp280_update(c, reg);
+            }
+        break;
+        default: // read-only
+        break;
+    }
+}
+
+static int bmp280_init_common(simchip *c, int bme){
+    bmp280_state *s = MALLOC(bmp280_state, 1);
+    c->state = s;
+    s->r.onwrite = bmp280_write;
+    s->r.onread = bmp280_update;
+    s->bme = bme;
+    s->seed = c->addr;
+    bmp280_reset(c);
+    return TRUE;
+}
+static int bmp280_init(simchip *c){ return bmp280_init_common(c, 0); }
+static int bme280_init(simchip *c){ return bmp280_init_common(c, 1); }
+
+const simchip_model sim_bmp280 = {
+    .name = "bmp280",
+    .addr = 0x76,
+    .init = bmp280_init,
+    .free = simregs_free,
+    .write = simregs_write,
+    .read = simregs_read
+};
+
+const simchip_model sim_bme280 = {
+    .name = "bme280",
+    .addr = 0x76,
+    .init = bme280_init,
+    .free = simregs_free,
+    .write = simregs_write,
+    .read = simregs_read
+};
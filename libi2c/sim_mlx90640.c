@@ -0,0 +1,158 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// simulated MLX90640: EEPROM, RAM and subpages measured with period set by REG_CONTROL
+
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "i2csim.h"
+
+#define MLXS_EEPROM         (0x2400)
+#define MLXS_RAM            (0x0400)
+#define MLXS_MEMLEN         (832)
+#define MLXS_STATUS         (0x8000)
+#define MLXS_CONTROL        (0x800D)
+#define MLXS_STATUS_OVWEN   (1<<4)
+#define MLXS_STATUS_NEWDATA (1<<3)
+#define MLXS_CTRL_SUBP1     (1<<4)
+#define MLXS_CTRL_SUBPSEL   (1<<3)
+#define MLXS_CTRL_DEFAULT   (0x1901)
+#define MLXS_W              (32)
+#define MLXS_H              (24)
+#define MLXS_PIXNO          (MLXS_W*MLXS_H)
+// background and hot object raw values
+#define MLXS_BACKGROUND     (609)
+#define MLXS_HOT            (300)
+
+// EEPROM header from 0x2410 (datasheet-like values)
+static const uint16_t mlxs_eehdr[48] = {
+    0x4210,0xFFBB,0x0202,0xF202,0xF2F2,0xE2E2,0xD1E1,0xD1D1,
+    0xF10F,0xF00F,0xE0EF,0xE0EF,0xE1E1,0xF3F2,0xF404,0xE504,
+    0x7997,0x2E26,0x0202,0xF202,0xF2F2,0xE2E2,0xD1E1,0xD1D1,
+    0xF10F,0xF00F,0xE0EF,0xE0EF,0xE1E1,0xF3F2,0xF404,0xE504,
+    0x18EF,0x2FF1,0x5952,0x9D68,0x5454,0x0994,0x6867,0x5354,
+    0x2363,0xE446,0xFBB5,0x044B,0xF020,0x9797,0x9797,0x2889
+};
+
+typedef struct{
+    uint16_t ee[MLXS_MEMLEN];
+    uint16_t ram[MLXS_MEMLEN];
+    uint16_t status;
+    uint16_t control;
+    uint16_t ptr;           // address from last write
+    double t0;              // start of current subpage measurement
+    int sp;                 // last measured subpage
+    uint32_t nsp;           // amount of measured subpages
+    uint32_t seed;
+} mlxs_state;
+
+static uint16_t *mlxs_reg(mlxs_state *s, uint16_t addr){
+    if(addr >= MLXS_EEPROM && addr < MLXS_EEPROM + MLXS_MEMLEN) return &s->ee[addr - MLXS_EEPROM];
+    if(addr >= MLXS_RAM && addr < MLXS_RAM + MLXS_MEMLEN) return &s->ram[addr - MLXS_RAM];
+    if(addr == MLXS_STATUS) return &s->status;
+    if(addr == MLXS_CONTROL) return &s->control;
+    return NULL;
+}
+
+// RAM after measurement of next subpage: background + noise and hot rectangle moving along rows
+static void mlxs_measure(mlxs_state *s){
+    if(s->control & MLXS_CTRL_SUBPSEL) s->sp = (s->control & MLXS_CTRL_SUBP1) ? 1 : 0;
+    else s->sp = !s->sp;
+    int x0 = (s->nsp++ / 2) % (MLXS_W - 8);
+    for(int i = 0; i < MLXS_PIXNO; ++i){
+        int row = i / MLXS_W, col = i % MLXS_W;
+        int v = MLXS_BACKGROUND + sim_noise(&s->seed, 8);
+        if(row > 8 && row < 14 && col >= x0 && col < x0 + 8) v += MLXS_HOT;
+        s->ram[i] = (uint16_t)v;
+    }
+    // Ta_PTAT, Vbe, CP, gain, Vdd of both subpages
+    s->ram[0x300] = 0x4BF2; s->ram[0x320] = 0x06AF; s->ram[0x30A] = 0x1881;
+    s->ram[0x308] = 0xFFCA; s->ram[0x328] = 0xFFC8; s->ram[0x32A] = 0xCCC5;
+    s->status = (s->status & MLXS_STATUS_OVWEN) | MLXS_STATUS_NEWDATA | (uint16_t)s->sp;
+}
+
+// measure all subpages which should be ready to this moment
+static void mlxs_update(mlxs_state *s){
+    double period = 2. / (double)(1 << ((s->control >> 7) & 7)), now = dtime();
+    if(now - s->t0 > 4. * period) s->t0 = now - period; // was idle: skip old subpages
+    while(now - s->t0 >= period){
+        s->t0 += period;
+        mlxs_measure(s);
+    }
+}
+
+// write: 16-bit address and (optionally) 16-bit values
+static int mlxs_write(simchip *c, const uint8_t *buf, uint16_t len){
+    mlxs_state *s = (mlxs_state*)c->state;
+    if(len < 2 || (len & 1)) return FALSE;
+    s->ptr = (uint16_t)((buf[0] << 8) | buf[1]);
+    mlxs_update(s);
+    for(uint16_t i = 2; i < len; i += 2, ++s->ptr){
+        uint16_t v = (uint16_t)((buf[i] << 8) | buf[i + 1]);
+        if(s->ptr == MLXS_STATUS) s->status = (s->status & ~(MLXS_STATUS_OVWEN | MLXS_STATUS_NEWDATA))
+                                            | (v & (MLXS_STATUS_OVWEN | MLXS_STATUS_NEWDATA));
+        else if(s->ptr == MLXS_CONTROL) s->control = v;
+        // EEPROM and RAM are read-only here
+    }
+    return TRUE;
+}
+
+static int mlxs_read(simchip *c, uint8_t *buf, uint16_t len){
+    mlxs_state *s = (mlxs_state*)c->state;
+    mlxs_update(s);
+    for(uint16_t i = 0; i + 1 < len; i += 2, ++s->ptr){
+        uint16_t *r = mlxs_reg(s, s->ptr), v = r ? *r : 0;
+        buf[i] = v >> 8;
+        buf[i + 1] = v & 0xff;
+    }
+    return TRUE;
+}
+
+static int mlxs_init(simchip *c){
+    mlxs_state *s = MALLOC(mlxs_state, 1);
+    c->state = s;
+    s->seed = c->addr;
+    // device ID (differs by address) and I2C address
+    s->ee[0x07] = 0x1234; s->ee[0x08] = 0x5678; s->ee[0x09] = c->addr;
+    s->ee[0x0F] = 0xBE00 | c->addr;
+    memcpy(&s->ee[0x10], mlxs_eehdr, sizeof(mlxs_eehdr));
+    uint32_t r = 12345;
+    for(int i = 0; i < MLXS_PIXNO; ++i){ // offsets, alpha and Kta of pixels
+        r = r * 1103515245u + 12345u;
+        uint16_t off = (r >> 8) & 0x3F, al = (r >> 16) & 0x3F, kta = (r >> 24) & 7;
+        s->ee[0x40 + i] = (uint16_t)((off << 10) | (al << 4) | (kta << 1));
+    }
+    s->control = MLXS_CTRL_DEFAULT;
+    s->t0 = dtime();
+    mlxs_measure(s);
+    return TRUE;
+}
+
+static void mlxs_free(simchip *c){
+    FREE(c->state);
+}
+
+const simchip_model sim_mlx90640 = {
+    .name = "mlx90640",
+    .addr = 0x33,
+    .init = mlxs_init,
+    .free = mlxs_free,
+    .write = mlxs_write,
+    .read = mlxs_read
+};
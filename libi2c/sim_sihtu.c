@@ -0,0 +1,231 @@
+/*
+ * This file is part of the libi2c project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// simulated humidity sensors: SI7005 and HTU21D (both have address 0x40)
+
+#include <string.h>
+#include <unistd.h>
+#include <usefull_macros.h>
+
+#include "i2csim.h"
+
+// simulated T (degC) and relative humidity (%)
+#define SIHTU_T             (22.5)
+#define SIHTU_H             (45.)
+
+/*****************************************************************************
+                SI7005
+ *****************************************************************************/
+
+#define SI7005_REG_STATUS   (0x00)
+#define SI7005_REG_DATA     (0x01)
+#define SI7005_REG_CONFIG   (0x03)
+#define SI7005_REG_ID       (0x11)
+#define SI7005_ID           (0x50)
+#define SI7005_STATUS_NRDY  (1<<0)
+#define SI7005_CONF_FAST    (1<<5)
+#define SI7005_CONF_TEMP    (1<<4)
+#define SI7005_CONF_START   (1<<0)
+// conversion time (normal and fast modes), s
+#define SI7005_TCONV        (0.035)
+#define SI7005_TCONV_FAST   (0.018)
+
+typedef struct{
+    simregs r;
+    double tready;
+    int busy;
+    uint32_t seed;
+} si7005_state;
+
+static void si7005_update(simchip *c, _U_ uint8_t reg){
+    si7005_state *s = (si7005_state*)c->state;
+    uint8_t *r = s->r.reg;
+    if(!s->busy || dtime() < s->tready) return;
+    uint16_t val;
+    if(r[SI7005_REG_CONFIG] & SI7005_CONF_TEMP) // 14 bit, T = val/32 - 50
+        val = (uint16_t)((int)((SIHTU_T + 50.) * 32.) + sim_noise(&s->seed, 1)) << 2;
+    else // 12 bit, H = val/16 - 24 (without linearization)
+        val = (uint16_t)((int)((SIHTU_H + 24.) * 16.) + sim_noise(&s->seed, 1)) << 4;
+    r[SI7005_REG_DATA] = val >> 8;
+    r[SI7005_REG_DATA + 1] = val & 0xff;
+    r[SI7005_REG_CONFIG] &= ~SI7005_CONF_START;
+    r[SI7005_REG_STATUS] = 0;
+    s->busy = 0;
+}
+
+static void si7005_write(simchip *c, uint8_t reg, uint8_t val){
+    si7005_state *s = (si7005_state*)c->state;
+    if(reg != SI7005_REG_CONFIG) return;
+    si7005_update(c, reg);
+    s->r.reg[reg] = val;
+    if(!(val & SI7005_CONF_START)) return;
+    s->tready = dtime() + ((val & SI7005_CONF_FAST) ? SI7005_TCONV_FAST : SI7005_TCONV);
+    s->r.reg[SI7005_REG_STATUS] = SI7005_STATUS_NRDY;
+    s->busy = 1;
+}
+
+// register pointer is reset to STATUS after STOP: plain read gives status and data
+static void si7005_stop(simchip *c){
+    ((si7005_state*)c->state)->r.ptr = SI7005_REG_STATUS;
+}
+
+static int si7005_init(simchip *c){
+    si7005_state *s = MALLOC(si7005_state, 1);
+    c->state = s;
+    s->r.onwrite = si7005_write;
+    s->r.onread = si7005_update;
+    s->r.reg[SI7005_REG_ID] = SI7005_ID;
+    s->seed = c->addr;
+    return TRUE;
+}
+
+const simchip_model sim_si7005 = {
+    .name = "si7005",
+    .addr = 0x40,
+    .init = si7005_init,
+    .free = simregs_free,
+    .write = simregs_write,
+    .read = simregs_read,
+    .stop = si7005_stop
+};
+
+/*****************************************************************************
+                HTU21D
+ *****************************************************************************/
+
+#define HTU21_TEMP_HOLD     (0xE3)
+#define HTU21_HUMID_HOLD    (0xE5)
+#define HTU21_TEMP          (0xF3)
+#define HTU21_HUMID         (0xF5)
+#define HTU21_WRITE_USERREG (0xE6)
+#define HTU21_READ_USERREG  (0xE7)
+#define HTU21_SOFT_RESET    (0xFE)
+#define HTU21_USERREG_DEF   (0x02)
+#define HTU21_USERREG_VBAT  (0x40)
+#define HTU21_HUMID_FLAG    (0x02)
+// soft reset time, s
+#define HTU21_TRESET        (0.015)
+
+typedef enum{
+    HTU_IDLE,               // NACK on read
+    HTU_USERREG,            // read gives user register
+    HTU_MEAS                // measurement is running or ready
+} htu_rdmode;
+
+typedef struct{
+    uint8_t userreg;
+    htu_rdmode mode;
+    int humid;              // humidity measurement
+    int hold;               // hold master mode (clock stretching till the end of conversion)
+    double tready;          // end of conversion or reset
+    uint32_t seed;
+} htu21d_state;
+
+// max conversion time by resolution bits (D7, D0) of user register, s
+static double htu21d_tconv(htu21d_state *s){
+    static const double tT[4] = {0.050, 0.013, 0.025, 0.007}, tH[4] = {0.016, 0.003, 0.005, 0.008};
+    int idx = ((s->userreg >> 6) & 2) | (s->userreg & 1);
+    return s->humid ? tH[idx] : tT[idx];
+}
+
+static uint8_t htu21d_crc(const uint8_t *data, int len){
+    uint8_t crc = 0;
+    while(len--){
+        crc ^= *data++;
+        for(int i = 0; i < 8; ++i) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static int htu21d_write(simchip *c, const uint8_t *buf, uint16_t len){
+    htu21d_state *s = (htu21d_state*)c->state;
+    double now = dtime();
+    if(now < s->tready && s->mode == HTU_IDLE) return FALSE; // in reset
+    if(len == 0) return TRUE;
+    switch(buf[0]){
+        case HTU21_READ_USERREG:
+            s->mode = HTU_USERREG;
+        break;
+        case HTU21_WRITE_USERREG:
+            if(len > 1) s->userreg = (buf[1] & ~HTU21_USERREG_VBAT) | (s->userreg & HTU21_USERREG_VBAT);
+            s->mode = HTU_IDLE;
+        break;
+        case HTU21_SOFT_RESET:
+            s->userreg = HTU21_USERREG_DEF;
+            s->mode = HTU_IDLE;
+            s->tready = now + HTU21_TRESET;
+        break;
+        case HTU21_TEMP:
+        case HTU21_HUMID:
+        case HTU21_TEMP_HOLD:
+        case HTU21_HUMID_HOLD:
+            s->humid = (buf[0] == HTU21_HUMID || buf[0] == HTU21_HUMID_HOLD);
+            s->hold = (buf[0] == HTU21_TEMP_HOLD || buf[0] == HTU21_HUMID_HOLD);
+            s->mode = HTU_MEAS;
+            s->tready = now + htu21d_tconv(s);
+        break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static int htu21d_read(simchip *c, uint8_t *buf, uint16_t len){
+    htu21d_state *s = (htu21d_state*)c->state;
+    double now = dtime();
+    if(s->mode == HTU_USERREG){
+        if(len) buf[0] = s->userreg;
+        return TRUE;
+    }
+    if(s->mode != HTU_MEAS) return FALSE;
+    if(now < s->tready){
+        if(!s->hold) return FALSE; // NACK till the end of conversion
+        usleep((useconds_t)((s->tready - now) * 1e6));
+    }
+    uint16_t val;
+    if(s->humid) // H = -6 + 125*val/65536
+        val = (uint16_t)((int)((SIHTU_H + 6.) / 125. * 65536.) + sim_noise(&s->seed, 16));
+    else // T = -46.85 + 175.72*val/65536
+        val = (uint16_t)((int)((SIHTU_T + 46.85) / 175.72 * 65536.) + sim_noise(&s->seed, 16));
+    uint8_t d[3] = {val >> 8, (val & 0xfc) | (s->humid ? HTU21_HUMID_FLAG : 0), 0};
+    d[2] = htu21d_crc(d, 2);
+    for(int i = 0; i < len; ++i) buf[i] = (i < 3) ? d[i] : 0xff;
+    s->mode = HTU_IDLE;
+    return TRUE;
+}
+
+static int htu21d_init(simchip *c){
+    htu21d_state *s = MALLOC(htu21d_state, 1);
+    c->state = s;
+    s->userreg = HTU21_USERREG_DEF;
+    s->seed = c->addr;
+    return TRUE;
+}
+
+static void htu21d_free(simchip *c){
+    FREE(c->state);
+}
+
+const simchip_model sim_htu21d = {
+    .name = "htu21d",
+    .addr = 0x40,
+    .init = htu21d_init,
+    .free = htu21d_free,
+    .write = htu21d_write,
+    .read = htu21d_read
+};
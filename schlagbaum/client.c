@@ -43,7 +43,9 @@ static cmd_t client_out_gpios[] = {
     {0, NULL}
 };
 
-static int SSL_nbread(SSL *ssl, char *buf, int bufsz){
+// wait for data no more than 1ms and read it into `lb`; return value is the same as for lb_fill()
+static int SSL_nbread(SSL *ssl, linebuf *lb){
+    if(SSL_pending(ssl)) return lb_fill(ssl, lb); // already decrypted data
     struct pollfd fds = {0};
     int fd = SSL_get_fd(ssl);
     fds.fd = fd;
@@ -53,24 +55,22 @@ static int SSL_nbread(SSL *ssl, char *buf, int bufsz){
         WARNX("poll()");
         return 0;
     }
-    if(fds.revents & (POLLIN | POLLPRI)){
-        //DBG("Got info in fd #%d", fd);
-        int l = read_string(ssl, buf, bufsz);
-        //DBG("read %d bytes", l);
-        return l;
-    }
+    if(fds.revents & (POLLIN | POLLPRI)) return lb_fill(ssl, lb);
     return 0;
 }
 
 static void readssl(SSL *ssl){
-    char buf[BUFSIZ];
-    int bytes = SSL_nbread(ssl, buf, BUFSIZ-1);
-    //int bytes = read_string(ssl, buf, BUFSIZ-1);
-    if(bytes > 0){
-        buf[bytes] = 0;
-        verbose(1, "Received: \"%s\"", buf);
-        if(!G.commands) handle_message(buf, client_out_gpios); // don't react on incoming messages if just send commands
-    }else if(bytes < 0){
+    static linebuf lb = {0};
+    char buf[LINEBUF_SZ + 1];
+    int r;
+    do{ // all answers got at once
+        r = SSL_nbread(ssl, &lb);
+        while(lb_getline(&lb, buf, sizeof(buf)) > -1){
+            verbose(1, "Received: \"%s\"", buf);
+            if(!G.commands) handle_message(buf, client_out_gpios); // don't react on incoming messages if just send commands
+        }
+    }while(r > 0);
+    if(r < 0){
         LOGWARN("Server disconnected or other error");
         ERRX("Disconnected");
     }
@@ -96,11 +96,13 @@ void clientproc(SSL_CTX *ctx, int fd){
     SSL *ssl;
     ssl = SSL_new(ctx);
     SSL_set_fd(ssl, fd);
+    session_load(ssl);
     int c = SSL_connect(ssl);
     if(c < 0){
         LOGERR("SSL_connect()");
         ERRX("SSL_connect() error: %d", SSL_get_error(ssl, c));
     }
+    verbose(1, "TLS session %s", SSL_session_reused(ssl) ? "resumed" : "created");
     int enable = 1;
     if(ioctl(fd, FIONBIO, (void *)&enable) < 0){
         LOGERR("Can't make socket nonblocking");
@@ -114,7 +116,7 @@ void clientproc(SSL_CTX *ctx, int fd){
     }
     while(1){
 #ifdef __arm__
-        poll_gpio(&ssl, -1, client_in_gpios);       
+        poll_gpio(ssl, client_in_gpios);       
 #endif
         readssl(ssl);
     }
@@ -24,6 +24,7 @@
 #include <usefull_macros.h>
 
 #include "cmdlnopts.h"
+#include "sslsock.h"
 
 
 /*
@@ -48,6 +49,10 @@ glob_pars G = {
     .cert = DEFCERT,
     .key = DEFKEY,
     .ca = DEFCA,
+#ifdef SERVER
+    .backlog = BACKLOG,
+    .maxclients = MAXCLIENTS,
+#endif
 #ifdef __arm__
     .gpiodevpath  = DEFGPIO,
 #endif
@@ -70,9 +75,16 @@ static myoption cmdlnopts[] = {
 #ifdef __arm__
     {"gpiopath",NEED_ARG,   NULL,   'g',    arg_string, APTR(&G.gpiodevpath),_("path to GPIO device (default:" DEFGPIO ")")},
 #endif
+#ifdef SERVER
+    {"backlog", NEED_ARG,   NULL,   'b',    arg_int,    APTR(&G.backlog),   _("listen() backlog (default: 128)")},
+    {"maxclients",NEED_ARG, NULL,   'm',    arg_int,    APTR(&G.maxclients),_("max amount of clients (default: 256)")},
+#endif
 #ifdef CLIENT
     {"server",  NEED_ARG,   NULL,   's',    arg_string, APTR(&G.serverhost),  _("server IP address or name")},
     {"command", MULT_PAR,   NULL,   'C',    arg_string, APTR(&G.commands),  _("don't run client as daemon, just send given commands to server")},
+    {"session", NEED_ARG,   NULL,   'S',    arg_string, APTR(&G.session),   _("file to store TLS session (to resume it on next run)")},
+    {"bench",   NEED_ARG,   NULL,   'B',    arg_int,    APTR(&G.bench),     _("measure rate of full and resumed handshakes by given amount of connections")},
+    {"load",    NEED_ARG,   NULL,   'L',    arg_int,    APTR(&G.load),      _("load test: open given amount of concurrent connections and send command by each")},
 #endif
    end_option
 };
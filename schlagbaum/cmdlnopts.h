@@ -37,9 +37,16 @@ typedef struct{
     char *port;             // port number
     int verbose;            // logfile verbose level
     char *ca;               // ca
+#ifdef SERVER
+    int backlog;            // listen() backlog
+    int maxclients;         // max amount of connected clients
+#endif
 #ifdef CLIENT
     char *serverhost;       // server IP address
     char **commands;        // don't run as daemon, just send given commands to server
+    char *session;          // file to store TLS session for resumption
+    int bench;              // amount of connections for handshake benchmark
+    int load;               // amount of concurrent connections for load test
 #endif
 #ifdef __arm__
     char *gpiodevpath;      // path to gpio device file
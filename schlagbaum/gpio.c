@@ -46,14 +46,19 @@ static enum gpio_v2_line_event_id gpio_in_event_id[GPIO_IN_NUMBER] = {0};
 
 /**
  * @brief gpio_chkclr - clear outputs by timeout
+ * @return time (by dtime()) of next output clearing or -1 if all outputs are cleared
  */
-static void gpio_chkclr(){
-    double tnow = dtime();
+double gpio_chkclr(){
+    double tnow = dtime(), tnext = -1.;
     for(int i = 0; i < GPIO_OUT_NUMBER; ++i){
         if(gpio_clear_time[i] < 0.) continue;
-        if(tnow - gpio_clear_time[i] < GPIO_TIMEOUT) continue;
-        gpio_set_output(gpio_outputs[i]);
+        if(tnow - gpio_clear_time[i] >= GPIO_TIMEOUT && !gpio_set_output(gpio_outputs[i]))
+            gpio_clear_time[i] = tnow - GPIO_TIMEOUT + GPIO_RETRY; // failed: try again later
+        if(gpio_clear_time[i] < 0.) continue; // cleared
+        double t = gpio_clear_time[i] + GPIO_TIMEOUT;
+        if(tnext < 0. || t < tnext) tnext = t;
     }
+    return tnext;
 }
 
 /**
@@ -173,7 +178,15 @@ int gpio_setup_inputs(){
 }
 
 /**
- * @brief gpio_poll - poll inputs, return only last event
+ * @brief gpio_event_fd - descriptor of input line events (to wait for them in epoll)
+ * @return rq_in.fd
+ */
+int gpio_event_fd(){
+    return rq_in.fd;
+}
+
+/**
+ * @brief gpio_poll - poll inputs (don't wait), return only last event
  * @return bit mask of changing inputs (edge falling), 0 if nothing happen or -1 if error
  */
 int gpio_poll(uint32_t *up, uint32_t *down){
@@ -186,7 +199,7 @@ int gpio_poll(uint32_t *up, uint32_t *down){
     gpio_chkclr(); // clear old outputs
     pfd.fd = rq_in.fd;
     pfd.events = POLLIN | POLLPRI;
-    int p = poll(&pfd, 1, 1);
+    int p = poll(&pfd, 1, 0);
     if(p == 0) return 0; // nothing happened
     else if(p == -1){
         LOGERR("poll() error: %s", strerror(errno));
@@ -37,6 +37,8 @@
 
 // timeout - clear GPIO after receiving command - 1 minute
 #define GPIO_TIMEOUT    (60.)
+// retry interval if output can't be cleared by timeout
+#define GPIO_RETRY      (1.)
 // don't allow to manage with GPIO over this time after last ON
 #define GPIO_SETTMOUT   (5.0)
 // time for debounce (seconds)
@@ -45,7 +47,9 @@
 int gpio_open_device(const char *path);
 int gpio_setup_outputs();
 int gpio_setup_inputs();
+int gpio_event_fd();
 int gpio_poll(uint32_t *up, uint32_t *down);
+double gpio_chkclr();
 int gpio_set_output(int output);
 int gpio_clear_output(int output);
 void gpio_close();
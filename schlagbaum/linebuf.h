@@ -1,6 +1,6 @@
 /*
- * This file is part of the bmp280 project.
- * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ * This file is part of the schlagbaum project.
+ * Copyright 2023 Edward V. Emelianov <edward.emelianoff@gmail.com>.
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,22 +18,16 @@
 
 #pragma once
 
-#include <stdint.h>
+// size of per-connection input ring buffer (max length of command)
+#define LINEBUF_SZ  (1024)
 
-#ifndef FALSE
-#define FALSE 0
-#endif
-#ifndef TRUE
-#define TRUE 1
-#endif
-
-int i2c_open(const char *path);
-void i2c_close();
-int i2c_set_slave_address(uint8_t addr);
-int i2c_read_reg8(uint8_t regaddr, uint8_t *data);
-int i2c_write_reg8(uint8_t regaddr, uint8_t data);
-int i2c_read_data8(uint8_t regaddr, uint16_t N, uint8_t *array);
-int i2c_read_reg16(uint16_t regaddr, uint16_t *data);
-int i2c_write_reg16(uint16_t regaddr, uint16_t data);
-int i2c_read_data16(uint16_t regaddr, uint16_t N, uint8_t *array);
+// input ring buffer: data decrypted by SSL_read() is splitted by '\n' here
+typedef struct{
+    char buf[LINEBUF_SZ];
+    int head;       // index of first byte
+    int len;        // amount of data
+    int checked;    // amount of bytes from `head` already checked for '\n'
+} linebuf;
 
+char *lb_space(linebuf *lb, int *sz);
+int lb_getline(linebuf *lb, char *line, int l);
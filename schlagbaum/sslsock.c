@@ -53,7 +53,7 @@ static int OpenConn(int port){
         LOGWARN("Can't bind port %d", port);
         ERRX("bind()");
     }
-    if(listen(sd, BACKLOG)){
+    if(listen(sd, G.backlog)){
         LOGWARN("Can't listen()");
         ERRX("listen()");
     }
@@ -84,6 +84,123 @@ static int OpenConn(int port){
 }
 #endif
 
+#ifdef CLIENT
+/**
+ * @brief session_save - callback for new session (ticket from server): store it into G.session
+ * @return 0 as we don't keep reference to `sess`
+ */
+static int session_save(_U_ SSL *ssl, SSL_SESSION *sess){
+    int fd = open(G.session, O_WRONLY | O_CREAT | O_TRUNC, 0600); // session contains secret
+    if(fd < 0){
+        WARN("Can't open %s", G.session);
+        return 0;
+    }
+    FILE *f = fdopen(fd, "w");
+    if(!f){
+        close(fd);
+        return 0;
+    }
+    if(!PEM_write_SSL_SESSION(f, sess)) WARNX("Can't save TLS session");
+    else DBG("Session saved to %s", G.session);
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @brief session_load - try to resume session stored in G.session
+ * @param ssl - new SSL (before SSL_connect())
+ */
+void session_load(SSL *ssl){
+    if(!G.session) return;
+    FILE *f = fopen(G.session, "r");
+    if(!f) return; // first run
+    SSL_SESSION *sess = PEM_read_SSL_SESSION(f, NULL, NULL, NULL);
+    fclose(f);
+    if(!sess){
+        WARNX("Bad session file %s", G.session);
+        return;
+    }
+    if(!SSL_SESSION_is_resumable(sess) || !SSL_set_session(ssl, sess)) DBG("Can't resume session");
+    SSL_SESSION_free(sess);
+}
+
+/**
+ * @brief hs_bench - connect to server `N` times and measure handshake rate
+ * @param ctx - SSL context
+ * @param port - server port
+ * @param N - amount of connections
+ * @param resume - resume previous session if TRUE
+ * Each connection is the same as `-C ping`: handshake, command, answer, shutdown.
+ */
+static void hs_bench(SSL_CTX *ctx, int port, int N, int resume){
+    SSL_SESSION *sess = NULL;
+    int nresumed = 0;
+    char buf[BUFSIZ];
+    int l = snprintf(buf, BUFSIZ, "%s\n", CMD_PING);
+    double t0 = dtime();
+    for(int i = 0; i < N; ++i){
+        int fd = OpenConn(port);
+        SSL *ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, fd);
+        if(sess) SSL_set_session(ssl, sess);
+        int c = SSL_connect(ssl);
+        if(c != 1) ERRX("SSL_connect() error: %d", SSL_get_error(ssl, c));
+        if(SSL_session_reused(ssl)) ++nresumed;
+        if(SSL_write(ssl, buf, l) <= 0) WARNX("SSL write error");
+        if(SSL_read(ssl, buf + l + 1, BUFSIZ - l - 1) <= 0) WARNX("No answer"); // new tickets are got here
+        if(resume){
+            SSL_SESSION_free(sess);
+            sess = SSL_get1_session(ssl);
+        }
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        close(fd);
+    }
+    double t = dtime() - t0;
+    SSL_SESSION_free(sess);
+    printf("%s handshakes: %d connections (%d resumed) in %.3fs, %.1f handshakes/s\n",
+           resume ? "Resumed" : "Full", N, nresumed, t, N / t);
+}
+
+/**
+ * @brief load_test - keep `N` connections to server at once, send command by each and wait for answers
+ * @param ctx - SSL context
+ * @param port - server port
+ * @param N - amount of connections
+ */
+static void load_test(SSL_CTX *ctx, int port, int N){
+    SSL **ssls = MALLOC(SSL*, N);
+    char buf[BUFSIZ];
+    int l = snprintf(buf, BUFSIZ, "%s\n", CMD_PING);
+    double t0 = dtime();
+    for(int i = 0; i < N; ++i){
+        int fd = OpenConn(port);
+        ssls[i] = SSL_new(ctx);
+        SSL_set_fd(ssls[i], fd);
+        int c = SSL_connect(ssls[i]);
+        if(c != 1) ERRX("Connection #%d: SSL_connect() error %d", i, SSL_get_error(ssls[i], c));
+    }
+    double t1 = dtime();
+    printf("%d connections in %.3fs (%.1f handshakes/s)\n", N, t1 - t0, N / (t1 - t0));
+    for(int i = 0; i < N; ++i)
+        if(SSL_write(ssls[i], buf, l) <= 0) WARNX("Connection #%d: SSL write error", i);
+    int nans = 0;
+    for(int i = 0; i < N; ++i){
+        if(SSL_read(ssls[i], buf + l + 1, BUFSIZ - l - 1) > 0) ++nans;
+        else WARNX("Connection #%d: no answer", i);
+    }
+    double t2 = dtime();
+    printf("%d answers of %d in %.3fs\n", nans, N, t2 - t1);
+    for(int i = 0; i < N; ++i){
+        int fd = SSL_get_fd(ssls[i]);
+        SSL_shutdown(ssls[i]);
+        SSL_free(ssls[i]);
+        close(fd);
+    }
+    FREE(ssls);
+}
+#endif
+
 static SSL_CTX* InitCTX(void){
     const SSL_METHOD *method;
     SSL_CTX *ctx;
@@ -129,6 +246,19 @@ static SSL_CTX* InitCTX(void){
     SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
 #endif
     SSL_CTX_set_verify_depth(ctx, 1); // We accept only certificates signed only by the CA himself
+    // session resumption: short handshake for reconnecting clients
+#ifdef SERVER
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char*)SESSION_ID_CTX, sizeof(SESSION_ID_CTX) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_timeout(ctx, SESSION_TIMEOUT);
+    SSL_CTX_set_num_tickets(ctx, 1); // one ticket is enough: client keeps only the last session
+#else
+    if(G.session){
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, session_save);
+    }
+#endif
     return ctx;
 }
 
@@ -136,7 +266,7 @@ int open_socket(){
     int fd;
 #ifdef __arm__
 #ifndef SERVER
-    if(!G.commands){ // open devices if not client
+    if(!G.commands && !G.bench && !G.load){ // open devices if not client
 #endif
         if(-1 == gpio_open_device(G.gpiodevpath)) ERRX("Can't open GPIO device");
         if(-1 == gpio_setup_outputs() || -1 == gpio_setup_inputs()) ERRX("Can't setup GPIO");
@@ -146,6 +276,19 @@ int open_socket(){
 #endif
     SSL_library_init();
     SSL_CTX *ctx = InitCTX();
+#ifdef CLIENT
+    if(G.bench > 0){
+        hs_bench(ctx, atoi(G.port), G.bench, FALSE);
+        hs_bench(ctx, atoi(G.port), G.bench, TRUE);
+        SSL_CTX_free(ctx);
+        return 0;
+    }
+    if(G.load > 0){
+        load_test(ctx, atoi(G.port), G.load);
+        SSL_CTX_free(ctx);
+        return 0;
+    }
+#endif
     fd = OpenConn(atoi(G.port));
 #ifdef SERVER
     serverproc(ctx, fd);
@@ -174,66 +317,57 @@ static int geterrcode(SSL *ssl, int errcode){
 }
 
 /**
- * @brief read_string - read '\n'-terminated string from SSL
+ * @brief lb_fill - read all data available in SSL into ring buffer
  * @param ssl - SSL
- * @param buf - buffer for text
- * @param l - max buf length (including zero)
- * @return amount of bytes read or -1 if client disconnected
+ * @param lb - line buffer of this connection
+ * @return -1 if disconnected, 1 if buffer is full (call again after lines processing), 0 if all data read
+ * SSL could hold decrypted data invisible for poll/epoll, so read until WANT_READ
  */
-int read_string(SSL *ssl, char *buf, int l){
-    if(!ssl || l < 1) return 0;
-    bzero(buf, l);
-    int bytes = SSL_peek(ssl, buf, l);
-    DBG("Peek: %d (bufsz %d); buf=%s", bytes, l, buf);
-    if(bytes < 1){ // nothing to read or error
-        return geterrcode(ssl, bytes);
-    }
-    if(bytes < l && buf[bytes-1] != '\n'){ // string not ready, no buffer overfull
-        return -1; // wait a rest of string
+int lb_fill(SSL *ssl, linebuf *lb){
+    if(!ssl || !lb) return -1;
+    char *ptr;
+    int sz;
+    while((ptr = lb_space(lb, &sz))){
+        int bytes = SSL_read(ssl, ptr, sz);
+        if(bytes < 1) return geterrcode(ssl, bytes);
+        DBG("Read: %d", bytes);
+        lb->len += bytes;
     }
-    bytes = SSL_read(ssl, buf, l);
-    DBG("Read: %d", bytes);
-    if(bytes < 1){ // error
-        return geterrcode(ssl, bytes);
-    }
-    buf[bytes-1] = 0; // replace '\n' with 0
-    return bytes;
+    return 1;
 }
 
 #ifdef __arm__
 /**
- * @brief poll_gpio - GPIO polling
- * @param ssl - ssl array to write
- * @param nfd - amount of descriptors (+1 - starting frol ssls[1]) for server or -1 for client
+ * @brief gpio_message - read GPIO event and make corresponding command
+ * @param buf - buffer for message
+ * @param l - its length
+ * @param commands - table of commands by input pins
+ * @return message length or 0 if there's nothing to send
  */
-void poll_gpio(SSL **ssls, int nfd, cmd_t *commands){
-    static double t0 = 0.;
-    if(dtime() - t0 < GPIO_POLL_INTERVAL) return;
-    char buf[64];
+int gpio_message(char *buf, int l, cmd_t *commands){
     uint32_t up, down;
-    t0 = dtime();
-    if(gpio_poll(&up, &down) <= 0 || !down) return;
-    DBG("DOWN=%d, nfd=%d", down, nfd);
+    if(gpio_poll(&up, &down) <= 0 || !down) return 0;
+    DBG("DOWN=%d", down);
     for(cmd_t *c = commands; c->cmd; ++c){
-	DBG("Test %d - %s", c->gpio, c->cmd);
         if(c->gpio != down) continue;
-	DBG("Got event %s", c->cmd);
-        sprintf(buf, "%s\n", c->cmd);
-        int l = strlen(buf);
-	if(!ssls) return;
-        if(nfd == -1){
-	    DBG("Write to server");
-            if(SSL_write(ssls[0], buf, l) <= 0) WARNX("SSL write error");
-        }else{
-	    DBG("Write to all %d clients", nfd-1);
-            for(int i = nfd-1; i > 0; --i){
-		DBG("ssls[%d]", i);
-                if(SSL_write(ssls[i], buf, l) <= 0){
-                    WARNX("SSL write error");
-                }
-            }
-        }
+        DBG("Got event %s", c->cmd);
+        return snprintf(buf, l, "%s\n", c->cmd);
     }
+    return 0;
+}
+
+/**
+ * @brief poll_gpio - GPIO polling (not often than GPIO_POLL_INTERVAL) by client
+ * @param ssl - connection with server
+ * @param commands - table of commands by input pins
+ */
+void poll_gpio(SSL *ssl, cmd_t *commands){
+    static double t0 = 0.;
+    if(dtime() - t0 < GPIO_POLL_INTERVAL) return;
+    t0 = dtime();
+    char buf[64];
+    int l = gpio_message(buf, 64, commands);
+    if(l > 0 && SSL_write(ssl, buf, l) <= 0) WARNX("SSL write error");
 }
 #endif
 
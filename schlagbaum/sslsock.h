@@ -28,6 +28,8 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
+#include "linebuf.h"
+
 #if ! defined CLIENT && ! defined SERVER
 #error "Define CLIENT or SERVER before including this file"
 #endif
@@ -35,7 +37,10 @@
 #error "Both CLIENT and SERVER defined"
 #endif
 
-#define BACKLOG     10
+// default listen() backlog
+#define BACKLOG     (128)
+// default max amount of clients
+#define MAXCLIENTS  (256)
 
 // command protocol
 // open gate
@@ -58,10 +63,17 @@ typedef struct{
     const char *cmd;    // text command
 } cmd_t;
 
+// name of session ID context (resumption is possible only within the same context)
+#define SESSION_ID_CTX  "schlagbaum"
+
 int open_socket();
-int read_string(SSL *ssl, char *buf, int l);
+#ifdef CLIENT
+void session_load(SSL *ssl);
+#endif
+int lb_fill(SSL *ssl, linebuf *lb);
 
 int handle_message(const char *msg, cmd_t *gpios);
 #ifdef __arm__
-void poll_gpio(SSL **ssls, int nfd, cmd_t *commands);
+int gpio_message(char *buf, int l, cmd_t *commands);
+void poll_gpio(SSL *ssl, cmd_t *commands);
 #endif
@@ -0,0 +1,71 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <usefull_macros.h>
+
+#include "cmdlnopts.h"
+#include "timerwheel.h"
+
+static int help;
+static glob_pars G;
+
+#define DEFAULT_PIDFILE "/tmp/sensord.pid"
+#define DEFAULT_I2C     "/dev/i2c-3"
+
+static glob_pars const Gdefault = {
+    .device = DEFAULT_I2C,
+    .pidfile = DEFAULT_PIDFILE,
+    .tick = TW_TICK,
+};
+
+static myoption cmdlnopts[] = {
+    {"help",    NO_ARGS,    NULL,   'h',    arg_int,    APTR(&help),        _("show this help")},
+    {"logfile", NEED_ARG,   NULL,   'l',    arg_string, APTR(&G.logfile),   _("file to save logs")},
+    {"pidfile", NEED_ARG,   NULL,   'P',    arg_string, APTR(&G.pidfile),   _("pidfile (default: " DEFAULT_PIDFILE ")")},
+    {"device",  NEED_ARG,   NULL,   'd',    arg_string, APTR(&G.device),    _("default I2C device path (default: " DEFAULT_I2C ")")},
+    {"sensor",  MULT_PAR,   NULL,   's',    arg_string, APTR(&G.sensors),   _("sensor: model[,addr=N][,period=seconds][,bus=path] (bus should be last)")},
+    {"tick",    NEED_ARG,   NULL,   't',    arg_double, APTR(&G.tick),      _("scheduler tick, s (default: 0.001)")},
+    {"list",    NO_ARGS,    NULL,   'L',    arg_int,    APTR(&G.list),      _("show available sensor models")},
+   end_option
+};
+
+/**
+ * Parse command line options and return dynamically allocated structure
+ *      to global parameters
+ * @param argc - copy of argc from main
+ * @param argv - copy of argv from main
+ * @return allocated structure with global parameters
+ */
+glob_pars *parse_args(int argc, char **argv){
+    void *ptr;
+    ptr = memcpy(&G, &Gdefault, sizeof(G)); assert(ptr);
+    char helpstring[1024];
+    snprintf(helpstring, sizeof(helpstring), "Usage: %%s [args]\n\n\tWhere args are:\n");
+    change_helpstring(helpstring);
+    parseargs(&argc, &argv, cmdlnopts);
+    if(help) showhelp(-1, cmdlnopts);
+    if(argc > 0){
+        WARNX("Ignoring arguments:");
+        for(int i = 0; i < argc; i++)
+            printf("\t%s\n", argv[i]);
+    }
+    return &G;
+}
@@ -1,6 +1,6 @@
 /*
- * This file is part of the lightning project.
- * Copyright 2024 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,16 +18,13 @@
 
 #pragma once
 
-#include <stdint.h>
+typedef struct{
+    char *device;           // default I2C bus
+    char **sensors;         // sensors descriptions
+    char *pidfile;          // name of PID file
+    char *logfile;          // logging to this file
+    double tick;            // scheduler tick, s
+    int list;               // show available sensor models
+} glob_pars;
 
-#ifndef FALSE
-#define FALSE 0
-#endif
-#ifndef TRUE
-#define TRUE 1
-#endif
-
-int i2c_read_reg(int fd, uint8_t regaddr, uint8_t *data);
-int i2c_write_reg(int fd, uint8_t regaddr, uint8_t data);
-int i2c_set_slave_address(int fd, uint8_t addr);
-int i2c_open(const char *path);
+glob_pars *parse_args(int argc, char **argv);
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <usefull_macros.h>
+
+#include "cmdlnopts.h"
+#include "sensors.h"
+#include "timerwheel.h"
+
+static glob_pars *GP = NULL;
+static timerwheel wheel;
+
+void signals(int sig){
+    if(sig){
+        signal(sig, SIG_IGN);
+        DBG("Get signal %d, quit.\n", sig);
+    }
+    struct rusage ru;
+    sensors_stat();
+    if(getrusage(RUSAGE_SELF, &ru) == 0)
+        printf("CPU time: user %.3fs, system %.3fs\n", ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6,
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6);
+    sensors_close();
+    LOGERR("Exit with status %d", sig);
+    if(GP && GP->pidfile) // remove unnesessary PID file
+        unlink(GP->pidfile);
+    exit(sig);
+}
+
+int main(int argc, char **argv){
+    initial_setup();
+    char *self = strdup(argv[0]);
+    GP = parse_args(argc, argv);
+    if(GP->list){
+        sensors_list();
+        return 0;
+    }
+    if(!GP->sensors) ERRX("Point at least one sensor");
+    if(GP->tick < 1e-4 || GP->tick > 0.1) ERRX("tick should be from 0.0001 to 0.1s");
+    check4running(self, GP->pidfile);
+    FREE(self);
+    if(GP->logfile) OPENLOG(GP->logfile, LOGLEVEL_ANY, 1);
+    signal(SIGTERM, signals);
+    signal(SIGINT, signals);
+    signal(SIGQUIT, signals);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGHUP, signals);
+    tw_init(&wheel, GP->tick);
+    for(char **s = GP->sensors; *s; ++s)
+        if(!sensor_new(*s, GP->device, &wheel)) signals(1);
+    LOGMSG("Started");
+    // sleep till nearest sensor deadline, then run all expired timers
+    while(1){
+        double dt = tw_timeout(&wheel);
+        if(dt < 0.) dt = 1.;
+        if(dt > 0.){
+            struct timespec ts = {.tv_sec = (time_t)dt, .tv_nsec = (long)((dt - (time_t)dt) * 1e9)};
+            nanosleep(&ts, NULL);
+        }
+        tw_run(&wheel);
+    }
+    return 0;
+}
@@ -0,0 +1,409 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <usefull_macros.h>
+
+#include "as3935.h"
+#include "BMP180.h"
+#include "BMP280.h"
+#include "htu21d.h"
+#include "sensors.h"
+#include "si7005.h"
+
+// opened buses (shared by sensors with the same path)
+typedef struct busent{
+    char *path;
+    i2cbus *bus;
+    struct busent *next;
+} busent;
+
+static busent *buses = NULL;
+static sensor *sensors = NULL;
+
+// show measurement result with timestamp
+static void out(sensor *s, const char *fmt, ...){
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    printf("%.3f %s@0x%02x: %s\n", dtime(), s->model->name, s->dev->addr, buf);
+    fflush(stdout);
+    LOGMSG("%s@0x%02x: %s", s->model->name, s->dev->addr, buf);
+}
+
+/*****************************************************************************
+                Models: wrappers of sensor drivers
+ *****************************************************************************/
+
+// BMP180
+static int bmp180_init(_U_ sensor *s){
+    return BMP180_init();
+}
+static int bmp180_start(_U_ sensor *s){
+    return BMP180_start();
+}
+static meas_result bmp180_poll(_U_ sensor *s){
+    BMP180_process();
+    switch(BMP180_get_status()){
+        case BMP180_BUSYT:
+        case BMP180_BUSYP:
+            return MEAS_BUSY;
+        case BMP180_RDY:
+            return MEAS_READY;
+        default:
+            return MEAS_ERR;
+    }
+}
+static void bmp180_report(sensor *s){
+    float T;
+    uint32_t P;
+    BMP180_getdata(&T, &P);
+    out(s, "T=%.1f, P=%uPa (%.1fmmHg)", T, P, P * 0.00750062);
+}
+
+// BMP280/BME280
+static int bmp280_init(_U_ sensor *s){
+    return BMP280_init();
+}
+static int bmp280_start(_U_ sensor *s){
+    return BMP280_start();
+}
+static meas_result bmp280_poll(_U_ sensor *s){
+    BMP280_process();
+    switch(BMP280_get_status()){
+        case BMP280_BUSY:
+            return MEAS_BUSY;
+        case BMP280_RDY:
+            return MEAS_READY;
+        default:
+            return MEAS_ERR;
+    }
+}
+static void bmp280_report(sensor *s){
+    float T, P, H;
+    uint8_t ID;
+    if(!BMP280_getdata(&T, &P, &H)){
+        out(s, "can't get data");
+        return;
+    }
+    BMP280_read_ID(&ID);
+    if(ID == BME280_CHIP_ID) out(s, "T=%.1f, P=%.1fPa (%.1fmmHg), H=%.1f%%", T, P, P * 0.00750062f, H);
+    else out(s, "T=%.1f, P=%.1fPa (%.1fmmHg)", T, P, P * 0.00750062f);
+}
+
+// SI7005: driver leaves ERR state only by new measurement start
+static int si7005_init(_U_ sensor *s){
+    if(si7005_get_status() != SI7005_RELAX) return TRUE;
+    return si7005_read_ID();
+}
+static int si7005_start(_U_ sensor *s){
+    return si7005_startmeasure();
+}
+static meas_result si7005_poll(_U_ sensor *s){
+    si7005_process();
+    switch(si7005_get_status()){
+        case SI7005_BUSY:
+            return MEAS_BUSY;
+        case SI7005_RDY:
+            return MEAS_READY;
+        default:
+            return MEAS_ERR;
+    }
+}
+static void si7005_report(sensor *s){
+    float T, H;
+    if(si7005_getTH(&T, &H)) out(s, "T=%.1f, H=%.1f%%", T, H);
+}
+
+// HTU21D
+static int htu21d_init(_U_ sensor *s){
+    if(HTU21D_get_status() != HTU21D_RELAX) return TRUE;
+    return HTU21D_read_ID();
+}
+static int htu21d_start(_U_ sensor *s){
+    return HTU21D_startmeasure();
+}
+static meas_result htu21d_poll(_U_ sensor *s){
+    HTU21D_process();
+    switch(HTU21D_get_status()){
+        case HTU21D_BUSY:
+            return MEAS_BUSY;
+        case HTU21D_RDY:
+            return MEAS_READY;
+        default:
+            return MEAS_ERR;
+    }
+}
+static void htu21d_report(sensor *s){
+    float T, H;
+    if(HTU21D_getTH(&T, &H)) out(s, "T=%.1f, H=%.1f%%", T, H);
+}
+
+// AS3935: there's no conversions, "measurement" is a check of interrupt register
+static uint8_t as3935_int = 0;
+static int as_init(sensor *s){
+    if(!as3935_attach(s->dev)) return FALSE;
+    return as3935_wakeup();
+}
+static int as_start(_U_ sensor *s){
+    return TRUE;
+}
+static meas_result as_poll(_U_ sensor *s){
+    if(!as3935_intcode(&as3935_int)) return MEAS_ERR;
+    return MEAS_READY;
+}
+static void as_report(sensor *s){
+    uint32_t E;
+    uint8_t d;
+    switch(as3935_int){
+        case 0:
+        break;
+        case INT_NH:
+            out(s, "noise level too high");
+        break;
+        case INT_D:
+            out(s, "disturber detected");
+        break;
+        case INT_L:
+            if(!as3935_lightning(&E, &d)) out(s, "lightning (can't read energy and distance)");
+            else if(d == DIST_OUT_OF_RANGE) out(s, "lightning: out of range, energy=%u", E);
+            else out(s, "lightning: distance=%dkm, energy=%u", d, E);
+        break;
+        default:
+            out(s, "unknown interrupt code %d", as3935_int);
+    }
+}
+
+static const sensor_model models[] = {
+    {"bmp180", BMP180_I2C_ADDRESS, 5., bmp180_init, bmp180_start, bmp180_poll, BMP180_deadline, bmp180_report},
+    {"bmp280", BMP280_I2C_ADDRESS, 5., bmp280_init, bmp280_start, bmp280_poll, BMP280_deadline, bmp280_report},
+    {"si7005", 0x40, 1., si7005_init, si7005_start, si7005_poll, si7005_deadline, si7005_report},
+    {"htu21d", 0x40, 1., htu21d_init, htu21d_start, htu21d_poll, HTU21D_deadline, htu21d_report},
+    {"as3935", 0x03, 0.5, as_init, as_start, as_poll, NULL, as_report},
+    {NULL, 0, 0., NULL, NULL, NULL, NULL, NULL}
+};
+
+// show available models
+void sensors_list(){
+    printf("Sensor models (default address, period):\n");
+    for(const sensor_model *m = models; m->name; ++m)
+        printf("\t%s (0x%02x, %gs)\n", m->name, m->addr, m->period);
+}
+
+/*****************************************************************************
+                Scheduler
+ *****************************************************************************/
+
+static void schedule(sensor *s, double when){
+    tw_add_at(s->wheel, &s->timer, when);
+}
+
+// time of next poll of busy sensor: expected conversion end but not earlier than SENS_POLL from now
+static double nextpoll(sensor *s, double now){
+    double d = s->model->deadline ? s->model->deadline() : 0.;
+    if(d < now + SENS_POLL) d = now + SENS_POLL;
+    return d;
+}
+
+static void failed(sensor *s, const char *what){
+    ++s->nerr;
+    WARNX("%s@0x%02x: %s", s->model->name, s->dev->addr, what);
+    LOGWARN("%s@0x%02x: %s", s->model->name, s->dev->addr, what);
+    s->state = SENS_INIT;
+    s->tnext = dtime() + SENS_RETRY;
+    schedule(s, s->tnext);
+}
+
+// timer callback: one step of sensor state machine
+static void step(_U_ tw_timer *t, void *arg){
+    sensor *s = (sensor*)arg;
+    i2c_setdev(s->dev);
+    double now = dtime(), next;
+    switch(s->state){
+        case SENS_INIT:
+            if(!s->model->init(s)){
+                failed(s, "can't init");
+                return;
+            }
+            DBG("%s inited", s->model->name);
+            s->state = SENS_IDLE;
+            // fallthrough
+        case SENS_IDLE:
+            if(!s->model->start(s)){
+                failed(s, "can't start measurement");
+                return;
+            }
+            s->tstart = now;
+            s->state = SENS_BUSY;
+            schedule(s, nextpoll(s, now));
+        break;
+        case SENS_BUSY:
+            ++s->npolls;
+            switch(s->model->poll(s)){
+                case MEAS_BUSY:
+                    if(now - s->tstart > SENS_TIMEOUT) failed(s, "measurement timeout");
+                    else schedule(s, nextpoll(s, now));
+                break;
+                case MEAS_READY:
+                    ++s->nmeas;
+                    s->model->report(s);
+                    s->state = SENS_IDLE;
+                    // keep cadence: period is counted from previous scheduled start
+                    next = s->tnext + s->period;
+                    if(now - next > s->period) next = now; // too late: start new schedule
+                    s->tnext = next;
+                    schedule(s, (next > now) ? next : now);
+                break;
+                default:
+                    failed(s, "measurement error");
+            }
+        break;
+    }
+}
+
+/*****************************************************************************
+                Sensors list
+ *****************************************************************************/
+
+static i2cbus *getbus(const char *path){
+    for(busent *b = buses; b; b = b->next)
+        if(strcmp(b->path, path) == 0) return b->bus;
+    i2cbus *bus = i2cbus_open(path);
+    if(!bus) return NULL;
+    busent *b = MALLOC(busent, 1);
+    b->path = strdup(path);
+    b->bus = bus;
+    b->next = buses;
+    buses = b;
+    return bus;
+}
+
+/**
+ * @brief sensor_new - create sensor and schedule its initialization
+ * @param spec - "model[,addr=N][,period=S][,bus=PATH]" (bus should be last: path of simulated bus contains commas)
+ * @param defbus - path of bus if `spec` have no "bus="
+ * @param w - timer wheel
+ * @return sensor or NULL if failed
+ */
+sensor *sensor_new(const char *spec, const char *defbus, timerwheel *w){
+    if(!spec || !w) return NULL;
+    char *str = strdup(spec), *bus = (char*)defbus, *tok = str, *nxt;
+    const sensor_model *m = NULL;
+    int addr = -1;
+    double period = -1.;
+    nxt = strchr(tok, ',');
+    if(nxt) *nxt++ = 0;
+    for(m = models; m->name; ++m) if(strcasecmp(m->name, tok) == 0) break;
+    if(!m->name){
+        WARNX("Unknown sensor model '%s'", tok);
+        goto bad;
+    }
+    while((tok = nxt)){
+        if(strncmp(tok, "bus=", 4) == 0){ // the rest of string is bus path
+            bus = tok + 4;
+            break;
+        }
+        nxt = strchr(tok, ',');
+        if(nxt) *nxt++ = 0;
+        char *eq = strchr(tok, '='), *eptr;
+        if(!eq){
+            WARNX("Wrong parameter '%s' of %s", tok, m->name);
+            goto bad;
+        }
+        *eq++ = 0;
+        if(strcmp(tok, "addr") == 0){
+            addr = (int)strtol(eq, &eptr, 0);
+            if(*eptr || addr < 0 || addr > 0x7f){
+                WARNX("Wrong address of %s: %s", m->name, eq);
+                goto bad;
+            }
+        }else if(strcmp(tok, "period") == 0){
+            period = strtod(eq, &eptr);
+            if(*eptr || period < SENS_POLL){
+                WARNX("Wrong period of %s: %s", m->name, eq);
+                goto bad;
+            }
+        }else{
+            WARNX("Unknown parameter '%s' of %s", tok, m->name);
+            goto bad;
+        }
+    }
+    // drivers keep their state in static variables
+    for(sensor *s = sensors; s; s = s->next) if(s->model == m){
+        WARNX("Only one %s can be used", m->name);
+        goto bad;
+    }
+    i2cbus *b = getbus(bus);
+    if(!b) goto bad;
+    sensor *s = MALLOC(sensor, 1);
+    s->model = m;
+    s->dev = i2cdev_attach(b, (addr < 0) ? m->addr : (uint8_t)addr);
+    s->period = (period < 0.) ? m->period : period;
+    s->state = SENS_INIT;
+    s->wheel = w;
+    tw_timer_init(&s->timer, step, s);
+    s->tnext = dtime();
+    schedule(s, s->tnext);
+    s->next = sensors;
+    sensors = s;
+    DBG("Add %s@0x%02x on %s, period %gs", m->name, s->dev->addr, bus, s->period);
+    FREE(str);
+    return s;
+bad:
+    FREE(str);
+    return NULL;
+}
+
+sensor *sensors_first(){
+    return sensors;
+}
+
+void sensors_close(){
+    i2c_setdev(NULL);
+    while(sensors){
+        sensor *s = sensors;
+        sensors = s->next;
+        tw_del(s->wheel, &s->timer);
+        i2cdev_close(s->dev);
+        FREE(s);
+    }
+    while(buses){
+        busent *b = buses;
+        buses = b->next;
+        i2cbus_close(b->bus);
+        FREE(b->path);
+        FREE(b);
+    }
+}
+
+// show counters of sensors and buses
+void sensors_stat(){
+    for(sensor *s = sensors; s; s = s->next)
+        printf("%s@0x%02x: %u measurements, %u polls, %u errors\n", s->model->name, s->dev->addr,
+               s->nmeas, s->npolls, s->nerr);
+    for(busent *b = buses; b; b = b->next)
+        printf("%s: %llu transfers, %llu messages, %llu bytes, %llu errors\n", b->path,
+               (unsigned long long)b->bus->stat.transfers, (unsigned long long)b->bus->stat.msgs,
+               (unsigned long long)b->bus->stat.bytes, (unsigned long long)b->bus->stat.errors);
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "i2c.h"
+#include "timerwheel.h"
+
+// min interval between polls of busy sensor, s
+#define SENS_POLL       (0.002)
+// max time of measurement, s
+#define SENS_TIMEOUT    (2.)
+// pause before reinitialization after error, s
+#define SENS_RETRY      (5.)
+
+typedef enum{
+    SENS_INIT,          // need initialization
+    SENS_IDLE,          // waiting for next measurement
+    SENS_BUSY,          // measurement in progress
+} sensor_state;
+
+// result of model `poll`
+typedef enum{
+    MEAS_BUSY,
+    MEAS_READY,
+    MEAS_ERR
+} meas_result;
+
+typedef struct sensor sensor;
+
+// sensor driver: all functions work with default I2C device (selected by scheduler with i2c_setdev())
+typedef struct{
+    const char *name;
+    uint8_t addr;                   // default slave address
+    double period;                  // default measurement period, s
+    int (*init)(sensor *s);         // check ID and initialize
+    int (*start)(sensor *s);        // start measurement
+    meas_result (*poll)(sensor *s); // run driver state machine
+    double (*deadline)();           // expected end of conversion (by dtime()) or 0 if unknown
+    void (*report)(sensor *s);      // get data and show it
+} sensor_model;
+
+struct sensor{
+    const sensor_model *model;
+    i2cdev *dev;
+    double period;                  // measurement period, s
+    double tstart;                  // time of last measurement start
+    double tnext;                   // scheduled time of measurement start (wakeups are always later)
+    sensor_state state;
+    uint32_t nmeas;                 // amount of measurements
+    uint32_t nerr;                  // amount of errors
+    uint32_t npolls;                // amount of state machine polls
+    timerwheel *wheel;
+    tw_timer timer;
+    sensor *next;
+};
+
+sensor *sensor_new(const char *spec, const char *defbus, timerwheel *w);
+sensor *sensors_first();
+void sensors_close();
+void sensors_stat();
+void sensors_list();
@@ -0,0 +1,144 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <usefull_macros.h>
+
+#include "timerwheel.h"
+
+// tick number of time `t` (rounded up for arming: timer never fires before its time)
+static inline uint64_t tickof(timerwheel *w, double t){
+    double x = ceil((t - w->t0) / w->tick);
+    if(x < 0.) return 0;
+    return (uint64_t)x;
+}
+
+// last tick already started at time `t` (rounded down: next tick is still in the future)
+static inline uint64_t curtick(timerwheel *w, double t){
+    double x = floor((t - w->t0) / w->tick);
+    if(x < 0.) return 0;
+    return (uint64_t)x;
+}
+
+/**
+ * @brief tw_init - initialize empty wheel
+ * @param tick - tick length, s (<= 0 - TW_TICK)
+ */
+void tw_init(timerwheel *w, double tick){
+    if(!w) return;
+    w->tick = (tick > 0.) ? tick : TW_TICK;
+    w->t0 = dtime();
+    w->now = 0;
+    w->ntimers = 0;
+    for(int i = 0; i < TW_SLOTS; ++i) w->slots[i].next = w->slots[i].prev = &w->slots[i];
+}
+
+void tw_timer_init(tw_timer *t, tw_callback cb, void *arg){
+    if(!t) return;
+    t->next = t->prev = NULL;
+    t->expire = 0;
+    t->cb = cb;
+    t->arg = arg;
+}
+
+int tw_active(const tw_timer *t){
+    return (t && t->next) ? TRUE : FALSE;
+}
+
+void tw_del(timerwheel *w, tw_timer *t){
+    if(!w || !tw_active(t)) return;
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+    --w->ntimers;
+}
+
+/**
+ * @brief tw_add_at - (re)arm timer to fire at given time
+ * @param when - time by dtime(); past times fire on next tw_run()
+ */
+void tw_add_at(timerwheel *w, tw_timer *t, double when){
+    if(!w || !t) return;
+    tw_del(w, t);
+    uint64_t n = tickof(w, when);
+    if(n <= w->now) n = w->now + 1;
+    t->expire = n;
+    tw_timer *head = &w->slots[n & (TW_SLOTS - 1)];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+    ++w->ntimers;
+}
+
+// (re)arm timer to fire after `delay` seconds
+void tw_add(timerwheel *w, tw_timer *t, double delay){
+    tw_add_at(w, t, dtime() + delay);
+}
+
+/**
+ * @brief tw_timeout - time till nearest timer
+ * @return seconds (0 if some timers are expired already) or -1 if there's no timers
+ */
+double tw_timeout(timerwheel *w){
+    if(!w || w->ntimers == 0) return -1.;
+    uint64_t nearest = UINT64_MAX;
+    // first look for timers of current wheel turn: the first non-empty slot gives the answer
+    for(uint64_t n = w->now + 1; n <= w->now + TW_SLOTS && nearest == UINT64_MAX; ++n){
+        tw_timer *head = &w->slots[n & (TW_SLOTS - 1)];
+        for(tw_timer *t = head->next; t != head; t = t->next)
+            if(t->expire == n){ nearest = n; break; }
+    }
+    // all timers are after more than one turn: find minimal
+    if(nearest == UINT64_MAX) for(int i = 0; i < TW_SLOTS; ++i){
+        tw_timer *head = &w->slots[i];
+        for(tw_timer *t = head->next; t != head; t = t->next)
+            if(t->expire < nearest) nearest = t->expire;
+    }
+    double dt = w->t0 + nearest * w->tick - dtime();
+    return (dt > 0.) ? dt : 0.;
+}
+
+/**
+ * @brief tw_run - process all ticks till current time and run callbacks of expired timers
+ * @return amount of callbacks called
+ */
+int tw_run(timerwheel *w){
+    if(!w) return 0;
+    uint64_t last = curtick(w, dtime());
+    int nrun = 0;
+    // don't walk around the wheel more than once if there's nothing to do for a long time
+    if(last > w->now + TW_SLOTS && w->ntimers == 0) w->now = last - TW_SLOTS;
+    for(; w->now < last; ){
+        uint64_t n = ++w->now;
+        tw_timer *head = &w->slots[n & (TW_SLOTS - 1)];
+        tw_timer *t = head->next;
+        while(t != head){
+            tw_timer *next = t->next;
+            if(t->expire <= n){
+                tw_del(w, t);
+                ++nrun;
+                if(t->cb) t->cb(t, t->arg);
+                // callback could re-add timer into this slot or delete `next`: restart scan
+                next = head->next;
+            }
+            t = next;
+        }
+    }
+    return nrun;
+}
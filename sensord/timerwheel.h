@@ -0,0 +1,54 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// amount of slots (power of two): timers more than TW_SLOTS ticks ahead wait for several wheel turns
+#define TW_SLOTS        (256)
+// default tick, s
+#define TW_TICK         (0.001)
+
+typedef struct tw_timer tw_timer;
+typedef void (*tw_callback)(tw_timer *t, void *arg);
+
+struct tw_timer{
+    tw_timer *next, *prev;      // slot list
+    uint64_t expire;            // tick number of expiration
+    tw_callback cb;             // called when expired (timer is already removed and can be re-added)
+    void *arg;
+};
+
+// hashed timing wheel: O(1) add/remove, timer of tick `n` lives in slot `n % TW_SLOTS`
+typedef struct{
+    double tick;                // tick length, s
+    double t0;                  // time of tick 0 (by dtime())
+    uint64_t now;               // last processed tick
+    int ntimers;                // amount of active timers
+    tw_timer slots[TW_SLOTS];   // list heads
+} timerwheel;
+
+void tw_init(timerwheel *w, double tick);
+void tw_timer_init(tw_timer *t, tw_callback cb, void *arg);
+int tw_active(const tw_timer *t);
+void tw_add(timerwheel *w, tw_timer *t, double delay);
+void tw_add_at(timerwheel *w, tw_timer *t, double when);
+void tw_del(timerwheel *w, tw_timer *t);
+double tw_timeout(timerwheel *w);
+int tw_run(timerwheel *w);
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the sensord project.
+ * Copyright 2022 Edward V. Emelianov <edward.emelianoff@gmail.com>.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// check of timer wheel: no callback should run before its time; run by `make check`
+
+#include <stdio.h>
+#include <time.h>
+#include <usefull_macros.h>
+
+#include "timerwheel.h"
+
+typedef struct{
+    double when;        // time timer armed to
+    double fired;       // time callback called (0 - not yet)
+} chkarg;
+
+static void cb(tw_timer _U_ *t, void *arg){
+    chkarg *a = (chkarg*)arg;
+    a->fired = dtime();
+}
+
+// run timers at delays `delays` (s) with tick `tick`; return amount of early or lost timers
+static int chktick(double tick, const double *delays, int n){
+    timerwheel w;
+    tw_timer t[n];
+    chkarg a[n];
+    int bad = 0;
+    double maxlate = 0.;
+    tw_init(&w, tick);
+    double t0 = dtime();
+    for(int i = 0; i < n; ++i){
+        a[i].when = t0 + delays[i];
+        a[i].fired = 0.;
+        tw_timer_init(&t[i], cb, &a[i]);
+        tw_add_at(&w, &t[i], a[i].when);
+    }
+    // the same loop as in main()
+    double dt;
+    while((dt = tw_timeout(&w)) > -1.){
+        if(dt > 0.){
+            struct timespec ts = {.tv_sec = (time_t)dt, .tv_nsec = (long)((dt - (time_t)dt) * 1e9)};
+            nanosleep(&ts, NULL);
+        }
+        tw_run(&w);
+    }
+    for(int i = 0; i < n; ++i){
+        double late = a[i].fired - a[i].when;
+        if(a[i].fired == 0.){
+            printf("tick=%g: timer %d (%gs) didn't fire\n", tick, i, delays[i]);
+            ++bad;
+        }else if(late < 0.){
+            printf("tick=%g: timer %d (%gs) fired %.1fms early\n", tick, i, delays[i], -late*1e3);
+            ++bad;
+        }else if(late > maxlate) maxlate = late;
+    }
+    printf("tick=%g: max delay %.1fms\n", tick, maxlate*1e3);
+    return bad;
+}
+
+int main(){
+    // includes timers closer than one tick, at the same tick and more than one wheel turn ahead
+    const double delays[] = {0.0003, 0.013, 0.09, 0.18, 0.1801, 0.201, 0.25, 0.4, 0.0001};
+    const int n = sizeof(delays) / sizeof(delays[0]);
+    const double ticks[] = {0.001, 0.007, 0.05, 0.1};
+    int bad = 0;
+    for(int i = 0; i < (int)(sizeof(ticks)/sizeof(ticks[0])); ++i) bad += chktick(ticks[i], delays, n);
+    printf("%s\n", bad ? "FAIL" : "OK");
+    return bad ? 1 : 0;
+}